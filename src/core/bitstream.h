@@ -2,6 +2,7 @@
 #pragma once
 #include <fstream>
 #include <vector>
+#include <string.h>
 #include "core/common/cpu.hpp"
 
 #if defined(CPU_PLATFORM_X64)
@@ -10,36 +11,66 @@
 #include "arm_neon.h"
 #endif
 
+// Readers never load past buffer_end: once there they keep refilling from the STREAM_PADDING zero guard
+// words that follow it, so a truncated unit decodes zero bits and terminates. decode() reads up to the end
+// of its buffer, a unit cut there runs on into the next start code, whose 23 zero bits stop a slice too.
+// push() ends a unit at the next start code and zeroes the guard words over it while the unit is decoded,
+// slice tasks keep a zero padded copy.
 #define BITSTREAM(bs) \
-uint32_t*& bit_ptr = bs->get_ptr(); \
+auto&      bit_ptr = bs->get_ptr(); \
 uint64_t & bit_buf = bs->get_buf(); \
 uint32_t & bit_idx = bs->get_idx(); \
+auto       bit_end = bs->get_end(); \
 
 #define GET_NEXT_BITS(len) ((bit_buf << bit_idx) >> (64 - len))
 #define SKIP_BITS(len) bit_idx += len
-#define UPDATE_BITS() if (bit_idx >= 32) { bit_buf <<= 32; bit_buf |= (uint64_t)bswap_32(*(bit_ptr++)); bit_idx -= 32; }
+#define UPDATE_BITS() update_bits(bit_ptr, bit_buf, bit_idx, bit_end)
+
+// 32-bit refill: shifts the next word into the cache, bit_ptr points past the last loaded word.
+// Loads are clamped to bit_end but bit_ptr keeps counting, so the bit position stays exact.
+MP2V_INLINE void update_bits(uint32_t*& bit_ptr, uint64_t& bit_buf, uint32_t& bit_idx, uint32_t* bit_end) {
+    if (bit_idx >= 32) {
+        bit_buf <<= 32;
+        bit_buf |= (uint64_t)bswap_32(*(bit_ptr < bit_end ? bit_ptr : bit_end));
+        bit_ptr++;
+        bit_idx -= 32;
+    }
+}
+
+// 64-bit refill: reloads the whole cache with one unaligned load from the byte holding the next unread bit,
+// leaving at least 57 valid bits. bit_ptr points to the byte the cache starts with.
+MP2V_INLINE void update_bits(uint8_t*& bit_ptr, uint64_t& bit_buf, uint32_t& bit_idx, uint8_t* bit_end) {
+    if (bit_idx >= 32) {
+        uint64_t tmp;
+        bit_ptr += bit_idx >> 3;
+        bit_ptr = (bit_ptr < bit_end) ? bit_ptr : bit_end;
+        bit_idx &= 7;
+        memcpy(&tmp, bit_ptr, sizeof(tmp));
+        bit_buf = bswap_64(tmp);
+    }
+}
 
 class bitstream_reader_c {
 private:
     uint32_t* buffer_ptr = nullptr;
+    uint32_t* buffer_end = nullptr;
     uint64_t  buffer = 0;
     uint32_t  buffer_idx = 64;
 
     MP2V_INLINE void update_buffer() {
-        if (buffer_idx >= 32) {
-            buffer <<= 32;
-            buffer |= (uint64_t)bswap_32(*(buffer_ptr++));
-            buffer_idx -= 32;
-        };
+        update_bits(buffer_ptr, buffer, buffer_idx, buffer_end);
     }
 public:
     bitstream_reader_c() {}
     ~bitstream_reader_c() {}
 
-    void set_bitstream_buffer(uint8_t* bitstream_buffer) { 
+    void set_bitstream_buffer(uint8_t* bitstream_buffer, uint8_t* bitstream_end, uint32_t bit_offset = 0) {
         buffer_ptr = (uint32_t*)bitstream_buffer;
+        buffer_end = (uint32_t*)bitstream_end;
         buffer = 0;
         buffer_idx = 64;
+        update_buffer();
+        buffer_idx += bit_offset;
     }
 
     MP2V_INLINE uint32_t get_next_bits(int len) {
@@ -58,7 +89,58 @@ public:
         buffer_idx += len;
     }
 
+    // byte holding the next unread bit and the position of that bit inside it
+    uint8_t* get_byte_ptr()   { return (uint8_t*)buffer_ptr - sizeof(buffer) + (buffer_idx >> 3); }
+    uint32_t get_bit_offset() { return buffer_idx & 7; }
+
     uint32_t*& get_ptr() { return buffer_ptr; }
     uint64_t & get_buf() { return buffer; }
     uint32_t & get_idx() { return buffer_idx; }
+    uint32_t*  get_end() { return buffer_end; }
+};
+
+// Same interface as bitstream_reader_c, but the cache is refilled with a single unaligned 64-bit load,
+// so every refill leaves room for several VLC symbols. Requires 8 readable bytes after bitstream_end.
+class bitstream_reader64_c {
+private:
+    uint8_t* buffer_ptr = nullptr;
+    uint8_t* buffer_end = nullptr;
+    uint64_t buffer = 0;
+    uint32_t buffer_idx = 0;
+
+    MP2V_INLINE void update_buffer() {
+        update_bits(buffer_ptr, buffer, buffer_idx, buffer_end);
+    }
+public:
+    bitstream_reader64_c() {}
+    ~bitstream_reader64_c() {}
+
+    void set_bitstream_buffer(uint8_t* bitstream_buffer, uint8_t* bitstream_end, uint32_t bit_offset = 0) {
+        buffer_ptr = (bitstream_buffer < bitstream_end) ? bitstream_buffer : bitstream_end;
+        buffer_end = bitstream_end;
+        buffer_idx = bit_offset;
+        memcpy(&buffer, buffer_ptr, sizeof(buffer));
+        buffer = bswap_64(buffer);
+    }
+
+    MP2V_INLINE uint32_t get_next_bits(int len) {
+        update_buffer();
+        uint64_t tmp = buffer << buffer_idx;
+        return tmp >> (64 - len);
+    }
+
+    MP2V_INLINE uint32_t read_next_bits(int len) {
+        uint32_t tmp = get_next_bits(len);
+        buffer_idx += len;
+        return tmp;
+    }
+
+    MP2V_INLINE void skip_bits(int len) {
+        buffer_idx += len;
+    }
+
+    uint8_t*& get_ptr() { return buffer_ptr; }
+    uint64_t& get_buf() { return buffer; }
+    uint32_t& get_idx() { return buffer_idx; }
+    uint8_t*  get_end() { return buffer_end; }
 };
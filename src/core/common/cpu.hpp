@@ -20,18 +20,32 @@
 #endif
 #endif
 
+#if defined(CPU_PLATFORM_AARCH64) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
 #if defined(__GNUC__) || defined(__clang__)
 #define MP2V_INLINE                   inline __attribute__((always_inline))
+#define MP2V_TARGET(isa)              __attribute__((target(isa)))
 #define ALIGN(n)                      __attribute__ ((aligned(n)))
+#define MP2V_PREFETCH(ptr)            __builtin_prefetch(ptr)
 #else
 #define MP2V_INLINE                   __forceinline
+#define MP2V_TARGET(isa)
 #define ALIGN(n)                      __declspec(align(n))
 #endif
 
 #if defined(_MSC_VER)
 #include <intrin.h>
+#if defined(CPU_PLATFORM_X64)
+#define MP2V_PREFETCH(ptr)            _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
+#else
+#define MP2V_PREFETCH(ptr)            __prefetch(ptr)
+#endif
 #define bswap_16(x) _byteswap_ushort(x)
 #define bswap_32(x) _byteswap_ulong(x)
+#define bswap_64(x) _byteswap_uint64(x)
 
 MP2V_INLINE uint32_t bit_scan_reverse(uint32_t x)
 {
@@ -53,9 +67,37 @@ MP2V_INLINE uint64_t bit_scan_forward64(uint64_t x)
     _BitScanForward64(&index, x);
     return x ? index : 64;
 }
+
+MP2V_INLINE bool cpu_support_avx2()
+{
+#if defined(CPU_PLATFORM_X64)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const int osxsave_avx = (1 << 27) | (1 << 28);
+    if ((info[2] & osxsave_avx) != osxsave_avx || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+MP2V_INLINE bool cpu_support_neon()
+{
+#if defined(CPU_PLATFORM_AARCH64)
+    return true; // part of every ARM target Windows runs on
+#else
+    return false;
+#endif
+}
 #elif defined(__GNUC__) || defined(__clang__)
 #define bswap_16(x) __builtin_bswap16(x);
 #define bswap_32(x) __builtin_bswap32(x);
+#define bswap_64(x) __builtin_bswap64(x);
 
 MP2V_INLINE uint32_t bit_scan_reverse(uint32_t x)
 {
@@ -71,6 +113,29 @@ MP2V_INLINE uint64_t bit_scan_forward64(uint64_t x)
 {
     return x ? __builtin_ctzll(x) : 64;
 }
+
+MP2V_INLINE bool cpu_support_avx2()
+{
+#if defined(CPU_PLATFORM_X64)
+    __builtin_cpu_init(); // may run from static initializers ahead of libgcc's own
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+MP2V_INLINE bool cpu_support_neon()
+{
+#if defined(CPU_PLATFORM_AARCH64) && defined(__linux__) && defined(__aarch64__)
+    return (getauxval(AT_HWCAP) & HWCAP_ASIMD) != 0;
+#elif defined(CPU_PLATFORM_AARCH64) && defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#elif defined(CPU_PLATFORM_AARCH64)
+    return true; // no HWCAP to ask, NEON is mandatory in ARMv8
+#else
+    return false;
+#endif
+}
 #endif
 
 template <typename T, size_t N = 16>
@@ -0,0 +1,56 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#include <stdlib.h>
+#include <string.h>
+#include "cpu_dispatch.h"
+#include "kernels.h"
+
+static const char* cpu_isa_names[] = { "auto", "c", "sse2", "avx2", "neon" };
+
+bool cpu_isa_supported(cpu_isa_e isa) {
+    switch (isa) {
+    case cpu_isa_c:
+        return true;
+#if defined(CPU_PLATFORM_X64)
+    case cpu_isa_sse2:
+        return true; // x86-64 baseline
+    case cpu_isa_avx2:
+        return cpu_support_avx2();
+#elif defined(CPU_PLATFORM_AARCH64)
+    case cpu_isa_neon:
+        return cpu_support_neon();
+#endif
+    default:
+        return false;
+    }
+}
+
+cpu_isa_e cpu_isa_from_name(const char* name) {
+    for (int isa = cpu_isa_auto; isa <= cpu_isa_neon; isa++)
+        if (name && !strcmp(name, cpu_isa_names[isa]))
+            return (cpu_isa_e)isa;
+    return cpu_isa_auto;
+}
+
+const char* cpu_isa_name(cpu_isa_e isa) {
+    return (isa >= cpu_isa_auto && isa <= cpu_isa_neon) ? cpu_isa_names[isa] : cpu_isa_names[cpu_isa_auto];
+}
+
+cpu_isa_e cpu_isa_select(cpu_isa_e isa) {
+    if (isa == cpu_isa_auto)
+        isa = cpu_isa_from_name(getenv("MP2V_CPU_ISA"));
+    if (isa == cpu_isa_auto || !cpu_isa_supported(isa)) {
+        // only one platform's levels can be supported, the highest one is the best
+        for (isa = cpu_isa_neon; isa > cpu_isa_c && !cpu_isa_supported(isa); isa = (cpu_isa_e)(isa - 1));
+    }
+    return isa;
+}
+
+cpu_isa_e cpu_dispatch_init(kernels_t& kernels, cpu_isa_e isa, idct_accuracy_e accuracy) {
+    isa = cpu_isa_select(isa);
+    mc_init(kernels, isa, accuracy);
+    idct_init(kernels, isa, accuracy);
+    iquant_init(kernels, isa);
+    kernels.isa = isa;
+    kernels.idct_accuracy = accuracy;
+    return isa;
+}
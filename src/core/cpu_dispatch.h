@@ -0,0 +1,32 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#pragma once
+#include "common/cpu.hpp"
+
+// Instruction set levels of the MC and IDCT kernels and of the start code scan. The C level is built on
+// every platform, the others only where they can run.
+enum cpu_isa_e {
+    cpu_isa_auto = 0, // best level the CPU supports
+    cpu_isa_c,
+    cpu_isa_sse2,
+    cpu_isa_avx2,
+    cpu_isa_neon
+};
+
+// Accuracy of the IDCT kernels
+enum idct_accuracy_e {
+    idct_accuracy_fast = 0,  // 16 bit SIMD arithmetic, its error against the reference isn't bounded
+    idct_accuracy_conformant // the integer IDCT of the MPEG-2 test model, within IEEE 1180 and bit-exact on every level
+};
+
+bool        cpu_isa_supported(cpu_isa_e isa);
+cpu_isa_e   cpu_isa_from_name(const char* name); // "c", "sse2", "avx2" or "neon", cpu_isa_auto for anything else
+const char* cpu_isa_name(cpu_isa_e isa);
+
+// cpu_isa_auto becomes the level named by the MP2V_CPU_ISA environment variable, if any, and the best supported one
+// otherwise. A level the CPU doesn't support is treated as cpu_isa_auto.
+cpu_isa_e cpu_isa_select(cpu_isa_e isa);
+
+// Fills the MC, IDCT and inverse quantisation tables of kernels (kernels.h) for the level cpu_isa_select() makes of isa.
+// Returns the level.
+struct kernels_t;
+cpu_isa_e cpu_dispatch_init(kernels_t& kernels, cpu_isa_e isa = cpu_isa_auto, idct_accuracy_e accuracy = idct_accuracy_fast);
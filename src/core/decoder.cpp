@@ -1,11 +1,13 @@
 // Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
 #include <string.h>
+#include <memory>
 #include "mb_decoder.h"
 #include "decoder.h"
 #include "mp2v_hdr.h"
 #include "mp2v_vlc.h"
 #include "misc.hpp"
 #include "start_codes_search.hpp"
+#include "stream_index.h"
 
 uint8_t default_intra_quantiser_matrix[64] = {
     8,  16, 19, 22, 26, 27, 29, 34,
@@ -41,51 +43,85 @@ spatial_temporal_weights_classes_t local_spatial_temporal_weights_classes_tbl[4]
     {{{2, 0}, 2, 1}, {{2, 1}, 2, 0}, {{1, 2}, 3, 0}, {{1, 1}, 1, 0} }
 };
 
-frame_c::frame_c(int width, int height, int chroma_format) {
-    m_stride[0] = (width + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+frame_c::frame_c(int width, int height, int chroma_format, int padding) {
+    padding = (padding + 31) & ~31; // the planes stay as aligned as their buffers
     m_width [0] = width;
     m_height[0] = height;
+    m_pad_x [0] = padding;
+    m_pad_y [0] = padding;
 
     switch (chroma_format) {
     case chroma_format_420:
-        m_stride[1] = ((m_stride[0] >> 1) + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
         m_width [1] = m_width[0] >> 1;
         m_height[1] = m_height[0] >> 1;
+        m_pad_x [1] = padding >> 1;
+        m_pad_y [1] = padding >> 1;
         break;
     case chroma_format_422:
-        m_stride[1] = ((m_stride[0] >> 1) + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
         m_width [1] = m_width[0] >> 1;
         m_height[1] = m_height[0];
+        m_pad_x [1] = padding >> 1;
+        m_pad_y [1] = padding;
         break;
     case chroma_format_444:
-        m_stride[1] = m_stride[0];
         m_width [1] = m_width [0];
         m_height[1] = m_height[0];
+        m_pad_x [1] = padding;
+        m_pad_y [1] = padding;
         break;
     }
-    m_stride[2] = m_stride[1];
     m_width [2] = m_width [1];
     m_height[2] = m_height[1];
+    m_pad_x [2] = m_pad_x [1];
+    m_pad_y [2] = m_pad_y [1];
 
+    for (int i = 0; i < 3; i++) {
+        m_stride[i] = (m_width[i] + 2 * m_pad_x[i] + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+        size_t size = (m_height[i] + 2 * m_pad_y[i]) * m_stride[i];
 #if defined(_MSC_VER)
-    for (int i = 0; i < 3; i++)
-        m_planes[i] = (uint8_t*)_aligned_malloc(m_height[i] * m_stride[i], 32);
+        m_buffers[i] = (uint8_t*)_aligned_malloc(size, 32);
 #else
-    for (int i = 0; i < 3; i++)
-        m_planes[i] = (uint8_t*)aligned_alloc(32, m_height[i] * m_stride[i]);
+        m_buffers[i] = (uint8_t*)aligned_alloc(32, size);
 #endif
+        m_planes[i] = m_buffers[i] + m_pad_y[i] * m_stride[i] + m_pad_x[i];
+    }
 }
 
 frame_c::~frame_c() {
 #if defined(_MSC_VER)
     for (int i = 0; i < 3; i++)
-        if (m_planes[i]) _aligned_free(m_planes[i]);
+        if (m_buffers[i]) _aligned_free(m_buffers[i]);
 #else
     for (int i = 0; i < 3; i++)
-        if (m_planes[i]) free(m_planes[i]);
+        if (m_buffers[i]) free(m_buffers[i]);
 #endif
 }
 
+void frame_c::extend_borders(uint32_t width, uint32_t height) {
+    width  = std::min(width,  m_width [0]);
+    height = std::min(height, m_height[0]);
+    if (!width || !height)
+        return;
+    for (int i = 0; i < 3; i++) {
+        if (!m_pad_x[i])
+            continue;
+        uint32_t w = width  * m_width [i] / m_width [0];
+        uint32_t h = height * m_height[i] / m_height[0];
+        uint8_t* row = m_planes[i];
+        for (uint32_t y = 0; y < h; y++, row += m_stride[i]) {
+            memset(row - m_pad_x[i], row[0], m_pad_x[i]);
+            memset(row + w, row[w - 1], m_pad_x[i]);
+        }
+        // the corners come with the rows extended above
+        uint8_t* top = m_planes[i] - m_pad_x[i];
+        uint8_t* bottom = top + (h - 1) * m_stride[i];
+        for (uint32_t y = 1; y <= m_pad_y[i]; y++) {
+            memcpy(top - y * m_stride[i], top, w + 2 * m_pad_x[i]);
+            memcpy(bottom + y * m_stride[i], bottom, w + 2 * m_pad_x[i]);
+        }
+    }
+}
+
 static void make_macroblock_yuv_ptrs(uint8_t* (&yuv)[3], frame_c* frame, int mb_row, int stride, int chroma_stride, int chroma_format) {
     yuv[0] = frame->get_planes(0) + mb_row * 16 * stride;// +mb_col * 16;
     switch (chroma_format) {
@@ -124,7 +160,9 @@ bool mp2v_picture_c::decode_slice(bitstream_reader_c bs) {
     // fill cache
     mp2v_picture_c* refs[2] = {(mp2v_picture_c*)dependencies[0], (mp2v_picture_c*)dependencies[1]};
     macroblock_context_cache_t cache;
-    memcpy(cache.W, quantiser_matrices, sizeof(cache.W));
+    cache.kernels = &m_dec->m_kernels;
+    cache.quant_tables = m_quant_tables.get();
+    cache.WQ = cache.quant_tables->WQ[pcext.q_scale_type][slice.quantiser_scale_code];
     memcpy(cache.f_code, pcext.f_code, sizeof(cache.f_code));
     memset(cache.PMVs, 0, sizeof(cache.PMVs));
     for (auto& pred : cache.dct_dc_pred) pred = 1 << (pcext.intra_dc_precision + 7);
@@ -134,23 +172,59 @@ bool mp2v_picture_c::decode_slice(bitstream_reader_c bs) {
     cache.intra_dc_prec    = m_picture_coding_extension.intra_dc_precision;
     cache.intra_vlc_format = pcext.intra_vlc_format;
     cache.previous_mb_type = 0;
+    cache.batch = nullptr;
+    cache.prefetch = m_dec->m_prefetch;
                  make_macroblock_yuv_ptrs(cache.yuv_planes[REF_TYPE_SRC], m_frame, mb_row, cache.luma_stride, cache.chroma_stride, sext.chroma_format);
     if (refs[0]) make_macroblock_yuv_ptrs(cache.yuv_planes[REF_TYPE_L0 ], refs[0]->get_frame(), mb_row, cache.luma_stride, cache.chroma_stride, sext.chroma_format);
     if (refs[1]) make_macroblock_yuv_ptrs(cache.yuv_planes[REF_TYPE_L1 ], refs[1]->get_frame(), mb_row, cache.luma_stride, cache.chroma_stride, sext.chroma_format);
-    if (m_picture_coding_extension.q_scale_type) {
-        if (slice.quantiser_scale_code < 9)       cache.quantiser_scale =  slice.quantiser_scale_code;
-        else if (slice.quantiser_scale_code < 17) cache.quantiser_scale = (slice.quantiser_scale_code - 4) << 1;
-        else if (slice.quantiser_scale_code < 25) cache.quantiser_scale = (slice.quantiser_scale_code - 10) << 2;
-        else                                      cache.quantiser_scale = (slice.quantiser_scale_code - 17) << 3; }
-    else                                          cache.quantiser_scale =  slice.quantiser_scale_code << 1;
 
     // decode macroblocks
+    macroblock_reader_t mb_bs;
+    mb_bs.set_bitstream_buffer(bs.get_byte_ptr(), (uint8_t*)bs.get_end(), bs.get_bit_offset());
+    if (m_reconstruct_macroblocks_func) {
+        // one batch per thread, reused by all slices the thread decodes
+        static thread_local std::unique_ptr<mb_batch_t> batch;
+        if (!batch)
+            batch.reset(new mb_batch_t);
+        batch->reset();
+        cache.batch = batch.get();
+        do {
+            m_parse_macroblock_func(&mb_bs, cache);
+            if (batch->full())
+                m_reconstruct_macroblocks_func(cache);
+        } while (mb_bs.get_next_bits(23) != 0);
+        m_reconstruct_macroblocks_func(cache);
+        return true;
+    }
     do {
-        m_parse_macroblock_func(&bs, cache);
-    } while (bs.get_next_bits(23) != 0);
+        m_parse_macroblock_func(&mb_bs, cache);
+    } while (mb_bs.get_next_bits(23) != 0);
     return true;
 }
 
+mp2v_picture_c::~mp2v_picture_c() {
+    for (auto* tsk : m_slices_pool)
+        delete tsk;
+}
+
+// Motion vectors of the pictures predicted from this one may point into the guard band
+void mp2v_picture_c::completed() {
+    if (m_picture_header.picture_coding_type != picture_coding_type_bidir)
+        m_frame->extend_borders(m_coded_width, m_coded_height);
+}
+
+void mp2v_picture_c::reset() {
+    picture_task_c::reset();
+    m_num_slices = 0;
+    m_sequence_end = false;
+}
+
+mp2v_slice_task_c* mp2v_picture_c::new_slice_task() {
+    if (m_num_slices == (int)m_slices_pool.size())
+        m_slices_pool.push_back(new mp2v_slice_task_c());
+    return m_slices_pool[m_num_slices++];
+}
+
 void mp2v_picture_c::init() {
     auto& sext = m_dec->m_sequence_extension;
     auto& pcext = m_picture_coding_extension;
@@ -162,37 +236,76 @@ void mp2v_picture_c::init() {
         pcext.concealment_motion_vectors,
         sext.chroma_format,
         pcext.q_scale_type,
-        pcext.alternate_scan);
+        pcext.alternate_scan,
+        m_dec->m_two_phase);
+    m_reconstruct_macroblocks_func = m_dec->m_two_phase ? select_reconstruct_macroblocks_func(ph.picture_coding_type, pcext.picture_structure, sext.chroma_format) : nullptr;
+    m_quant_tables = m_dec->m_quant_tables; // the decoder replaces its tables on a change, these stay valid while slices decode
+
+    // Frames are allocated at the configured size, the guard band goes around the decoded area instead. Interlaced
+    // sequences code the height in pairs of field macroblock rows.
+    auto& sh = m_dec->m_sequence_header;
+    uint32_t mb_rows_height = sext.progressive_sequence ? 16 : 32;
+    m_coded_width  = (((sext.horizontal_size_extension << 12) | sh.horizontal_size_value) + 15) & ~15;
+    m_coded_height = (((sext.vertical_size_extension   << 12) | sh.vertical_size_value) + mb_rows_height - 1) & ~(mb_rows_height - 1);
+}
 
-    bool def_mat = m_quant_matrix_extension != nullptr;
-    uint8_t tmp[4][64];
+static int quantiser_scale(bool q_scale_type, int quantiser_scale_code) {
+    if (!q_scale_type)             return  quantiser_scale_code << 1;
+    if (quantiser_scale_code < 9)  return  quantiser_scale_code;
+    if (quantiser_scale_code < 17) return (quantiser_scale_code - 4) << 1;
+    if (quantiser_scale_code < 25) return (quantiser_scale_code - 10) << 2;
+    return (quantiser_scale_code - 17) << 3;
+}
+
+void mp2v_decoder_c::load_sequence_quantiser_matrices() {
+    auto& sh = m_sequence_header;
+    uint8_t matrices[4][64];
     for (int i = 0; i < 64; i++) {
-        int j = g_scan[0][i];
-        tmp[0][i] = default_intra_quantiser_matrix[j];
-        tmp[1][i] = default_non_intra_quantiser_matrix[j];
-        tmp[2][i] = default_intra_quantiser_matrix[j];
-        tmp[3][i] = default_non_intra_quantiser_matrix[j];
+        int j = g_shuffle[0][i]; // the defaults are in raster order
+        matrices[0][i] = sh.load_intra_quantiser_matrix     ? sh.intra_quantiser_matrix[i]     : default_intra_quantiser_matrix[j];
+        matrices[1][i] = sh.load_non_intra_quantiser_matrix ? sh.non_intra_quantiser_matrix[i] : default_non_intra_quantiser_matrix[j];
     }
-    if (def_mat) {
-        for (int i = 0; i < 64; i++) {
-            int j = g_scan[0][i];
-            if (m_quant_matrix_extension->load_intra_quantiser_matrix)            tmp[0][i] = m_quant_matrix_extension->intra_quantiser_matrix[j];
-            if (m_quant_matrix_extension->load_non_intra_quantiser_matrix)        tmp[1][i] = m_quant_matrix_extension->non_intra_quantiser_matrix[j];
-            if (m_quant_matrix_extension->load_chroma_intra_quantiser_matrix)     tmp[2][i] = m_quant_matrix_extension->chroma_intra_quantiser_matrix[j];
-            if (m_quant_matrix_extension->load_chroma_non_intra_quantiser_matrix) tmp[3][i] = m_quant_matrix_extension->chroma_non_intra_quantiser_matrix[j];
-        }
+    memcpy(matrices[2], matrices[0], 64);
+    memcpy(matrices[3], matrices[1], 64);
+    set_quantiser_matrices(matrices);
+}
+
+void mp2v_decoder_c::load_quant_matrix_extension(const quant_matrix_extension_t& qmext) {
+    uint8_t matrices[4][64];
+    memcpy(matrices, m_quantiser_matrices, sizeof(matrices));
+    // a luma matrix also replaces the chroma one, unless that is loaded as well
+    if (qmext.load_intra_quantiser_matrix) {
+        memcpy(matrices[0], qmext.intra_quantiser_matrix, 64);
+        memcpy(matrices[2], qmext.intra_quantiser_matrix, 64);
     }
-    for (int i = 0; i < 64; i++) {
-        int j = g_shuffle[pcext.alternate_scan][i];
-        if (m_quant_matrix_extension->load_intra_quantiser_matrix)            quantiser_matrices[0][i] = tmp[0][j];
-        if (m_quant_matrix_extension->load_non_intra_quantiser_matrix)        quantiser_matrices[1][i] = tmp[1][j];
-        if (m_quant_matrix_extension->load_chroma_intra_quantiser_matrix)     quantiser_matrices[2][i] = tmp[2][j];
-        if (m_quant_matrix_extension->load_chroma_non_intra_quantiser_matrix) quantiser_matrices[3][i] = tmp[3][j];
+    if (qmext.load_non_intra_quantiser_matrix) {
+        memcpy(matrices[1], qmext.non_intra_quantiser_matrix, 64);
+        memcpy(matrices[3], qmext.non_intra_quantiser_matrix, 64);
     }
+    if (qmext.load_chroma_intra_quantiser_matrix)     memcpy(matrices[2], qmext.chroma_intra_quantiser_matrix, 64);
+    if (qmext.load_chroma_non_intra_quantiser_matrix) memcpy(matrices[3], qmext.chroma_non_intra_quantiser_matrix, 64);
+    set_quantiser_matrices(matrices);
+}
+
+void mp2v_decoder_c::set_quantiser_matrices(const uint8_t matrices[4][64]) {
+    // streams tend to repeat the same matrices with every sequence header or picture
+    if (m_quant_tables && !memcmp(m_quantiser_matrices, matrices, sizeof(m_quantiser_matrices)))
+        return;
+    memcpy(m_quantiser_matrices, matrices, sizeof(m_quantiser_matrices));
+    auto tables = std::make_shared<quant_tables_t>();
+    for (int t = 0; t < 2; t++)
+        for (int code = 0; code < 32; code++) {
+            int scale = quantiser_scale(t != 0, code);
+            for (int m = 0; m < 4; m++)
+                for (int i = 0; i < 64; i++)
+                    tables->WQ[t][code][m][g_scan_trans[0][i]] = (uint16_t)(matrices[m][i] * scale);
+        }
+    m_quant_tables = tables; // pictures still decoding keep the previous tables
 }
 
 bool mp2v_decoder_c::decode_user_data() {
-    while (m_bs.get_next_bits(vlc_start_code.len) != vlc_start_code.value) {
+    // user data can't hold 23 zero bits in a row, so this also stops at the zero guard of a truncated buffer
+    while (m_bs.get_next_bits(23) != 0) {
         uint8_t data = m_bs.read_next_bits(8);
         user_data.push_back(data);
     }
@@ -202,6 +315,8 @@ bool mp2v_decoder_c::decode_user_data() {
 bool mp2v_decoder_c::decode_extension_data(mp2v_picture_c* pic) {
     m_bs.skip_bits(32);
     uint8_t ext_id = m_bs.get_next_bits(4);
+    if (!pic && ext_id != sequence_extension_id && ext_id != sequence_display_extension_id && ext_id != sequence_scalable_extension_id)
+        return true; // picture level extension of a skipped picture
     switch (ext_id)
     {
     case sequence_extension_id:
@@ -215,6 +330,7 @@ bool mp2v_decoder_c::decode_extension_data(mp2v_picture_c* pic) {
         break;
     case quant_matrix_extension_id:
         parse_quant_matrix_extension(&m_bs, *(pic->m_quant_matrix_extension = new quant_matrix_extension_t));
+        load_quant_matrix_extension(*pic->m_quant_matrix_extension);
         break;
     case copiright_extension_id:
         parse_copyright_extension(&m_bs, *(pic->m_copyright_extension = new copyright_extension_t));
@@ -268,63 +384,216 @@ void mp2v_decoder_c::out_pic(mp2v_picture_c* cur_pic) {
 #ifdef MP2V_MT
     task_queue->add_task(cur_pic, cur_pic->m_picture_header.picture_coding_type == picture_coding_type_bidir);
 #else
+    cur_pic->completed();
     if (cur_pic->m_picture_header.picture_coding_type == picture_coding_type_bidir || !reordering)
         m_done_pics.push(cur_pic);
     else if (ref_frames[0])
             m_done_pics.push(ref_frames[0]);
+    if (cur_pic->m_sequence_end && reordering && ref_frames[1])
+        m_done_pics.push(ref_frames[1]);
 #endif
 }
 
-bool mp2v_decoder_c::decode(uint8_t* buffer, int len) {
-
-    m_bs.set_bitstream_buffer(buffer);
-    bool new_picture = false, sequence_end = false;
-    mp2v_picture_c* cur_pic = nullptr;
-
-    scan_start_codes(buffer, buffer + len, [&](uint8_t* ptr) {
-        BITSTREAM((&m_bs));
-        bit_idx = 32;
-        bit_ptr = (uint32_t*)(ptr + 4);
-        bit_buf = (uint64_t)bswap_32(*((uint32_t*)ptr));
-        uint8_t start_code = *(ptr + 3);
-        switch (start_code) {
-        case sequence_header_code: parse_sequence_header(&m_bs, m_sequence_header); break;
-        case extension_start_code: decode_extension_data(cur_pic);                  break;
-        case group_start_code:     parse_group_of_pictures_header(&m_bs, *(m_group_of_pictures_header = new group_of_pictures_header_t)); break;
-        case picture_start_code:
-            new_picture = true;
-            if (cur_pic) out_pic(cur_pic);
-            cur_pic = new_pic();
-            parse_picture_header(&m_bs, cur_pic->m_picture_header);
-            if (cur_pic->m_picture_header.picture_coding_type == picture_coding_type_pred || cur_pic->m_picture_header.picture_coding_type == picture_coding_type_intra) {
-                cur_pic->add_dependency(ref_frames[1]);
-                ref_frames[0] = ref_frames[1];
-                ref_frames[1] = cur_pic;
-            } else
-                for (auto* pic : ref_frames) cur_pic->add_dependency(pic);
-            break;
-        case user_data_start_code: decode_user_data(); break;
-        case sequence_error_code:
-        case sequence_end_code:
-            flush(cur_pic);
-            sequence_end = true;
+void mp2v_decoder_c::decode_unit(uint8_t* ptr, uint8_t* end) {
+    m_bs.set_bitstream_buffer(ptr, end ? end : m_buffer_end);
+    uint8_t start_code = *(ptr + 3);
+    switch (start_code) {
+    case sequence_header_code: parse_sequence_header(&m_bs, m_sequence_header); load_sequence_quantiser_matrices(); m_sequence_end = false; break;
+    case extension_start_code: decode_extension_data(m_cur_pic);                break;
+    case group_start_code:     parse_group_of_pictures_header(&m_bs, *(m_group_of_pictures_header = new group_of_pictures_header_t)); break;
+    case picture_start_code: {
+        picture_header_t ph = { 0 };
+        parse_picture_header(&m_bs, ph);
+        int64_t pts = take_pts();
+        if (m_cur_pic) out_pic(m_cur_pic);
+        m_cur_pic = nullptr;
+        // stream joined in the middle: wait for a sequence header and skip pictures with missing references,
+        // leading B-pictures of a closed GOP only predict from the following I-picture
+        bool closed_gop = m_group_of_pictures_header && m_group_of_pictures_header->closed_gop;
+        bool has_refs = (ph.picture_coding_type == picture_coding_type_intra) ||
+            (ph.picture_coding_type == picture_coding_type_pred && ref_frames[1]) ||
+            (ph.picture_coding_type == picture_coding_type_bidir && ref_frames[1] && (ref_frames[0] || closed_gop));
+        if (!m_sequence_header.horizontal_size_value || m_sequence_end || !has_refs)
             break;
-        default:
-            if ((start_code >= slice_start_code_min) && (start_code <= slice_start_code_max)) {
-                if (new_picture) cur_pic->init();
+        m_new_picture = true;
+        m_cur_pic = new_pic();
+        m_cur_pic->get_frame()->m_pts = pts;
+        m_cur_pic->m_picture_header = ph;
+        if (m_cur_pic->m_picture_header.picture_coding_type == picture_coding_type_pred || m_cur_pic->m_picture_header.picture_coding_type == picture_coding_type_intra) {
+            m_cur_pic->add_dependency(ref_frames[1]);
+            ref_frames[0] = ref_frames[1];
+            ref_frames[1] = m_cur_pic;
+        } else
+            for (auto* pic : ref_frames) m_cur_pic->add_dependency(pic);
+        break;
+    }
+    case user_data_start_code: decode_user_data(); break;
+    case sequence_error_code:
+    case sequence_end_code:
+        // output the whole sequence but keep the queue running, the next sequence starts without references
+        if (m_cur_pic) {
+            m_cur_pic->m_sequence_end = true;
+            out_pic(m_cur_pic);
+        }
+        m_cur_pic = nullptr;
+        ref_frames[0] = ref_frames[1] = nullptr;
+        m_sequence_end = true;
+        break;
+    default:
+        if ((start_code >= slice_start_code_min) && (start_code <= slice_start_code_max)) {
+            if (!m_cur_pic) break; // stream joined in the middle of a picture
+            if (m_new_picture) m_cur_pic->init();
 #ifdef MP2V_MT
-                auto tsk = new mp2v_slice_task_c();
+            auto tsk = m_cur_pic->new_slice_task();
+            if (end) {
+                // input buffer will be reused, keep a zero padded copy of the slice
+                tsk->data.assign(ptr, end);
+                tsk->data.resize(tsk->data.size() + STREAM_PADDING, 0);
+                tsk->bs.set_bitstream_buffer(&tsk->data[0], &tsk->data[end - ptr]);
+            } else
                 tsk->bs = m_bs;
-                cur_pic->add_slice_task(tsk);
+            m_cur_pic->add_slice_task(tsk);
 #else
-                cur_pic->decode_slice(m_bs);
+            m_cur_pic->decode_slice(m_bs);
 #endif
-                new_picture = false;
-            }
+            m_new_picture = false;
         }
+    }
+}
+
+#ifdef MP2V_MT
+void mp2v_decoder_c::build_start_codes_index(uint8_t* buffer, size_t len) {
+    int num_chunks = (int)((len + SCAN_CHUNK_SIZE - 1) / SCAN_CHUNK_SIZE);
+    std::vector<slice_task_c*> tasks(num_chunks);
+    m_scan_tasks.resize(num_chunks);
+    m_scan_done.store(0);
+    for (int i = 0; i < num_chunks; i++) {
+        auto& tsk = m_scan_tasks[i];
+        tsk.begin = buffer + (size_t)i * SCAN_CHUNK_SIZE;
+        tsk.end = std::min(tsk.begin + SCAN_CHUNK_SIZE, buffer + len);
+        tsk.num_done = &m_scan_done;
+        tsk.isa = m_kernels.isa;
+        tasks[i] = &tsk;
+    }
+
+    // calling thread takes its share of chunks as well
+    task_queue->add_side_tasks(&tasks[0], num_chunks);
+    while (auto* tsk = task_queue->get_side_task())
+        tsk->decode();
+    while (m_scan_done.load() < num_chunks)
+        std::this_thread::yield();
+}
+#endif
+
+bool mp2v_decoder_c::decode(uint8_t* buffer, size_t len) {
+    m_buffer_end = buffer + len;
+#ifdef MP2V_MT
+    if (m_parallel_scan && len > SCAN_CHUNK_SIZE) {
+        build_start_codes_index(buffer, len);
+        for (auto& tsk : m_scan_tasks)
+            for (auto* ptr : tsk.start_codes)
+                decode_unit(ptr, nullptr);
+    }
+    else
+#endif
+    scan_start_codes(m_kernels.isa, buffer, buffer + len, [&](uint8_t* ptr) {
+        decode_unit(ptr, nullptr);
         });
-    if (!sequence_end)
-        flush(cur_pic);
+    flush(m_cur_pic);
+    return true;
+}
+
+// Random access by the sidecar index: sequence header and its extensions are taken from the last one before the
+// I-picture, then the stream is decoded from the GOP header of the I-picture. Leading B-pictures of an open GOP
+// are dropped as pictures with missing references.
+bool mp2v_decoder_c::decode(uint8_t* buffer, size_t len, const stream_index_c& index, uint32_t picture_number) {
+    const stream_index_entry_t* pic = index.find_intra_picture(picture_number);
+    const stream_index_entry_t* seq = pic ? index.find_sequence_header(pic) : nullptr;
+    if (!seq || index.get_stream_size() != len) {
+        flush();
+        return false;
+    }
+    const stream_index_entry_t* rap = index.find_random_access_point(pic);
+    if (seq < rap) {
+        m_buffer_end = buffer + len;
+        scan_start_codes(m_kernels.isa, buffer + seq[0].offset, buffer + seq[1].offset, [&](uint8_t* ptr) {
+            decode_unit(ptr, nullptr);
+            });
+    }
+    return decode(buffer + rap->offset, len - rap->offset);
+}
+
+// pts of the last pushed chunk that starts at or before the picture start code
+int64_t mp2v_decoder_c::take_pts() {
+    int64_t pts = PTS_UNDEFINED;
+    while (!m_pts_queue.empty() && m_pts_queue.front().first <= m_unit_offset) {
+        pts = m_pts_queue.front().second;
+        m_pts_queue.pop_front();
+    }
+    return pts;
+}
+
+bool mp2v_decoder_c::push(const uint8_t* data, int len, int64_t pts) {
+    if (pts != PTS_UNDEFINED)
+        m_pts_queue.push_back({ m_stream_offset + m_stream_size, pts });
+    m_stream.resize(m_stream_size + len + STREAM_PADDING);
+    memcpy(&m_stream[m_stream_size], data, len);
+    m_stream_size += len;
+    memset(&m_stream[m_stream_size], 0, STREAM_PADDING);
+
+    // a unit is decoded when the start code of the next one is found
+    uint8_t* base = &m_stream[0];
+    uint8_t* end = base + m_stream_size;
+    scan_start_codes(m_kernels.isa, base + m_scan_pos, end, [&](uint8_t* ptr) {
+        if (ptr + 4 > end) return; // start code is split, wait for the next chunk
+        if (m_unit_pos >= 0) {
+            // the next start code stands in for the zero guard words while the unit is decoded, a truncated
+            // header or slice must not read it as its own bits
+            uint8_t next[STREAM_PADDING];
+            memcpy(next, ptr, STREAM_PADDING);
+            memset(ptr, 0, STREAM_PADDING);
+            m_unit_offset = m_stream_offset + m_unit_pos;
+            decode_unit(base + m_unit_pos, ptr);
+            memcpy(ptr, next, STREAM_PADDING);
+        }
+        m_unit_pos = ptr - base;
+        });
+    m_scan_pos = m_stream_size > 3 ? m_stream_size - 3 : 0;
+
+    // drop consumed input
+    size_t consumed = (m_unit_pos >= 0) ? m_unit_pos : m_scan_pos;
+    if (consumed) {
+        m_stream.erase(m_stream.begin(), m_stream.begin() + consumed);
+        m_stream_size -= consumed;
+        m_stream_offset += consumed;
+        m_scan_pos -= consumed;
+        if (m_unit_pos >= 0) m_unit_pos -= consumed;
+    }
+    return true;
+}
+
+// The staged data is the unit cut by the loss, or bytes ahead of its start code, so all of it is dropped
+void mp2v_decoder_c::discontinuity() {
+    m_stream_offset += m_stream_size;
+    m_stream_size = 0;
+    m_scan_pos = 0;
+    m_unit_pos = -1;
+    while (!m_pts_queue.empty() && m_pts_queue.front().first < m_stream_offset)
+        m_pts_queue.pop_front();
+}
+
+bool mp2v_decoder_c::end_of_stream() {
+    if (m_unit_pos >= 0) {
+        m_unit_offset = m_stream_offset + m_unit_pos;
+        decode_unit(&m_stream[m_unit_pos], &m_stream[m_stream_size]);
+    }
+    m_stream.clear();
+    m_stream_offset = 0;
+    m_pts_queue.clear();
+    m_stream_size = 0;
+    m_scan_pos = 0;
+    m_unit_pos = -1;
+    flush(m_cur_pic);
     return true;
 }
 
@@ -333,10 +602,19 @@ void mp2v_slice_task_c::decode() {
     pic->decode_slice(bs);
 }
 
+// chunk owns the start codes beginning inside [begin, end)
+void mp2v_scan_task_c::decode() {
+    start_codes.clear();
+    scan_start_codes(isa, begin, end, [&](uint8_t* ptr) {
+        start_codes.push_back(ptr);
+        });
+    (*num_done)++;
+}
+
 #ifdef MP2V_MT
 void mp2v_decoder_c::threadpool_task_scheduler(mp2v_decoder_c* dec) {
-    mp2v_slice_task_c* slice_task = nullptr;
-    while (dec->task_queue->get_task((slice_task_c*&)slice_task) == TASK_QUEUE_SUCCESS) {
+    slice_task_c* slice_task = nullptr;
+    while (dec->task_queue->get_task(slice_task) == TASK_QUEUE_SUCCESS) {
         slice_task->decode();
         slice_task->done();
     }
@@ -350,6 +628,7 @@ void mp2v_decoder_c::decoder_output_scheduler(mp2v_decoder_c* dec) {
     while (1) {
         pic = (mp2v_picture_c*)dec->task_queue->get_decoded();
         if (!pic) break;
+        bool sequence_end = pic->m_sequence_end; // pic may be reused once rendered
         if (pic->m_picture_header.picture_coding_type == picture_coding_type_bidir || !dec->reordering) {
             dec->render_func(pic->get_frame());
             pic->render_done();
@@ -362,6 +641,13 @@ void mp2v_decoder_c::decoder_output_scheduler(mp2v_decoder_c* dec) {
                 refs[0]->render_done();
             }
         }
+        if (sequence_end) {
+            if (refs[1]) {
+                dec->render_func(refs[1]->get_frame());
+                refs[1]->render_done();
+            }
+            refs[0] = refs[1] = nullptr;
+        }
     }
     if (refs[1]) {
         dec->render_func(refs[1]->get_frame());
@@ -383,18 +669,26 @@ bool mp2v_decoder_c::decoder_init(const decoder_config_t &config, std::function<
     int width = config.width;
     int height = config.height;
     int chroma_format = config.chroma_format;
+    int padding = config.frame_padding;
     reordering = config.reordering;
+    m_two_phase = config.two_phase;
+    m_prefetch = config.prefetch;
+    cpu_dispatch_init(m_kernels, config.cpu_isa, config.idct_accuracy);
+    load_sequence_quantiser_matrices(); // defaults until a sequence header arrives
+#ifdef MP2V_MT
+    m_parallel_scan = config.parallel_scan;
+#endif
     render_func = renderer;
 
 #ifdef MP2V_MT
     task_queue = new task_queue_c(num_pics, [&]() -> picture_task_c* {
-        return new mp2v_picture_c(this, new frame_c(width, height, chroma_format));
+        return new mp2v_picture_c(this, new frame_c(width, height, chroma_format, padding));
         });
     for (int i = 0; i < config.num_threads; i++)
         thread_pool[i] = new std::thread(threadpool_task_scheduler, this);
 #else
     for (int i = 0; i < num_pics; i++) {
-        auto pic = new mp2v_picture_c(this, new frame_c(width, height, chroma_format));
+        auto pic = new mp2v_picture_c(this, new frame_c(width, height, chroma_format, padding));
         m_pictures_pool.push_back(pic);
         m_free_pics.push(pic);
     }
@@ -1,6 +1,7 @@
 // Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
 #pragma once
 #include <deque>
+#include <memory>
 #include <vector>
 #include <atomic>
 #include <thread>
@@ -12,15 +13,21 @@
 #include "bitstream.h"
 #include "mb_decoder.h"
 #include "threads.h"
+#include "kernels.h"
 
 #define MP2V_MT
 
 constexpr int MAX_NUM_THREADS = 256;
 constexpr int MAX_B_FRAMES = 8;
 constexpr int CACHE_LINE = 64;
+constexpr int STREAM_PADDING = 80; // zero tail required by the start code scanners and the bitstream reader
+constexpr int SCAN_CHUNK_SIZE = 1 << 20;
+constexpr int FRAME_PADDING = 32; // guard band of the sample, vectors may reach this far past the picture edges
+constexpr int64_t PTS_UNDEFINED = -1;
 
 class mp2v_picture_c;
 class mp2v_decoder_c;
+class stream_index_c;
 
 struct decoder_config_t {
     int width;
@@ -29,46 +36,82 @@ struct decoder_config_t {
     int pictures_pool_size;
     int num_threads;
     bool reordering;
+    bool parallel_scan; // index start codes of large buffers on the thread pool before decoding
+    bool two_phase;     // parse batches of macroblocks before motion compensation and IDCT
+    cpu_isa_e cpu_isa;  // kernel level of this decoder, see cpu_dispatch_init()
+    idct_accuracy_e idct_accuracy; // IDCT accuracy of this decoder, the fast one by default. The conformant one has
+                                   // SSE2 kernels only, aarch64 and cpu_isa_c run it in scalar C
+    int frame_padding;  // guard band around the planes in luma samples, rounded up to 32, 0 - none
+    bool prefetch;      // prefetch the reference areas of the macroblocks ahead of the reconstruction, two_phase only
 };
 
 class frame_c {
     friend class mp2v_picture_c;
+    friend class mp2v_decoder_c;
 public:
-    frame_c(int width, int height, int chroma_format);
+    frame_c(int width, int height, int chroma_format, int padding = 0);
     ~frame_c();
 
     uint8_t* get_planes (int plane_idx) { return m_planes[plane_idx]; }
     int      get_strides(int plane_idx) { return m_stride[plane_idx]; }
     int      get_width  (int plane_idx) { return m_width [plane_idx]; }
     int      get_height (int plane_idx) { return m_height[plane_idx]; }
+    int64_t  get_pts() { return m_pts; } // 90 kHz presentation time stamp of the container, if any
 private:
+    void extend_borders(uint32_t width, uint32_t height); // replicates the edges of the width x height luma area into the guard band
+
+    int64_t  m_pts = PTS_UNDEFINED;
     uint32_t m_width [3] = { 0 };
     uint32_t m_height[3] = { 0 };
     uint32_t m_stride[3] = { 0 };
-    uint8_t* m_planes[3] = { 0 };
+    uint32_t m_pad_x [3] = { 0 };
+    uint32_t m_pad_y [3] = { 0 };
+    uint8_t* m_planes[3] = { 0 }; // top left sample of the picture
+    uint8_t* m_buffers[3] = { 0 };
 };
 
 class mp2v_slice_task_c : public slice_task_c {
 public:
     bitstream_reader_c bs;
+    std::vector<uint8_t> data; // own copy of the slice for the streaming input, the staging buffer is reused
+    void decode();
+};
+
+class mp2v_scan_task_c : public slice_task_c {
+public:
+    uint8_t* begin = nullptr;
+    uint8_t* end = nullptr;
+    std::vector<uint8_t*> start_codes;
+    std::atomic<int>* num_done = nullptr;
+    cpu_isa_e isa = cpu_isa_c;
     void decode();
 };
 
 class mp2v_picture_c : public picture_task_c {
 public:
     mp2v_picture_c(mp2v_decoder_c* decoder, frame_c* frame) : m_dec(decoder), m_frame(frame) {};
+    ~mp2v_picture_c();
     void init();
+    void reset();
+    void completed() override;
+    mp2v_slice_task_c* new_slice_task();
     void attach(frame_c* frame) { m_frame = frame; }
     bool decode_slice(bitstream_reader_c bs);
     frame_c* get_frame() { return m_frame; }
 
 private:
     mp2v_decoder_c* m_dec;
-    uint8_t quantiser_matrices[4][64];
+    std::shared_ptr<const quant_tables_t> m_quant_tables;
     parse_macroblock_func_t m_parse_macroblock_func = nullptr;
+    reconstruct_macroblocks_func_t m_reconstruct_macroblocks_func = nullptr; // two-phase decoding only
     frame_c* m_frame;
+    std::vector<mp2v_slice_task_c*> m_slices_pool;
+    int m_num_slices = 0;
+    uint32_t m_coded_width = 0;  // luma size of the macroblock grid of the sequence, the frame may be larger
+    uint32_t m_coded_height = 0;
 
 public:
+    bool m_sequence_end = false; // last picture of a sequence, the pictures held for reordering are output after it
     // headers
     picture_header_t m_picture_header = { 0 }; //mandatory
     picture_coding_extension_t m_picture_coding_extension = { 0 }; //mandatory
@@ -96,17 +139,47 @@ public:
     };
     ~mp2v_decoder_c();
     bool decoder_init(const decoder_config_t& config, std::function<void(frame_c*)> renderer);
-    bool decode(uint8_t* buffer, int len);
+    bool decode(uint8_t* buffer, size_t len); // buffer must be followed by STREAM_PADDING readable zero bytes
+    bool decode(uint8_t* buffer, size_t len, const stream_index_c& index, uint32_t picture_number); // from the nearest I-picture at or before picture_number
+    // Streaming input: data is staged in an internal buffer until the start code of the next unit arrives, the units
+    // are decoded from there. pts belongs to the first picture starting in data.
+    bool push(const uint8_t* data, int len, int64_t pts = PTS_UNDEFINED);
+    void discontinuity(); // input was lost since the last push(), decoding resumes at the next start code
+    bool end_of_stream();
     void flush(mp2v_picture_c* cur_pic = nullptr);
 
 protected:
+    void decode_unit(uint8_t* ptr, uint8_t* end);
+    int64_t take_pts();
+    void build_start_codes_index(uint8_t* buffer, size_t len);
     bool decode_user_data();
     bool decode_extension_data(mp2v_picture_c* pic);
     mp2v_picture_c* new_pic();
     void out_pic(mp2v_picture_c* cur_pic);
+    void load_sequence_quantiser_matrices();
+    void load_quant_matrix_extension(const quant_matrix_extension_t& qmext);
+    void set_quantiser_matrices(const uint8_t matrices[4][64]);
     bool reordering = true;
+    bool m_two_phase = false;
+    bool m_prefetch = false;
+    kernels_t m_kernels;
     bitstream_reader_c m_bs;
     mp2v_picture_c* ref_frames[2] = { 0 };
+    mp2v_picture_c* m_cur_pic = nullptr;
+    // quantiser matrices in force, in zigzag scan order as transmitted, see quant_tables_t for their order
+    uint8_t m_quantiser_matrices[4][64];
+    std::shared_ptr<const quant_tables_t> m_quant_tables;
+    bool m_new_picture = false;
+    bool m_sequence_end = false; // no sequence header since the last sequence end, pictures are skipped
+    uint8_t* m_buffer_end = nullptr; // end of the buffer passed to decode()
+    // streaming input: unconsumed bytes starting from the pending unit
+    std::vector<uint8_t> m_stream;
+    size_t m_stream_size = 0;
+    size_t m_scan_pos = 0;
+    ptrdiff_t m_unit_pos = -1;
+    uint64_t m_stream_offset = 0; // stream position of m_stream[0]
+    uint64_t m_unit_offset = 0;   // stream position of the unit being decoded
+    std::deque<std::pair<uint64_t, int64_t>> m_pts_queue; // stream position a pts was pushed at
     std::function<void(frame_c*)> render_func;
     std::thread* render_thread = nullptr;
     static void decoder_output_scheduler(mp2v_decoder_c* dec);
@@ -114,6 +187,9 @@ protected:
     static void threadpool_task_scheduler(mp2v_decoder_c *dec);
     std::thread* thread_pool[MAX_NUM_THREADS] = { 0 };
     task_queue_c* task_queue = nullptr;
+    bool m_parallel_scan = false;
+    std::vector<mp2v_scan_task_c> m_scan_tasks;
+    std::atomic<int> m_scan_done{ 0 };
 #else
     ThreadSafeQ<mp2v_picture_c*> m_done_pics;
     ThreadSafeQ<mp2v_picture_c*> m_free_pics;
@@ -0,0 +1,236 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#include <string.h>
+#include <algorithm>
+#include "demuxer.h"
+
+static int64_t parse_timestamp(const uint8_t* ptr) {
+    return ((int64_t)((ptr[0] >> 1) & 0x07) << 30) | ((int64_t)ptr[1] << 22) | ((int64_t)(ptr[2] >> 1) << 15) | ((int64_t)ptr[3] << 7) | (ptr[4] >> 1);
+}
+
+void pes_parser_c::start_packet() {
+    m_header_size = 0;
+    m_in_header = true;
+    m_skip = false;
+}
+
+void pes_parser_c::discontinuity() {
+    if (m_in_header) {
+        m_in_header = false;
+        m_skip = true;
+    }
+}
+
+// ISO/IEC 13818-1 : 2000 (E) 2.4.3.6 PES packet
+void pes_parser_c::parse_header() {
+    uint8_t* hdr = m_header_data;
+    m_header.stream_id = hdr[3];
+    m_header.pts = PTS_UNDEFINED;
+    m_header.dts = PTS_UNDEFINED;
+    int pts_dts_flags = hdr[7] >> 6;
+    if (pts_dts_flags & 2) m_header.pts = parse_timestamp(&hdr[9]);
+    if (pts_dts_flags == 3) m_header.dts = parse_timestamp(&hdr[14]);
+}
+
+void pes_parser_c::push(const uint8_t* data, int len) {
+    if (m_in_header) {
+        int n = std::min(PES_FIXED_HEADER_SIZE - m_header_size, len);
+        if (n > 0) {
+            memcpy(&m_header_data[m_header_size], data, n);
+            m_header_size += n;
+            data += n;
+            len -= n;
+        }
+        if (m_header_size < PES_FIXED_HEADER_SIZE)
+            return;
+        // video stream ids only, those always carry the optional header
+        uint8_t* hdr = m_header_data;
+        if (hdr[0] != 0 || hdr[1] != 0 || hdr[2] != 1 || (hdr[3] & 0xf0) != 0xe0 || (hdr[6] & 0xc0) != 0x80) {
+            m_in_header = false;
+            m_skip = true;
+            return;
+        }
+        int header_size = PES_FIXED_HEADER_SIZE + hdr[8];
+        n = std::min(header_size - m_header_size, len);
+        memcpy(&m_header_data[m_header_size], data, n);
+        m_header_size += n;
+        data += n;
+        len -= n;
+        if (m_header_size < header_size)
+            return;
+        parse_header();
+        m_pts = m_header.pts;
+        m_in_header = false;
+    }
+    if (m_skip || len <= 0)
+        return;
+    m_dec->push(data, len, m_pts);
+    m_pts = PTS_UNDEFINED;
+}
+
+// ISO/IEC 13818-1 : 2000 (E) 2.4.4.3 Program association table
+void ts_demuxer_c::parse_pat(const uint8_t* section, const uint8_t* end) {
+    if (section + 8 > end || section[0] != 0x00)
+        return;
+    int section_length = ((section[1] & 0x0f) << 8) | section[2];
+    const uint8_t* programs_end = std::min(section + 3 + section_length - 4, end);
+    for (const uint8_t* ptr = section + 8; ptr + 4 <= programs_end; ptr += 4) {
+        int program_number = (ptr[0] << 8) | ptr[1];
+        if (program_number != 0) { // 0 is the network PID
+            m_pmt_pid = ((ptr[2] & 0x1f) << 8) | ptr[3];
+            break;
+        }
+    }
+}
+
+// ISO/IEC 13818-1 : 2000 (E) 2.4.4.8 Program map table
+void ts_demuxer_c::parse_pmt(const uint8_t* section, const uint8_t* end) {
+    if (section + 12 > end || section[0] != 0x02)
+        return;
+    int section_length = ((section[1] & 0x0f) << 8) | section[2];
+    int program_info_length = ((section[10] & 0x0f) << 8) | section[11];
+    const uint8_t* streams_end = std::min(section + 3 + section_length - 4, end);
+    for (const uint8_t* ptr = section + 12 + program_info_length; ptr + 5 <= streams_end; ptr += 5 + (((ptr[3] & 0x0f) << 8) | ptr[4])) {
+        if (ptr[0] == ts_stream_type_mpeg1_video || ptr[0] == ts_stream_type_mpeg2_video) {
+            m_video_pid = ((ptr[1] & 0x1f) << 8) | ptr[2];
+            break;
+        }
+    }
+}
+
+// ISO/IEC 13818-1 : 2000 (E) 2.4.3.2 Transport stream packet layer
+void ts_demuxer_c::parse_packet(const uint8_t* packet) {
+    const uint8_t* end = packet + TS_PACKET_SIZE;
+    bool transport_error_indicator    = (packet[1] & 0x80) != 0;
+    bool payload_unit_start_indicator = (packet[1] & 0x40) != 0;
+    int  pid = ((packet[1] & 0x1f) << 8) | packet[2];
+    int  adaptation_field_control = (packet[3] >> 4) & 0x03;
+    int  continuity_counter = packet[3] & 0x0f;
+
+    if (transport_error_indicator || !(adaptation_field_control & 1))
+        return;
+    const uint8_t* payload = packet + 4;
+    if (adaptation_field_control & 2)
+        payload += 1 + packet[4];
+    if (payload >= end)
+        return;
+
+    if (pid == m_video_pid) {
+        if (continuity_counter == m_continuity_counter)
+            return; // duplicate packet
+        // a gap is lost packets, unless the adaptation field announces a discontinuity
+        bool discontinuity_indicator = (adaptation_field_control & 2) && packet[4] && (packet[5] & 0x80);
+        if (m_continuity_counter >= 0 && continuity_counter != ((m_continuity_counter + 1) & 0x0f) && !discontinuity_indicator) {
+            m_discontinuities++;
+            m_pes.discontinuity();
+            m_dec->discontinuity();
+        }
+        m_continuity_counter = continuity_counter;
+        if (payload_unit_start_indicator)
+            m_pes.start_packet();
+        m_pes.push(payload, (int)(end - payload));
+    }
+    else if (m_video_pid == TS_PID_AUTO && payload_unit_start_indicator) {
+        const uint8_t* section = payload + 1 + payload[0]; // pointer_field
+        if (pid == TS_PID_PAT)
+            parse_pat(section, end);
+        else if (pid == m_pmt_pid)
+            parse_pmt(section, end);
+    }
+}
+
+bool ts_demuxer_c::push(const uint8_t* data, size_t len) {
+    const uint8_t* end = data + len;
+
+    // complete the packet left over from the previous chunk
+    if (m_packet_size) {
+        size_t n = std::min<size_t>(TS_PACKET_SIZE - m_packet_size, len);
+        memcpy(&m_packet[m_packet_size], data, n);
+        m_packet_size += (int)n;
+        data += n;
+        if (m_packet_size < TS_PACKET_SIZE)
+            return true;
+        parse_packet(m_packet);
+        m_packet_size = 0;
+    }
+
+    while (data < end) {
+        // resync on the next sync byte followed by another one a packet later
+        if (data[0] != TS_SYNC_BYTE || (end - data > TS_PACKET_SIZE && data[TS_PACKET_SIZE] != TS_SYNC_BYTE)) {
+            data++;
+            continue;
+        }
+        if (end - data < TS_PACKET_SIZE) {
+            m_packet_size = (int)(end - data);
+            memcpy(m_packet, data, m_packet_size);
+            break;
+        }
+        parse_packet(data);
+        data += TS_PACKET_SIZE;
+    }
+    return true;
+}
+
+bool ts_demuxer_c::end_of_stream() {
+    m_packet_size = 0;
+    m_continuity_counter = -1;
+    return m_dec->end_of_stream();
+}
+
+// ISO/IEC 13818-1 : 2000 (E) 2.5.3.3 Pack layer of program stream, 2.5.3.5 System header
+void ps_demuxer_c::parse_header() {
+    m_header_size = 0;
+    m_video = false;
+    if (m_header[3] == ps_pack_start_code) {
+        m_remaining = m_header[13] & 0x07; // pack_stuffing_length
+        return;
+    }
+    m_remaining = (m_header[4] << 8) | m_header[5];
+    if (m_header[3] == m_video_stream_id) {
+        m_video = true;
+        m_pes.start_packet();
+        m_pes.push(m_header, PS_PACKET_HEADER_SIZE);
+    }
+}
+
+bool ps_demuxer_c::push(const uint8_t* data, size_t len) {
+    const uint8_t* end = data + len;
+    while (data < end) {
+        // packet body is passed on or dropped as a whole
+        if (m_remaining) {
+            size_t n = std::min<size_t>(m_remaining, end - data);
+            if (m_video)
+                m_pes.push(data, (int)n);
+            data += n;
+            m_remaining -= n;
+            continue;
+        }
+
+        // headers are collected byte by byte, resyncing on the next 0x000001 prefix
+        uint8_t byte = *data++;
+        if (m_header_size < 2 && byte != 0) {
+            m_header_size = 0;
+            continue;
+        }
+        if (m_header_size == 2 && byte != 1) {
+            if (byte != 0) m_header_size = 0;
+            continue;
+        }
+        m_header[m_header_size++] = byte;
+        if (m_header_size < 4)
+            continue;
+        if (m_header[3] <= ps_program_end_code) {
+            m_header_size = 0; // end code or a start code of the elementary stream out of sync
+            continue;
+        }
+        if (m_header_size == ((m_header[3] == ps_pack_start_code) ? PS_PACK_HEADER_SIZE : PS_PACKET_HEADER_SIZE))
+            parse_header();
+    }
+    return true;
+}
+
+bool ps_demuxer_c::end_of_stream() {
+    m_header_size = 0;
+    m_remaining = 0;
+    m_video = false;
+    return m_dec->end_of_stream();
+}
@@ -0,0 +1,98 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "decoder.h"
+
+constexpr int TS_PACKET_SIZE = 188;
+constexpr uint8_t TS_SYNC_BYTE = 0x47;
+constexpr int TS_PID_PAT = 0x0000;
+constexpr int TS_PID_AUTO = -1; // first MPEG-1/MPEG-2 video stream of the first program in the PAT
+constexpr int PS_PACK_HEADER_SIZE = 14;
+constexpr int PS_PACKET_HEADER_SIZE = 6; // start code and packet length of everything but a pack header
+constexpr uint8_t PS_VIDEO_STREAM_ID = 0xe0;
+constexpr int PES_FIXED_HEADER_SIZE = 9;
+constexpr int PES_MAX_HEADER_SIZE = PES_FIXED_HEADER_SIZE + 255;
+
+enum ps_start_code_e {
+    ps_program_end_code = 0xb9,
+    ps_pack_start_code  = 0xba,
+    ps_system_header_start_code = 0xbb
+};
+
+enum ts_stream_type_e {
+    ts_stream_type_mpeg1_video = 0x01,
+    ts_stream_type_mpeg2_video = 0x02
+};
+
+struct pes_header_t {
+    uint8_t stream_id;
+    int64_t pts;
+    int64_t dts;
+};
+
+// Strips PES headers from the payload of one elementary stream and passes the rest to mp2v_decoder_c::push(),
+// the PTS of a PES packet goes along with its first payload byte.
+class pes_parser_c {
+public:
+    pes_parser_c(mp2v_decoder_c* decoder) : m_dec(decoder) {}
+    void start_packet();
+    void push(const uint8_t* data, int len);
+    void discontinuity(); // payload was lost, a PES header it cut is dropped with the rest of its packet
+    pes_header_t& get_header() { return m_header; }
+private:
+    void parse_header();
+
+    mp2v_decoder_c* m_dec;
+    pes_header_t m_header = { 0, PTS_UNDEFINED, PTS_UNDEFINED };
+    uint8_t m_header_data[PES_MAX_HEADER_SIZE]; // header split between transport packets
+    int m_header_size = 0;
+    bool m_in_header = false;
+    bool m_skip = true; // payload of a broken or not yet started PES packet
+    int64_t m_pts = PTS_UNDEFINED;
+};
+
+// MPEG-2 transport stream front end (ISO/IEC 13818-1). Accepts data in chunks of any size and alignment, a packet
+// split between two chunks is reassembled here. The video payload is not contiguous in the packets, it is staged
+// by mp2v_decoder_c::push() which the units are decoded from. PAT/PMT sections are expected to fit into one packet.
+// A gap in the continuity counter of the video PID drops the unit it cut, decoding resumes at the next start code.
+class ts_demuxer_c {
+public:
+    ts_demuxer_c(mp2v_decoder_c* decoder, int video_pid = TS_PID_AUTO) : m_dec(decoder), m_pes(decoder), m_video_pid(video_pid) {}
+    bool push(const uint8_t* data, size_t len);
+    bool end_of_stream();
+    int get_video_pid() { return m_video_pid; }
+    int get_discontinuities() { return m_discontinuities; } // continuity counter gaps of the video PID so far
+private:
+    void parse_packet(const uint8_t* packet);
+    void parse_pat(const uint8_t* section, const uint8_t* end);
+    void parse_pmt(const uint8_t* section, const uint8_t* end);
+
+    mp2v_decoder_c* m_dec;
+    pes_parser_c m_pes;
+    int m_video_pid;
+    int m_pmt_pid = -1;
+    int m_continuity_counter = -1;
+    int m_discontinuities = 0;
+    uint8_t m_packet[TS_PACKET_SIZE];
+    int m_packet_size = 0;
+};
+
+// MPEG-2 program stream front end (ISO/IEC 13818-1 2.5, VOB files). Packets of the selected video stream
+// go through pes_parser_c, all other packets are skipped by their length. MPEG-1 system packs are not supported.
+class ps_demuxer_c {
+public:
+    ps_demuxer_c(mp2v_decoder_c* decoder, uint8_t video_stream_id = PS_VIDEO_STREAM_ID) : m_dec(decoder), m_pes(decoder), m_video_stream_id(video_stream_id) {}
+    bool push(const uint8_t* data, size_t len);
+    bool end_of_stream();
+private:
+    void parse_header();
+
+    mp2v_decoder_c* m_dec;
+    pes_parser_c m_pes;
+    uint8_t m_video_stream_id;
+    uint8_t m_header[PS_PACK_HEADER_SIZE]; // start code and fixed part of the current header
+    int m_header_size = 0;
+    size_t m_remaining = 0; // bytes left in the current packet body or pack stuffing
+    bool m_video = false;   // current packet body belongs to the video stream
+};
@@ -0,0 +1,48 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#include "idct.h"
+#include "kernels.h"
+#include "idct_c.hpp"
+#if defined(CPU_PLATFORM_AARCH64)
+#include "idct_aarch64.hpp"
+#elif defined(CPU_PLATFORM_X64)
+#include "idct_sse2.hpp"
+#include "idct_avx2.hpp"
+#endif
+
+#define IDCT_BIND(suffix, ignores_mismatch_bit) \
+    kernels.inverse_dct[0]     = inverse_dct_template##suffix<false>;     kernels.inverse_dct[1]     = inverse_dct_template##suffix<true>; \
+    kernels.inverse_dct_4x4[0] = inverse_dct_4x4_template##suffix<false>; kernels.inverse_dct_4x4[1] = inverse_dct_4x4_template##suffix<true>; \
+    kernels.inverse_dct_dc[0]  = inverse_dct_dc_template##suffix<false>;  kernels.inverse_dct_dc[1]  = inverse_dct_dc_template##suffix<true>; \
+    kernels.idct_ignores_mismatch_bit = ignores_mismatch_bit;
+
+void idct_init(kernels_t& kernels, cpu_isa_e isa, idct_accuracy_e accuracy) {
+    kernels.inverse_dct_x2[0] = nullptr;
+    kernels.inverse_dct_x2[1] = nullptr;
+    if (accuracy == idct_accuracy_conformant) {
+#if defined(CPU_PLATFORM_X64)
+        if (isa == cpu_isa_sse2 || isa == cpu_isa_avx2) {
+            IDCT_BIND(_conformant, IDCT_C_IGNORES_MISMATCH_BIT);
+            return;
+        }
+#endif
+        isa = cpu_isa_c; // the C kernel is the conformant one, there is no NEON conformant kernel yet
+    }
+    switch (isa) {
+#if defined(CPU_PLATFORM_AARCH64)
+    case cpu_isa_neon:
+        IDCT_BIND(, IDCT_IGNORES_MISMATCH_BIT);
+        break;
+#elif defined(CPU_PLATFORM_X64)
+    case cpu_isa_avx2:
+        kernels.inverse_dct_x2[0] = inverse_dct_x2_template<false>;
+        kernels.inverse_dct_x2[1] = inverse_dct_x2_template<true>;
+        IDCT_BIND(, IDCT_IGNORES_MISMATCH_BIT);
+        break;
+    case cpu_isa_sse2:
+        IDCT_BIND(, IDCT_IGNORES_MISMATCH_BIT);
+        break;
+#endif
+    default:
+        IDCT_BIND(_c, IDCT_C_IGNORES_MISMATCH_BIT);
+    }
+}
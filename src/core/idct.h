@@ -0,0 +1,10 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#pragma once
+#include <stdint.h>
+#include "cpu_dispatch.h"
+
+typedef void(*idct_func_t)(uint8_t* plane, int16_t F[64], int stride);
+typedef void(*idct_x2_func_t)(uint8_t* plane0, uint8_t* plane1, int16_t F0[64], int16_t F1[64], int stride);
+
+struct kernels_t;
+void idct_init(kernels_t& kernels, cpu_isa_e isa, idct_accuracy_e accuracy); // see cpu_dispatch_init()
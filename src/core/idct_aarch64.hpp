@@ -4,6 +4,9 @@
 #include "arm_neon.h"
 #include "common/cpu.hpp"
 
+// F[7][7] = 1 set by mismatch control is lost in the first pass (v27 = 0), so it doesn't count as a coefficient
+constexpr bool IDCT_IGNORES_MISMATCH_BIT = true;
+
 MP2V_INLINE int16x8_t vmul_coeff_s16(int16x8_t src, int32_t coeff) {
     const int32x4_t vcof = vdupq_n_s32(coeff);
     const int32x4_t src0 = vmovl_s16(vget_low_s16(src));
@@ -13,27 +16,29 @@ MP2V_INLINE int16x8_t vmul_coeff_s16(int16x8_t src, int32_t coeff) {
     return vcombine_s16(res0, res1);
 }
 
+// half: src[4..7] are zero, additions of a zero operand are left out
+template<bool half = false>
 MP2V_INLINE void idct_1d_aarch64(int16x8_t(&src)[8]) {
     // step 0
     const int16x8_t v15 = vmul_coeff_s16(src[0], 185364);
     const int16x8_t v26 = vmul_coeff_s16(src[1], 257107);
     const int16x8_t v21 = vmul_coeff_s16(src[2], 242189);
     const int16x8_t v28 = vmul_coeff_s16(src[3], 217965);
-    const int16x8_t v16 = vmul_coeff_s16(src[4], 185364);
-    const int16x8_t v25 = vmul_coeff_s16(src[5], 145639);
-    const int16x8_t v22 = vmul_coeff_s16(src[6], 100318);
-    const int16x8_t v27 = vmul_coeff_s16(src[7],  51142);
+    const int16x8_t v16 = half ? vdupq_n_s16(0) : vmul_coeff_s16(src[4], 185364);
+    const int16x8_t v25 = half ? vdupq_n_s16(0) : vmul_coeff_s16(src[5], 145639);
+    const int16x8_t v22 = half ? vdupq_n_s16(0) : vmul_coeff_s16(src[6], 100318);
+    const int16x8_t v27 = half ? vdupq_n_s16(0) : vmul_coeff_s16(src[7],  51142);
     // step 1
-    const int16x8_t v19 = vsubq_s16(v25, v28); // /2
-    const int16x8_t v20 = vsubq_s16(v26, v27); // /2
-    const int16x8_t v23 = vaddq_s16(v26, v27); // /2
-    const int16x8_t v24 = vaddq_s16(v25, v28); // /2
+    const int16x8_t v19 = half ? vnegq_s16(v28) : vsubq_s16(v25, v28); // /2
+    const int16x8_t v20 = half ? v26 : vsubq_s16(v26, v27); // /2
+    const int16x8_t v23 = half ? v26 : vaddq_s16(v26, v27); // /2
+    const int16x8_t v24 = half ? v28 : vaddq_s16(v25, v28); // /2
     const int16x8_t v7  = vaddq_s16(v23, v24); // /4
-    const int16x8_t v11 = vaddq_s16(v21, v22); // /2
+    const int16x8_t v11 = half ? v21 : vaddq_s16(v21, v22); // /2
     const int16x8_t v13 = vsubq_s16(v23, v24); // /4
-    const int16x8_t v17 = vsubq_s16(v21, v22); // /2
-    const int16x8_t v8  = vaddq_s16(v15, v16); // /2
-    const int16x8_t v9  = vsubq_s16(v15, v16); // /2
+    const int16x8_t v17 = half ? v21 : vsubq_s16(v21, v22); // /2
+    const int16x8_t v8  = half ? v15 : vaddq_s16(v15, v16); // /2
+    const int16x8_t v9  = half ? v15 : vsubq_s16(v15, v16); // /2
     // step 2
     const int16x8_t v18 = vmul_coeff_s16(vsubq_s16(v19, v20), 25079); //(v19 - v20) * s1[4]; /2
     const int16x8_t v12 = vsubq_s16(v18, vmul_coeff_s16(v19, 85626)); // v18 - v19 * s1[3];  /2
@@ -85,15 +90,7 @@ MP2V_INLINE void transpose_8x8_aarch64(int16x8_t(&src)[8]) {
 }
 
 template<bool add>
-void inverse_dct_template(uint8_t* plane, int16_t F[64], int stride) {
-    int16x8_t buffer[8];
-    for (int i = 0; i < 8; i++)
-        buffer[i] = vld1q_s16(&F[i*8]);
-
-    idct_1d_aarch64(buffer);
-    transpose_8x8_aarch64(buffer);
-    idct_1d_aarch64(buffer);
-
+MP2V_INLINE void store_idct_block_aarch64(uint8_t* plane, int16x8_t(&buffer)[8], int stride) {
     for (int i = 0; i < 4; i++) {
         if (add) {
             int16x8_t b0 = vshrq_n_s16(buffer[i * 2], 6);
@@ -109,3 +106,59 @@ void inverse_dct_template(uint8_t* plane, int16_t F[64], int stride) {
         }
     }
 }
+
+template<bool add>
+void inverse_dct_template(uint8_t* plane, int16_t F[64], int stride) {
+    int16x8_t buffer[8];
+    for (int i = 0; i < 8; i++)
+        buffer[i] = vld1q_s16(&F[i*8]);
+
+    idct_1d_aarch64(buffer);
+    transpose_8x8_aarch64(buffer);
+    idct_1d_aarch64(buffer);
+    store_idct_block_aarch64<add>(plane, buffer, stride);
+}
+
+// Nonzero coefficients within F[0..3][0..3]: the first pass leaves columns 4..7 zero, so rows 4..7
+// of the transposed block are zero as well and both passes skip that half of their input.
+template<bool add>
+void inverse_dct_4x4_template(uint8_t* plane, int16_t F[64], int stride) {
+    int16x8_t buffer[8];
+    for (int i = 0; i < 4; i++)
+        buffer[i] = vld1q_s16(&F[i*8]);
+    for (int i = 4; i < 8; i++)
+        buffer[i] = vdupq_n_s16(0);
+
+    idct_1d_aarch64<true>(buffer);
+    transpose_8x8_aarch64(buffer);
+    idct_1d_aarch64<true>(buffer);
+    store_idct_block_aarch64<add>(plane, buffer, stride);
+}
+
+// Adds a flat residual to the prediction in place. The residual is split into its positive and negative parts
+// clamped to bytes, so pixels stay 8 bit wide and two rows go through one saturating add/sub pair.
+MP2V_INLINE void add_dc_block_aarch64(uint8_t* plane, int16x8_t dc, int stride) {
+    if (vgetq_lane_s16(dc, 0) == 0)
+        return; // residual rounds to zero, the prediction is the result
+    uint8x16_t pos = vcombine_u8(vqmovun_s16(dc), vqmovun_s16(dc));
+    uint8x16_t neg = vcombine_u8(vqmovun_s16(vnegq_s16(dc)), vqmovun_s16(vnegq_s16(dc)));
+    for (int i = 0; i < 8; i += 2) {
+        uint8x16_t dst = vcombine_u8(vld1_u8(&plane[(i + 0) * stride]), vld1_u8(&plane[(i + 1) * stride]));
+        dst = vqsubq_u8(vqaddq_u8(dst, pos), neg);
+        vst1_u8(&plane[(i + 0) * stride], vget_low_u8(dst));
+        vst1_u8(&plane[(i + 1) * stride], vget_high_u8(dst));
+    }
+}
+
+// F[0][0] only: every output of both passes is the v15 term, the block is flat
+template<bool add>
+void inverse_dct_dc_template(uint8_t* plane, int16_t F[64], int stride) {
+    int16x8_t dc = vmul_coeff_s16(vmul_coeff_s16(vdupq_n_s16(F[0]), 185364), 185364);
+    if (add)
+        add_dc_block_aarch64(plane, vshrq_n_s16(dc, 6), stride);
+    else {
+        uint8x8_t flat = vqshrun_n_s16(dc, 6);
+        for (int i = 0; i < 8; i++)
+            vst1_u8(&plane[i * stride], flat);
+    }
+}
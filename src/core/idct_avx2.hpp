@@ -0,0 +1,133 @@
+// Copyright  2021 Vladislav Ovchinnikov. All rights reserved.
+#pragma once
+#include <stdint.h>
+#include <immintrin.h>
+#include "common/cpu.hpp"
+
+// Two 8x8 blocks per pass, one in each 128-bit lane. The arithmetic is the one of idct_sse2.hpp,
+// so the output matches inverse_dct_template() of that file bit by bit.
+
+MP2V_TARGET("avx2") MP2V_INLINE __m256i _mm256_tmp_op0_epi16(__m256i src) { // src / 0.707106781186547524400844 : S1[0], S[2]
+    return _mm256_adds_epi16(src, _mm256_mulhi_epi16(src, _mm256_set1_epi16(27145)));
+}
+
+MP2V_TARGET("avx2") MP2V_INLINE __m256i _mm256_tmp_op1_epi16(__m256i src) { // src * 0.541196100146196984399723 : S1[1]
+    return _mm256_subs_epi16(src, _mm256_mulhi_epi16(src, _mm256_set1_epi16(30068)));
+}
+
+MP2V_TARGET("avx2") MP2V_INLINE __m256i _mm256_tmp_op3_epi16(__m256i src) { // src * 1.306562964876376527856643 : S1[3]
+    return _mm256_adds_epi16(src, _mm256_mulhi_epi16(src, _mm256_set1_epi16(20090)));
+}
+
+MP2V_TARGET("avx2") MP2V_INLINE __m256i _mm256_tmp_op4_epi16(__m256i src) { // src * 0.382683432365089771728460 : S1[4]
+    return _mm256_mulhi_epi16(src, _mm256_set1_epi16(25079));
+}
+
+MP2V_TARGET("avx2") MP2V_INLINE __m256i _mm256_idct_dc_epi16(__m256i src) {
+    return _mm256_adds_epi16(_mm256_slli_epi16(_mm256_mulhi_epi16(src, _mm256_set1_epi16(27145)), 1), _mm256_slli_epi16(src, 1));
+}
+
+MP2V_TARGET("avx2") MP2V_INLINE void idct_1d_avx2(__m256i (&src)[8]) {
+    // step 0
+    const __m256i v15 = _mm256_idct_dc_epi16(src[0]);
+    const __m256i v26 = _mm256_adds_epi16(_mm256_mulhi_epi16(src[1], _mm256_set1_epi16(-5037)), _mm256_slli_epi16(src[1], 2));
+    const __m256i v21 = _mm256_adds_epi16(_mm256_mulhi_epi16(src[2], _mm256_set1_epi16(-19954)), _mm256_slli_epi16(src[2], 2));
+    const __m256i v28 = _mm256_adds_epi16(_mm256_slli_epi16(_mm256_mulhi_epi16(src[3], _mm256_set1_epi16(-22089)), 1), _mm256_slli_epi16(src[3], 2));
+    const __m256i v16 = _mm256_idct_dc_epi16(src[4]);
+    const __m256i v25 = _mm256_adds_epi16(_mm256_mulhi_epi16(src[5], _mm256_set1_epi16(14567)), _mm256_slli_epi16(src[5], 1));
+    const __m256i v22 = _mm256_adds_epi16(_mm256_slli_epi16(_mm256_mulhi_epi16(src[6], _mm256_set1_epi16(17391)), 1), src[6]);
+    const __m256i v27 = _mm256_slli_epi16(_mm256_mulhi_epi16(src[7], _mm256_set1_epi16(25570)), 1);
+    // step 1
+    const __m256i v19 = _mm256_subs_epi16(v25, v28); // /2
+    const __m256i v20 = _mm256_subs_epi16(v26, v27); // /2
+    const __m256i v23 = _mm256_adds_epi16(v26, v27); // /2
+    const __m256i v24 = _mm256_adds_epi16(v25, v28); // /2
+    const __m256i v7  = _mm256_adds_epi16(v23, v24); // /4
+    const __m256i v11 = _mm256_adds_epi16(v21, v22); // /2
+    const __m256i v13 = _mm256_subs_epi16(v23, v24); // /4
+    const __m256i v17 = _mm256_subs_epi16(v21, v22); // /2
+    const __m256i v8  = _mm256_adds_epi16(v15, v16); // /2
+    const __m256i v9  = _mm256_subs_epi16(v15, v16); // /2
+    // step 2
+    const __m256i v18 = _mm256_tmp_op4_epi16(_mm256_subs_epi16(v19, v20));   //(v19 - v20) * s1[4]; /2
+    const __m256i v12 = _mm256_subs_epi16(v18, _mm256_tmp_op3_epi16(v19));   // v18 - v19 * s1[3];  /2
+    const __m256i v14 = _mm256_subs_epi16(_mm256_tmp_op1_epi16(v20), v18);   // v20 * s1[1] - v18); /2
+    const __m256i v6  = _mm256_subs_epi16(_mm256_slli_epi16(v14, 1), v7);    // v14 - v7            /4
+    const __m256i v5  = _mm256_subs_epi16(_mm256_tmp_op0_epi16(v13), v6);    // v13 / s1[2] - v6;   /4
+    const __m256i v4  = _mm256_adds_epi16(v5, _mm256_slli_epi16(v12, 1));    // v5 + v12;           /4
+    const __m256i v10 = _mm256_subs_epi16(_mm256_tmp_op0_epi16(v17), v11);   // v17 / s1[0] - v11;  /2
+    const __m256i v0  = _mm256_adds_epi16(v8, v11); // /4
+    const __m256i v1  = _mm256_adds_epi16(v9, v10); // /4
+    const __m256i v2  = _mm256_subs_epi16(v9, v10); // /4
+    const __m256i v3  = _mm256_subs_epi16(v8, v11); // /4
+    // step 3
+    src[0] = _mm256_adds_epi16(v0, v7); // /8
+    src[1] = _mm256_adds_epi16(v1, v6); // /8
+    src[2] = _mm256_adds_epi16(v2, v5); // /8
+    src[3] = _mm256_subs_epi16(v3, v4); // /8
+    src[4] = _mm256_adds_epi16(v3, v4); // /8
+    src[5] = _mm256_subs_epi16(v2, v5); // /8
+    src[6] = _mm256_subs_epi16(v1, v6); // /8
+    src[7] = _mm256_subs_epi16(v0, v7); // /8
+}
+
+// unpack instructions work within lanes, so both blocks are transposed at once
+MP2V_TARGET("avx2") MP2V_INLINE void transpose_8x8x2_avx2(__m256i (&src)[8]) {
+    __m256i a03b03 = _mm256_unpacklo_epi16(src[0], src[1]);
+    __m256i c03d03 = _mm256_unpacklo_epi16(src[2], src[3]);
+    __m256i e03f03 = _mm256_unpacklo_epi16(src[4], src[5]);
+    __m256i g03h03 = _mm256_unpacklo_epi16(src[6], src[7]);
+    __m256i a47b47 = _mm256_unpackhi_epi16(src[0], src[1]);
+    __m256i c47d47 = _mm256_unpackhi_epi16(src[2], src[3]);
+    __m256i e47f47 = _mm256_unpackhi_epi16(src[4], src[5]);
+    __m256i g47h47 = _mm256_unpackhi_epi16(src[6], src[7]);
+
+    __m256i a01b01c01d01 = _mm256_unpacklo_epi32(a03b03, c03d03);
+    __m256i a23b23c23d23 = _mm256_unpackhi_epi32(a03b03, c03d03);
+    __m256i e01f01g01h01 = _mm256_unpacklo_epi32(e03f03, g03h03);
+    __m256i e23f23g23h23 = _mm256_unpackhi_epi32(e03f03, g03h03);
+    __m256i a45b45c45d45 = _mm256_unpacklo_epi32(a47b47, c47d47);
+    __m256i a67b67c67d67 = _mm256_unpackhi_epi32(a47b47, c47d47);
+    __m256i e45f45g45h45 = _mm256_unpacklo_epi32(e47f47, g47h47);
+    __m256i e67f67g67h67 = _mm256_unpackhi_epi32(e47f47, g47h47);
+
+    src[0] = _mm256_unpacklo_epi64(a01b01c01d01, e01f01g01h01);
+    src[1] = _mm256_unpackhi_epi64(a01b01c01d01, e01f01g01h01);
+    src[2] = _mm256_unpacklo_epi64(a23b23c23d23, e23f23g23h23);
+    src[3] = _mm256_unpackhi_epi64(a23b23c23d23, e23f23g23h23);
+    src[4] = _mm256_unpacklo_epi64(a45b45c45d45, e45f45g45h45);
+    src[5] = _mm256_unpackhi_epi64(a45b45c45d45, e45f45g45h45);
+    src[6] = _mm256_unpacklo_epi64(a67b67c67d67, e67f67g67h67);
+    src[7] = _mm256_unpackhi_epi64(a67b67c67d67, e67f67g67h67);
+}
+
+// Both blocks share the stride: two luma blocks of a macroblock or its Cb/Cr pair
+template<bool add>
+MP2V_TARGET("avx2") void inverse_dct_x2_template(uint8_t* plane0, uint8_t* plane1, int16_t F0[64], int16_t F1[64], int stride) {
+    __m256i buffer[8];
+    for (int i = 0; i < 8; i++)
+        buffer[i] = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128((__m128i*) & F0[i * 8])), _mm_load_si128((__m128i*) & F1[i * 8]), 1);
+
+    idct_1d_avx2(buffer);
+    transpose_8x8x2_avx2(buffer);
+    idct_1d_avx2(buffer);
+
+    for (int i = 0; i < 8; i += 2) {
+        __m256i b0 = _mm256_srai_epi16(buffer[i + 0], 6);
+        __m256i b1 = _mm256_srai_epi16(buffer[i + 1], 6);
+        if (add) {
+            __m128i dst0 = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i*) & plane0[(i + 0) * stride]), _mm_loadl_epi64((__m128i*) & plane1[(i + 0) * stride]));
+            __m128i dst1 = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i*) & plane0[(i + 1) * stride]), _mm_loadl_epi64((__m128i*) & plane1[(i + 1) * stride]));
+            b0 = _mm256_adds_epi16(b0, _mm256_cvtepu8_epi16(dst0));
+            b1 = _mm256_adds_epi16(b1, _mm256_cvtepu8_epi16(dst1));
+        }
+        // lane 0: rows i, i + 1 of the first block, lane 1: the same rows of the second one
+        __m256i tmp = _mm256_packus_epi16(b0, b1);
+        __m128d res0 = _mm_castsi128_pd(_mm256_castsi256_si128(tmp));
+        __m128d res1 = _mm_castsi128_pd(_mm256_extracti128_si256(tmp, 1));
+        _mm_storel_pd((double*)&plane0[(i + 0) * stride], res0);
+        _mm_storeh_pd((double*)&plane0[(i + 1) * stride], res0);
+        _mm_storel_pd((double*)&plane1[(i + 0) * stride], res1);
+        _mm_storeh_pd((double*)&plane1[(i + 1) * stride], res1);
+    }
+}
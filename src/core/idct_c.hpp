@@ -1,80 +1,173 @@
 // Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#pragma once
 #include <stdint.h>
+#include <string.h>
 #include <algorithm>
-#include <math.h>
 #include "common/cpu.hpp"
 
-constexpr double s1[5] = {
-    0.707106781186547524400844,
-    0.541196100146196984399723,
-    0.707106781186547524400844,
-    1.306562964876376527856643,
-    0.382683432365089771728460,
-};
+constexpr bool IDCT_C_IGNORES_MISMATCH_BIT = false;
 
-template<typename src_t, typename dst_t>
-MP2V_INLINE void idct_1d(dst_t dst[8], src_t *src) {
-    const double v15 = static_cast<double>(src[0]) / 0.353553390593273762200422;
-    const double v26 = static_cast<double>(src[1]) / 0.254897789552079584470970;
-    const double v21 = static_cast<double>(src[2]) / 0.270598050073098492199862;
-    const double v28 = static_cast<double>(src[3]) / 0.300672443467522640271861;
-    const double v16 = static_cast<double>(src[4]) / 0.353553390593273762200422;
-    const double v25 = static_cast<double>(src[5]) / 0.449988111568207852319255;
-    const double v22 = static_cast<double>(src[6]) / 0.653281482438188263928322;
-    const double v27 = static_cast<double>(src[7]) / 1.281457723870753089398043;
-    
-    const double v19 = (v25 - v28) / 2;
-    const double v20 = (v26 - v27) / 2;
-    const double v23 = (v26 + v27) / 2;
-    const double v24 = (v25 + v28) / 2;
-    const double v7  = (v23 + v24) / 2;
-    const double v11 = (v21 + v22) / 2;
-    const double v13 = (v23 - v24) / 2;
-    const double v17 = (v21 - v22) / 2;
-    const double v8  = (v15 + v16) / 2;
-    const double v9  = (v15 - v16) / 2;
-    const double v18 = (v19 - v20) * s1[4];
-    const double v12 = (v19 * s1[3] - v18) / (s1[1] * s1[4] - s1[1] * s1[3] - s1[3] * s1[4]);
-    const double v14 = (v18 - v20 * s1[1]) / (s1[1] * s1[4] - s1[1] * s1[3] - s1[3] * s1[4]);
-    const double v6  = v14 - v7;
-    const double v5  = v13 / s1[2] - v6;
-    const double v4  = -v5 - v12;
-    const double v10 = v17 / s1[0] - v11;
-    const double v0  = (v8 + v11) / 2;
-    const double v1  = (v9 + v10) / 2;
-    const double v2  = (v9 - v10) / 2;
-    const double v3  = (v8 - v11) / 2;
-    
-    dst[0] = static_cast<dst_t>((v0 + v7) / 2);
-    dst[1] = static_cast<dst_t>((v1 + v6) / 2);
-    dst[2] = static_cast<dst_t>((v2 + v5) / 2);
-    dst[3] = static_cast<dst_t>((v3 + v4) / 2);
-    dst[4] = static_cast<dst_t>((v3 - v4) / 2);
-    dst[5] = static_cast<dst_t>((v2 - v5) / 2);
-    dst[6] = static_cast<dst_t>((v1 - v6) / 2);
-    dst[7] = static_cast<dst_t>((v0 - v7) / 2);
+// Integer IDCT after Chen and Wang, the separable row/column scheme of the MPEG-2 test model that meets
+// IEEE 1180 without floating point. Row outputs are saturated to 16 bits where the test model stores them in
+// shorts and so wraps them, the kernel is bit-exact with the test model as long as they fit, which holds while
+// the residual stays near the [-256, 255] output range. Blocks far off it, which only synthetic or broken
+// streams carry, differ from the test model there. No intermediate of either pass leaves 32 bits for any
+// input in [-2048, 2047]: the only product that could, the 181 / 256 rotation, is split by idct_mul181_c().
+constexpr int idct_c_w[8] = { 2048, 2841, 2676, 2408, 2048, 1609, 1108, 565 }; // 2048 * sqrt(2) * cos(k * pi / 16)
+
+// (181 * x + 128) >> 8 with x split at bit 8, exact for any x and the product stays within 32 bits. The test
+// model overflows int here on extreme blocks, the row pass at +-2048 and the column pass at saturated inputs.
+MP2V_INLINE int idct_mul181_c(int x) {
+    return 181 * (x >> 8) + ((181 * (x & 255) + 128) >> 8);
 }
 
-template<bool add>
-MP2V_INLINE void inverse_dct_template(uint8_t* plane, int16_t F[64], int stride) {
-    double tmp0[8][8];
-    double tmp1[8][8];
+MP2V_INLINE int idct_sat16_c(int val) {
+    return std::max(std::min(val, 32767), -32768);
+}
 
-    for (int i = 0; i < 8; i++)
-        idct_1d(tmp0[i], &F[i * 8]);
+// Output is scaled by 8 and saturated to 16 bits, the test model wraps it instead
+MP2V_INLINE void idct_row_c(int blk[8]) {
+    int x0, x1, x2, x3, x4, x5, x6, x7, x8;
+    x1 = blk[4] * 2048; x2 = blk[6]; x3 = blk[2]; x4 = blk[1]; x5 = blk[7]; x6 = blk[5]; x7 = blk[3];
+    if (!(x1 | x2 | x3 | x4 | x5 | x6 | x7)) {
+        int dc = idct_sat16_c(blk[0] * 8);
+        for (int i = 0; i < 8; i++)
+            blk[i] = dc;
+        return;
+    }
+    x0 = blk[0] * 2048 + 128; // rounding of the last stage
 
-    //transpose
-    for (int j = 0; j < 8; j++)
+    // first stage
+    x8 = idct_c_w[7] * (x4 + x5);
+    x4 = x8 + (idct_c_w[1] - idct_c_w[7]) * x4;
+    x5 = x8 - (idct_c_w[1] + idct_c_w[7]) * x5;
+    x8 = idct_c_w[3] * (x6 + x7);
+    x6 = x8 - (idct_c_w[3] - idct_c_w[5]) * x6;
+    x7 = x8 - (idct_c_w[3] + idct_c_w[5]) * x7;
+    // second stage
+    x8 = x0 + x1;
+    x0 -= x1;
+    x1 = idct_c_w[6] * (x3 + x2);
+    x2 = x1 - (idct_c_w[2] + idct_c_w[6]) * x2;
+    x3 = x1 + (idct_c_w[2] - idct_c_w[6]) * x3;
+    x1 = x4 + x6;
+    x4 -= x6;
+    x6 = x5 + x7;
+    x5 -= x7;
+    // third stage
+    x7 = x8 + x3;
+    x8 -= x3;
+    x3 = x0 + x2;
+    x0 -= x2;
+    x2 = idct_mul181_c(x4 + x5);
+    x4 = idct_mul181_c(x4 - x5);
+    // fourth stage
+    blk[0] = idct_sat16_c((x7 + x1) >> 8);
+    blk[1] = idct_sat16_c((x3 + x2) >> 8);
+    blk[2] = idct_sat16_c((x0 + x4) >> 8);
+    blk[3] = idct_sat16_c((x8 + x6) >> 8);
+    blk[4] = idct_sat16_c((x8 - x6) >> 8);
+    blk[5] = idct_sat16_c((x0 - x4) >> 8);
+    blk[6] = idct_sat16_c((x3 - x2) >> 8);
+    blk[7] = idct_sat16_c((x7 - x1) >> 8);
+}
+
+MP2V_INLINE int idct_clip_c(int val) {
+    return std::max(std::min(val, 255), -256);
+}
+
+// Column of the row pass output, removes the scale of the row pass, output is clipped to [-256, 255]
+MP2V_INLINE void idct_col_c(int dst[8], int* blk) {
+    int x0, x1, x2, x3, x4, x5, x6, x7, x8;
+    x1 = blk[8 * 4] * 256; x2 = blk[8 * 6]; x3 = blk[8 * 2]; x4 = blk[8 * 1]; x5 = blk[8 * 7]; x6 = blk[8 * 5]; x7 = blk[8 * 3];
+    if (!(x1 | x2 | x3 | x4 | x5 | x6 | x7)) {
+        int dc = idct_clip_c((blk[0] + 32) >> 6);
         for (int i = 0; i < 8; i++)
-            tmp1[i][j] = tmp0[j][i];
+            dst[i] = dc;
+        return;
+    }
+    x0 = blk[8 * 0] * 256 + 8192;
+
+    // first stage
+    x8 = idct_c_w[7] * (x4 + x5) + 4;
+    x4 = (x8 + (idct_c_w[1] - idct_c_w[7]) * x4) >> 3;
+    x5 = (x8 - (idct_c_w[1] + idct_c_w[7]) * x5) >> 3;
+    x8 = idct_c_w[3] * (x6 + x7) + 4;
+    x6 = (x8 - (idct_c_w[3] - idct_c_w[5]) * x6) >> 3;
+    x7 = (x8 - (idct_c_w[3] + idct_c_w[5]) * x7) >> 3;
+    // second stage
+    x8 = x0 + x1;
+    x0 -= x1;
+    x1 = idct_c_w[6] * (x3 + x2) + 4;
+    x2 = (x1 - (idct_c_w[2] + idct_c_w[6]) * x2) >> 3;
+    x3 = (x1 + (idct_c_w[2] - idct_c_w[6]) * x3) >> 3;
+    x1 = x4 + x6;
+    x4 -= x6;
+    x6 = x5 + x7;
+    x5 -= x7;
+    // third stage
+    x7 = x8 + x3;
+    x8 -= x3;
+    x3 = x0 + x2;
+    x0 -= x2;
+    x2 = idct_mul181_c(x4 + x5);
+    x4 = idct_mul181_c(x4 - x5);
+    // fourth stage
+    dst[0] = idct_clip_c((x7 + x1) >> 14);
+    dst[1] = idct_clip_c((x3 + x2) >> 14);
+    dst[2] = idct_clip_c((x0 + x4) >> 14);
+    dst[3] = idct_clip_c((x8 + x6) >> 14);
+    dst[4] = idct_clip_c((x8 - x6) >> 14);
+    dst[5] = idct_clip_c((x0 - x4) >> 14);
+    dst[6] = idct_clip_c((x3 - x2) >> 14);
+    dst[7] = idct_clip_c((x7 - x1) >> 14);
+}
 
-    for (int i = 0; i < 8; i++)
-        idct_1d(tmp0[i], tmp1[i]);
+// F comes transposed (g_scan_trans), its columns are the rows of the coefficient block. Rows past num_rows
+// are zero and stay zero after the row pass, which skips them.
+template<bool add, int num_rows = 8>
+void inverse_dct_template_c(uint8_t* plane, int16_t F[64], int stride) {
+    int blk[64];
+    int col[8];
 
-    //transpose store
-    for (int j = 0; j < 8; j++)
-        for (int i = 0; i < 8; i++) {
-            int res = add ? (int)tmp0[j][i] + (int)plane[j * stride + i] : (int)tmp0[j][i];
+    for (int j = 0; j < num_rows; j++)
+        for (int i = 0; i < 8; i++)
+            blk[j * 8 + i] = F[i * 8 + j];
+    for (int i = num_rows * 8; i < 64; i++)
+        blk[i] = 0;
+    for (int j = 0; j < num_rows; j++)
+        idct_row_c(&blk[j * 8]);
+
+    for (int i = 0; i < 8; i++) {
+        idct_col_c(col, &blk[i]);
+        for (int j = 0; j < 8; j++) {
+            int res = add ? col[j] + (int)plane[j * stride + i] : col[j];
             plane[j * stride + i] = (uint8_t)(std::max(std::min(res, 255), 0));
         }
-}
\ No newline at end of file
+    }
+}
+
+template<bool add>
+void inverse_dct_4x4_template_c(uint8_t* plane, int16_t F[64], int stride) {
+    inverse_dct_template_c<add, 4>(plane, F, stride);
+}
+
+// Adds a flat residual to the prediction in place
+MP2V_INLINE void add_dc_block(uint8_t* plane, int dc, int stride) {
+    if (dc == 0)
+        return; // the prediction is the result
+    for (int j = 0; j < 8; j++)
+        for (int i = 0; i < 8; i++)
+            plane[j * stride + i] = (uint8_t)(std::max(std::min(dc + (int)plane[j * stride + i], 255), 0));
+}
+
+// F[0][0] only: both passes take their shortcut, the row one scales by 8 and the column one rounds off 6 bits
+template<bool add>
+void inverse_dct_dc_template_c(uint8_t* plane, int16_t F[64], int stride) {
+    int dc = idct_clip_c((F[0] * 8 + 32) >> 6);
+    if (add)
+        add_dc_block(plane, dc, stride);
+    else
+        for (int j = 0; j < 8; j++)
+            memset(&plane[j * stride], std::max(dc, 0), 8);
+}
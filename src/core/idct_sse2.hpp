@@ -4,6 +4,9 @@
 #include <emmintrin.h>
 #include "common/cpu.hpp"
 
+// F[7][7] = 1 set by mismatch control is lost in the first pass (v27 = 0), so it doesn't count as a coefficient
+constexpr bool IDCT_IGNORES_MISMATCH_BIT = true;
+
 MP2V_INLINE __m128i _mm_tmp_op0_epi16(__m128i src) { // src / 0.707106781186547524400844 : S1[0], S[2]
     return _mm_adds_epi16(src, _mm_mulhi_epi16(src, _mm_set1_epi16(27145)));
 }
@@ -20,27 +23,33 @@ MP2V_INLINE __m128i _mm_tmp_op4_epi16(__m128i src) { // src * 0.3826834323650897
     return _mm_mulhi_epi16(src, _mm_set1_epi16(25079));
 }
 
+MP2V_INLINE __m128i _mm_idct_dc_epi16(__m128i src) { // v15 term of idct_1d_sse2()
+    return _mm_adds_epi16(_mm_slli_epi16(_mm_mulhi_epi16(src, _mm_set1_epi16(27145)), 1), _mm_slli_epi16(src, 1));
+}
+
+// half: src[4..7] are zero, saturating operations with a zero operand are left out as they return the other one
+template<bool half = false>
 MP2V_INLINE void idct_1d_sse2(__m128i (&src)[8]) {
     // step 0
-    const __m128i v15 = _mm_adds_epi16(_mm_slli_epi16(_mm_mulhi_epi16(src[0], _mm_set1_epi16(27145)), 1), _mm_slli_epi16(src[0], 1));
+    const __m128i v15 = _mm_idct_dc_epi16(src[0]);
     const __m128i v26 = _mm_adds_epi16(_mm_mulhi_epi16(src[1], _mm_set1_epi16(-5037)), _mm_slli_epi16(src[1], 2));
     const __m128i v21 = _mm_adds_epi16(_mm_mulhi_epi16(src[2], _mm_set1_epi16(-19954)), _mm_slli_epi16(src[2], 2));
     const __m128i v28 = _mm_adds_epi16(_mm_slli_epi16(_mm_mulhi_epi16(src[3], _mm_set1_epi16(-22089)), 1), _mm_slli_epi16(src[3], 2));
-    const __m128i v16 = _mm_adds_epi16(_mm_slli_epi16(_mm_mulhi_epi16(src[4], _mm_set1_epi16(27145)), 1), _mm_slli_epi16(src[4], 1));
-    const __m128i v25 = _mm_adds_epi16(_mm_mulhi_epi16(src[5], _mm_set1_epi16(14567)), _mm_slli_epi16(src[5], 1));
-    const __m128i v22 = _mm_adds_epi16(_mm_slli_epi16(_mm_mulhi_epi16(src[6], _mm_set1_epi16(17391)), 1), src[6]);
-    const __m128i v27 = _mm_slli_epi16(_mm_mulhi_epi16(src[7], _mm_set1_epi16(25570)), 1);
+    const __m128i v16 = half ? _mm_setzero_si128() : _mm_idct_dc_epi16(src[4]);
+    const __m128i v25 = half ? _mm_setzero_si128() : _mm_adds_epi16(_mm_mulhi_epi16(src[5], _mm_set1_epi16(14567)), _mm_slli_epi16(src[5], 1));
+    const __m128i v22 = half ? _mm_setzero_si128() : _mm_adds_epi16(_mm_slli_epi16(_mm_mulhi_epi16(src[6], _mm_set1_epi16(17391)), 1), src[6]);
+    const __m128i v27 = half ? _mm_setzero_si128() : _mm_slli_epi16(_mm_mulhi_epi16(src[7], _mm_set1_epi16(25570)), 1);
     // step 1
     const __m128i v19 = _mm_subs_epi16(v25, v28); // /2
-    const __m128i v20 = _mm_subs_epi16(v26, v27); // /2
-    const __m128i v23 = _mm_adds_epi16(v26, v27); // /2
-    const __m128i v24 = _mm_adds_epi16(v25, v28); // /2
+    const __m128i v20 = half ? v26 : _mm_subs_epi16(v26, v27); // /2
+    const __m128i v23 = half ? v26 : _mm_adds_epi16(v26, v27); // /2
+    const __m128i v24 = half ? v28 : _mm_adds_epi16(v25, v28); // /2
     const __m128i v7  = _mm_adds_epi16(v23, v24); // /4
-    const __m128i v11 = _mm_adds_epi16(v21, v22); // /2
+    const __m128i v11 = half ? v21 : _mm_adds_epi16(v21, v22); // /2
     const __m128i v13 = _mm_subs_epi16(v23, v24); // /4
-    const __m128i v17 = _mm_subs_epi16(v21, v22); // /2
-    const __m128i v8  = _mm_adds_epi16(v15, v16); // /2
-    const __m128i v9  = _mm_subs_epi16(v15, v16); // /2
+    const __m128i v17 = half ? v21 : _mm_subs_epi16(v21, v22); // /2
+    const __m128i v8  = half ? v15 : _mm_adds_epi16(v15, v16); // /2
+    const __m128i v9  = half ? v15 : _mm_subs_epi16(v15, v16); // /2
     // step 2
     const __m128i v18 = _mm_tmp_op4_epi16(_mm_subs_epi16(v19, v20));   //(v19 - v20) * s1[4]; /2
     const __m128i v12 = _mm_subs_epi16(v18, _mm_tmp_op3_epi16(v19));   // v18 - v19 * s1[3];  /2
@@ -93,28 +102,263 @@ MP2V_INLINE void transpose_8x8_sse2(__m128i (&src)[8]) {
     src[7] = _mm_unpackhi_epi64(a67b67c67d67, e67f67g67h67);
 }
 
-template<bool add>
-void inverse_dct_template(uint8_t* plane, int16_t F[64], int stride) {
-    __m128i buffer[8];
+// first four rows of the transposed block, enough when the other half of it is zero
+MP2V_INLINE void transpose_8x4_sse2(__m128i (&src)[8]) {
+    __m128i a03b03 = _mm_unpacklo_epi16(src[0], src[1]);
+    __m128i c03d03 = _mm_unpacklo_epi16(src[2], src[3]);
+    __m128i e03f03 = _mm_unpacklo_epi16(src[4], src[5]);
+    __m128i g03h03 = _mm_unpacklo_epi16(src[6], src[7]);
+
+    __m128i a01b01c01d01 = _mm_unpacklo_epi32(a03b03, c03d03);
+    __m128i a23b23c23d23 = _mm_unpackhi_epi32(a03b03, c03d03);
+    __m128i e01f01g01h01 = _mm_unpacklo_epi32(e03f03, g03h03);
+    __m128i e23f23g23h23 = _mm_unpackhi_epi32(e03f03, g03h03);
+
+    src[0] = _mm_unpacklo_epi64(a01b01c01d01, e01f01g01h01);
+    src[1] = _mm_unpackhi_epi64(a01b01c01d01, e01f01g01h01);
+    src[2] = _mm_unpacklo_epi64(a23b23c23d23, e23f23g23h23);
+    src[3] = _mm_unpackhi_epi64(a23b23c23d23, e23f23g23h23);
+}
+
+// Prediction the residual is added to: the plane itself, row i in the low half
+struct idct_pred_plane_sse2 {
+    const uint8_t* plane;
+    int stride;
+    MP2V_INLINE __m128i row(int i) const { return _mm_loadl_epi64((const __m128i*) & plane[i * stride]); }
+};
+
+// Residual plus the rows of pred_t, clamped and stored. shift: fraction bits left in the output of the second pass
+template<int shift, class pred_t>
+MP2V_INLINE void add_idct_block_sse2(uint8_t* plane, __m128i (&buffer)[8], int stride, const pred_t& pred) {
+    for (int i = 0; i < 4; i++) {
+        __m128i b0 = shift ? _mm_srai_epi16(buffer[i * 2], shift) : buffer[i * 2];
+        __m128i b1 = shift ? _mm_srai_epi16(buffer[i * 2 + 1], shift) : buffer[i * 2 + 1];
+        __m128i dstl = _mm_unpacklo_epi8(pred.row(i * 2 + 0), _mm_setzero_si128());
+        __m128i dsth = _mm_unpacklo_epi8(pred.row(i * 2 + 1), _mm_setzero_si128());
+        __m128i tmp = _mm_packus_epi16(_mm_adds_epi16(dstl, b0), _mm_adds_epi16(dsth, b1));
+        _mm_storel_epi64((__m128i*) & plane[(i * 2 + 0) * stride], tmp);
+        _mm_storel_epi64((__m128i*) & plane[(i * 2 + 1) * stride], _mm_srli_si128(tmp, 8));
+    }
+}
+
+template<bool add, int shift = 6>
+MP2V_INLINE void store_idct_block_sse2(uint8_t* plane, __m128i (&buffer)[8], int stride) {
+    if (add) {
+        add_idct_block_sse2<shift>(plane, buffer, stride, idct_pred_plane_sse2{ plane, stride });
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        __m128i b0 = shift ? _mm_srai_epi16(buffer[i * 2], shift) : buffer[i * 2];
+        __m128i b1 = shift ? _mm_srai_epi16(buffer[i * 2 + 1], shift) : buffer[i * 2 + 1];
+        __m128i tmp = _mm_packus_epi16(b0, b1);
+        _mm_storel_epi64((__m128i*) & plane[(i * 2 + 0) * stride], tmp);
+        _mm_storel_epi64((__m128i*) & plane[(i * 2 + 1) * stride], _mm_srli_si128(tmp, 8));
+    }
+}
+
+MP2V_INLINE void idct_block_sse2(__m128i (&buffer)[8], int16_t F[64]) {
     for (int i = 0; i < 8; i++)
         buffer[i] = _mm_load_si128((__m128i*) & F[i*8]);
 
     idct_1d_sse2(buffer);
     transpose_8x8_sse2(buffer);
     idct_1d_sse2(buffer);
+}
 
-    for (int i = 0; i < 4; i++) {
-        __m128i tmp, b0, b1;
-        b0 = _mm_srai_epi16(buffer[i * 2], 6);
-        b1 = _mm_srai_epi16(buffer[i * 2 + 1], 6);
-        if (add) {
-            __m128i dstl = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*) & plane[(i * 2 + 0) * stride]), _mm_setzero_si128());
-            __m128i dsth = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*) & plane[(i * 2 + 1) * stride]), _mm_setzero_si128());
-            tmp = _mm_packus_epi16(_mm_adds_epi16(dstl, b0), _mm_adds_epi16(dsth, b1));
-        } else
-            tmp = _mm_packus_epi16(b0, b1);
+// Nonzero coefficients within F[0..3][0..3]: the first pass leaves columns 4..7 zero, so both passes skip
+// the zero half of their input and only the upper half of the transpose is needed.
+MP2V_INLINE void idct_4x4_block_sse2(__m128i (&buffer)[8], int16_t F[64]) {
+    for (int i = 0; i < 4; i++)
+        buffer[i] = _mm_load_si128((__m128i*) & F[i*8]);
+    for (int i = 4; i < 8; i++)
+        buffer[i] = _mm_setzero_si128();
 
-        _mm_storel_epi64((__m128i*) & plane[(i * 2 + 0) * stride], tmp);
-        _mm_storel_epi64((__m128i*) & plane[(i * 2 + 1) * stride], _mm_srli_si128(tmp, 8));
+    idct_1d_sse2<true>(buffer);
+    transpose_8x4_sse2(buffer);
+    for (int i = 4; i < 8; i++)
+        buffer[i] = _mm_setzero_si128();
+    idct_1d_sse2<true>(buffer);
+}
+
+// F[0][0] only: every output of both passes is the v15 term, the block is flat
+MP2V_INLINE __m128i idct_dc_sse2(int16_t F[64]) {
+    return _mm_srai_epi16(_mm_idct_dc_epi16(_mm_idct_dc_epi16(_mm_set1_epi16(F[0]))), 6);
+}
+
+template<bool add>
+void inverse_dct_template(uint8_t* plane, int16_t F[64], int stride) {
+    __m128i buffer[8];
+    idct_block_sse2(buffer, F);
+    store_idct_block_sse2<add>(plane, buffer, stride);
+}
+
+template<bool add>
+void inverse_dct_4x4_template(uint8_t* plane, int16_t F[64], int stride) {
+    __m128i buffer[8];
+    idct_4x4_block_sse2(buffer, F);
+    store_idct_block_sse2<add>(plane, buffer, stride);
+}
+
+// Adds a flat residual to the rows of pred_t. The residual is split into its positive and negative parts
+// clamped to bytes, so pixels stay 8 bit wide and two rows go through one saturating add/sub pair.
+template<class pred_t>
+MP2V_INLINE void add_dc_block_sse2(uint8_t* plane, __m128i dc, int stride, const pred_t& pred) {
+    __m128i pos = _mm_packus_epi16(dc, dc);
+    __m128i neg = _mm_sub_epi16(_mm_setzero_si128(), dc);
+    neg = _mm_packus_epi16(neg, neg);
+    for (int i = 0; i < 8; i += 2) {
+        __m128i dst = _mm_unpacklo_epi64(pred.row(i), pred.row(i + 1));
+        dst = _mm_subs_epu8(_mm_adds_epu8(dst, pos), neg);
+        _mm_storel_epi64((__m128i*) & plane[(i + 0) * stride], dst);
+        _mm_storel_epi64((__m128i*) & plane[(i + 1) * stride], _mm_srli_si128(dst, 8));
+    }
+}
+
+MP2V_INLINE void add_dc_block_sse2(uint8_t* plane, __m128i dc, int stride) {
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(dc, _mm_setzero_si128())) == 0xffff)
+        return; // residual rounds to zero, the prediction in place is the result
+    add_dc_block_sse2(plane, dc, stride, idct_pred_plane_sse2{ plane, stride });
+}
+
+template<bool add>
+MP2V_INLINE void store_dc_block_sse2(uint8_t* plane, __m128i dc, int stride) {
+    if (add)
+        add_dc_block_sse2(plane, dc, stride);
+    else {
+        __m128i flat = _mm_packus_epi16(dc, dc);
+        for (int i = 0; i < 8; i++)
+            _mm_storel_epi64((__m128i*) & plane[i * stride], flat);
+    }
+}
+
+template<bool add>
+void inverse_dct_dc_template(uint8_t* plane, int16_t F[64], int stride) {
+    store_dc_block_sse2<add>(plane, idct_dc_sse2(F), stride);
+}
+
+// Conformant kernels, bit-exact with the integer IDCT of idct_c.hpp. Every output of a Chen-Wang butterfly
+// stage is a sum of two products of the stage inputs, so both passes run on pmaddwd over interleaved input
+// pairs and keep 32 bit lanes up to the C rounding points. The row pass of the C kernel runs along the columns
+// of the transposed F, which are the SIMD lanes here, so only the column pass needs a transpose.
+
+constexpr int16_t IDCT_W1 = 2841, IDCT_W2 = 2676, IDCT_W3 = 2408, IDCT_W5 = 1609, IDCT_W6 = 1108, IDCT_W7 = 565; // idct_c_w
+
+// pmaddwd multiplier of a in the even and b in the odd 16 bit lanes
+MP2V_INLINE __m128i _mm_set_pair_epi16(int16_t a, int16_t b) {
+    return _mm_set1_epi32((uint16_t)a | ((uint32_t)(uint16_t)b << 16));
+}
+
+MP2V_INLINE __m128i _mm_mul181_epi32(__m128i x) { // SSE2 has no 32 bit multiply
+    __m128i x5   = _mm_add_epi32(_mm_slli_epi32(x, 2), x);
+    __m128i x48  = _mm_add_epi32(_mm_slli_epi32(x, 5), _mm_slli_epi32(x, 4));
+    return _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(x, 7), x48), x5);
+}
+
+// idct_mul181_c()
+MP2V_INLINE __m128i _mm_mul181_round_epi32(__m128i x) {
+    __m128i hi = _mm_mul181_epi32(_mm_srai_epi32(x, 8));
+    __m128i lo = _mm_mul181_epi32(_mm_and_si128(x, _mm_set1_epi32(255)));
+    return _mm_add_epi32(hi, _mm_srai_epi32(_mm_add_epi32(lo, _mm_set1_epi32(128)), 8));
+}
+
+// Four lanes of idct_row_c() (row) or idct_col_c() before clipping. sAB interleaves inputs A and B.
+template<bool row>
+MP2V_INLINE void idct_1d_conformant_half_sse2(__m128i s04, __m128i s26, __m128i s17, __m128i s53, __m128i (&dst)[8]) {
+    constexpr int16_t dc_scale = row ? 2048 : 256;
+    constexpr int shift = row ? 8 : 14;
+    const __m128i dc_round = _mm_set1_epi32(row ? 128 : 8192);
+
+    // first stage, the column pass rounds off 3 bits of it
+    __m128i x4 = _mm_madd_epi16(s17, _mm_set_pair_epi16(IDCT_W1, IDCT_W7));
+    __m128i x5 = _mm_madd_epi16(s17, _mm_set_pair_epi16(IDCT_W7, -IDCT_W1));
+    __m128i x6 = _mm_madd_epi16(s53, _mm_set_pair_epi16(IDCT_W5, IDCT_W3));
+    __m128i x7 = _mm_madd_epi16(s53, _mm_set_pair_epi16(IDCT_W3, -IDCT_W5));
+    __m128i x2 = _mm_madd_epi16(s26, _mm_set_pair_epi16(IDCT_W6, -IDCT_W2));
+    __m128i x3 = _mm_madd_epi16(s26, _mm_set_pair_epi16(IDCT_W2, IDCT_W6));
+    if (!row) {
+        const __m128i round = _mm_set1_epi32(4);
+        x4 = _mm_srai_epi32(_mm_add_epi32(x4, round), 3);
+        x5 = _mm_srai_epi32(_mm_add_epi32(x5, round), 3);
+        x6 = _mm_srai_epi32(_mm_add_epi32(x6, round), 3);
+        x7 = _mm_srai_epi32(_mm_add_epi32(x7, round), 3);
+        x2 = _mm_srai_epi32(_mm_add_epi32(x2, round), 3);
+        x3 = _mm_srai_epi32(_mm_add_epi32(x3, round), 3);
     }
+    // second stage
+    __m128i x8 = _mm_add_epi32(_mm_madd_epi16(s04, _mm_set_pair_epi16(dc_scale, dc_scale)), dc_round);
+    __m128i x0 = _mm_add_epi32(_mm_madd_epi16(s04, _mm_set_pair_epi16(dc_scale, -dc_scale)), dc_round);
+    __m128i x1 = _mm_add_epi32(x4, x6);
+    x4 = _mm_sub_epi32(x4, x6);
+    x6 = _mm_add_epi32(x5, x7);
+    x5 = _mm_sub_epi32(x5, x7);
+    // third stage
+    x7 = _mm_add_epi32(x8, x3);
+    x8 = _mm_sub_epi32(x8, x3);
+    x3 = _mm_add_epi32(x0, x2);
+    x0 = _mm_sub_epi32(x0, x2);
+    x2 = _mm_mul181_round_epi32(_mm_add_epi32(x4, x5));
+    x4 = _mm_mul181_round_epi32(_mm_sub_epi32(x4, x5));
+    // fourth stage
+    dst[0] = _mm_srai_epi32(_mm_add_epi32(x7, x1), shift);
+    dst[1] = _mm_srai_epi32(_mm_add_epi32(x3, x2), shift);
+    dst[2] = _mm_srai_epi32(_mm_add_epi32(x0, x4), shift);
+    dst[3] = _mm_srai_epi32(_mm_add_epi32(x8, x6), shift);
+    dst[4] = _mm_srai_epi32(_mm_sub_epi32(x8, x6), shift);
+    dst[5] = _mm_srai_epi32(_mm_sub_epi32(x0, x4), shift);
+    dst[6] = _mm_srai_epi32(_mm_sub_epi32(x3, x2), shift);
+    dst[7] = _mm_srai_epi32(_mm_sub_epi32(x7, x1), shift);
+}
+
+// Outputs are saturated to 16 bits like the row outputs of the C kernel. Clipping the column outputs to
+// [-256, 255] is left to the saturating store, it gives the same pixels. With lo_only lanes 4 to 7 of src
+// are zero, so are their outputs.
+template<bool row, bool lo_only = false>
+MP2V_INLINE void idct_1d_conformant_sse2(__m128i (&src)[8]) {
+    __m128i lo[8], hi[8];
+    idct_1d_conformant_half_sse2<row>(_mm_unpacklo_epi16(src[0], src[4]), _mm_unpacklo_epi16(src[2], src[6]),
+                                      _mm_unpacklo_epi16(src[1], src[7]), _mm_unpacklo_epi16(src[5], src[3]), lo);
+    if (lo_only)
+        for (auto& val : hi)
+            val = _mm_setzero_si128();
+    else
+        idct_1d_conformant_half_sse2<row>(_mm_unpackhi_epi16(src[0], src[4]), _mm_unpackhi_epi16(src[2], src[6]),
+                                          _mm_unpackhi_epi16(src[1], src[7]), _mm_unpackhi_epi16(src[5], src[3]), hi);
+    for (int i = 0; i < 8; i++)
+        src[i] = _mm_packs_epi32(lo[i], hi[i]);
+}
+
+// With num_rows = 4 F is nonzero in its top left 4x4 corner only: the row pass skips the lanes of the zero
+// columns of F, rows 4 to 7 are not loaded
+template<int num_rows = 8>
+MP2V_INLINE void idct_block_conformant_sse2(__m128i (&buffer)[8], int16_t F[64]) {
+    for (int i = 0; i < 8; i++)
+        buffer[i] = (i < num_rows) ? _mm_load_si128((__m128i*) & F[i*8]) : _mm_setzero_si128();
+
+    idct_1d_conformant_sse2<true, num_rows == 4>(buffer);
+    transpose_8x8_sse2(buffer);
+    idct_1d_conformant_sse2<false>(buffer);
+}
+
+// F[0][0] only: the shortcuts of both C passes, F[0][0] is within [-2048, 2047]
+MP2V_INLINE __m128i idct_dc_conformant_sse2(int16_t F[64]) {
+    return _mm_set1_epi16((int16_t)((F[0] * 8 + 32) >> 6));
+}
+
+template<bool add>
+void inverse_dct_template_conformant(uint8_t* plane, int16_t F[64], int stride) {
+    __m128i buffer[8];
+    idct_block_conformant_sse2(buffer, F);
+    store_idct_block_sse2<add, 0>(plane, buffer, stride);
+}
+
+template<bool add>
+void inverse_dct_4x4_template_conformant(uint8_t* plane, int16_t F[64], int stride) {
+    __m128i buffer[8];
+    idct_block_conformant_sse2<4>(buffer, F);
+    store_idct_block_sse2<add, 0>(plane, buffer, stride);
+}
+
+template<bool add>
+void inverse_dct_dc_template_conformant(uint8_t* plane, int16_t F[64], int stride) {
+    store_dc_block_sse2<add>(plane, idct_dc_conformant_sse2(F), stride);
 }
@@ -0,0 +1,22 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#include "iquant.h"
+#include "kernels.h"
+#include "iquant_c.hpp"
+#if defined(CPU_PLATFORM_X64)
+#include "iquant_sse2.hpp"
+#endif
+
+void iquant_init(kernels_t& kernels, cpu_isa_e isa) {
+    switch (isa) {
+#if defined(CPU_PLATFORM_X64)
+    case cpu_isa_sse2:
+    case cpu_isa_avx2:
+        kernels.inverse_quant[0] = inverse_quant_template<false>;
+        kernels.inverse_quant[1] = inverse_quant_template<true>;
+        break;
+#endif
+    default: // no NEON kernel yet
+        kernels.inverse_quant[0] = inverse_quant_template_c<false>;
+        kernels.inverse_quant[1] = inverse_quant_template_c<true>;
+    }
+}
@@ -0,0 +1,14 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#pragma once
+#include <stdint.h>
+#include "cpu_dispatch.h"
+
+// Inverse quantisation of the levels parse_block() collected from a block: levels carry their sign and idx holds
+// their positions in QFS, which also index WQ, the quantiser matrix premultiplied by quantiser_scale (see
+// quant_tables_t). The values go to dst in the order of the levels, saturated to [-2048, 2047]. Entries up to
+// the next multiple of 8 past num are read and must be zero. Returns the sum of the values modulo 2 for mismatch
+// control.
+typedef int(*iquant_func_t)(int16_t* dst, const int16_t* levels, const uint8_t* idx, const uint16_t WQ[64], int num);
+
+struct kernels_t;
+void iquant_init(kernels_t& kernels, cpu_isa_e isa); // see cpu_dispatch_init()
@@ -0,0 +1,19 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#pragma once
+#include <stdint.h>
+#include <algorithm>
+#include "common/cpu.hpp"
+
+template<bool intra>
+int inverse_quant_template_c(int16_t* dst, const int16_t* levels, const uint8_t* idx, const uint16_t WQ[64], int num) {
+    int sum = 0;
+    for (int k = 0; k < num; k++) {
+        int sign = levels[k] >> 15;
+        int level = (levels[k] ^ sign) - sign;
+        int val = intra ? (level * WQ[idx[k]]) >> 4 : ((2 * level + 1) * WQ[idx[k]]) >> 5;
+        val = std::min((std::min(val, 2048) ^ sign) - sign, 2047);
+        dst[k] = (int16_t)val;
+        sum += val;
+    }
+    return sum & 1;
+}
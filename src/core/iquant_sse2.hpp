@@ -0,0 +1,35 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#pragma once
+#include <stdint.h>
+#include <emmintrin.h>
+#include "common/cpu.hpp"
+
+// Eight levels per pass. 2 * level + 1 <= 4097 and WQ <= 255 * 112 fit 16 bits, so the 32 bit products
+// come from a mullo/mulhi pair and are narrowed back with saturation.
+template<bool intra>
+int inverse_quant_template(int16_t* dst, const int16_t* levels, const uint8_t* idx, const uint16_t WQ[64], int num) {
+    const __m128i lane = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+    __m128i parity = _mm_setzero_si128();
+    for (int k = 0; k < num; k += 8) {
+        __m128i level = _mm_load_si128((__m128i*) & levels[k]);
+        __m128i wq = _mm_setr_epi16(WQ[idx[k + 0]], WQ[idx[k + 1]], WQ[idx[k + 2]], WQ[idx[k + 3]],
+                                    WQ[idx[k + 4]], WQ[idx[k + 5]], WQ[idx[k + 6]], WQ[idx[k + 7]]);
+        __m128i sign = _mm_srai_epi16(level, 15);
+        level = _mm_sub_epi16(_mm_xor_si128(level, sign), sign);
+        if (!intra)
+            level = _mm_add_epi16(_mm_add_epi16(level, level), _mm_set1_epi16(1));
+        __m128i lo = _mm_mullo_epi16(level, wq);
+        __m128i hi = _mm_mulhi_epi16(level, wq);
+        __m128i val0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), intra ? 4 : 5);
+        __m128i val1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), intra ? 4 : 5);
+        __m128i val = _mm_min_epi16(_mm_packs_epi32(val0, val1), _mm_set1_epi16(2048));
+        val = _mm_min_epi16(_mm_sub_epi16(_mm_xor_si128(val, sign), sign), _mm_set1_epi16(2047));
+        val = _mm_and_si128(val, _mm_cmplt_epi16(lane, _mm_set1_epi16((int16_t)(num - k)))); // padding past num
+        _mm_store_si128((__m128i*) & dst[k], val);
+        parity = _mm_xor_si128(parity, val);
+    }
+    parity = _mm_xor_si128(parity, _mm_srli_si128(parity, 8));
+    parity = _mm_xor_si128(parity, _mm_srli_si128(parity, 4));
+    parity = _mm_xor_si128(parity, _mm_srli_si128(parity, 2));
+    return _mm_cvtsi128_si32(parity) & 1;
+}
@@ -0,0 +1,31 @@
+// Copyright  2021 Vladislav Ovchinnikov. All rights reserved.
+#pragma once
+#include "cpu_dispatch.h"
+#include "mc.h"
+#include "idct.h"
+#include "iquant.h"
+
+// Kernel tables of one level and IDCT accuracy, filled by cpu_dispatch_init(). Every decoder holds its own set,
+// so decoders of different levels and accuracies run side by side.
+struct kernels_t {
+    cpu_isa_e       isa;
+    idct_accuracy_e idct_accuracy;
+
+    mc_pred_func_t  mc_pred_16xh[4];
+    mc_pred_func_t  mc_pred_8xh[4];
+    mc_bidir_func_t mc_bidir_16xh[16];
+    mc_bidir_func_t mc_bidir_8xh[16];
+    // 8x8 prediction plus the inverse_dct[1] residual of F, written to dst in one pass and bit-exact with the two.
+    // Indexed by mc_idct_type_e and then as mc_pred_8xh/mc_bidir_8xh, nullptr where the level has no such kernels.
+    mc_pred_idct_func_t  mc_pred_idct_8x8[3][4];
+    mc_bidir_idct_func_t mc_bidir_idct_8x8[3][16];
+
+    // Indexed by add: the residual either replaces the plane or is added to the prediction in it
+    idct_func_t    inverse_dct[2];
+    idct_func_t    inverse_dct_4x4[2]; // nonzero coefficients within F[0..3][0..3]
+    idct_func_t    inverse_dct_dc[2];  // F[0][0] only
+    idct_x2_func_t inverse_dct_x2[2];  // two blocks sharing the stride, nullptr where the level has no such kernel
+    bool idct_ignores_mismatch_bit;    // a lone mismatch control bit in F[7][7] doesn't change the output
+
+    iquant_func_t inverse_quant[2]; // indexed by intra
+};
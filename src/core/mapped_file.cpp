@@ -0,0 +1,82 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#include <algorithm>
+#include <fstream>
+#include "mapped_file.h"
+#include "decoder.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define MAPPED_FILE_POSIX
+#endif
+
+#ifdef MAPPED_FILE_POSIX
+bool mapped_file_c::open(const char* file_name) {
+    close();
+    int fd = ::open(file_name, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    m_size = st.st_size;
+
+    // Reserve zeroed anonymous pages for the file and its padding, then place the file over them:
+    // the padding stays readable even when the file ends on a page boundary.
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    m_map_size = (m_size + STREAM_PADDING + page_size - 1) & ~(page_size - 1);
+    void* base = mmap(nullptr, m_map_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    if (mmap(base, m_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, m_map_size);
+        ::close(fd);
+        return false;
+    }
+    m_data = (uint8_t*)base;
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    madvise(m_data, m_size, MADV_SEQUENTIAL);
+    madvise(m_data, std::min(m_size, MAPPED_FILE_WILLNEED_SIZE), MADV_WILLNEED);
+    ::close(fd);
+    return true;
+}
+
+void mapped_file_c::close() {
+    if (m_data)
+        munmap(m_data, m_map_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_map_size = 0;
+}
+#else
+bool mapped_file_c::open(const char* file_name) {
+    close();
+    std::ifstream fp(file_name, std::ios::binary | std::ios::ate);
+    if (!fp)
+        return false;
+    m_size = fp.tellg();
+    fp.seekg(0, std::ios_base::beg);
+    m_buffer.assign(m_size + STREAM_PADDING, 0);
+    fp.read((char*)&m_buffer[0], m_size);
+    m_data = &m_buffer[0];
+    return true;
+}
+
+void mapped_file_c::close() {
+    m_buffer.clear();
+    m_buffer.shrink_to_fit();
+    m_data = nullptr;
+    m_size = 0;
+    m_map_size = 0;
+}
+#endif
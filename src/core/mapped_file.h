@@ -0,0 +1,25 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+constexpr size_t MAPPED_FILE_WILLNEED_SIZE = 16 << 20; // prefetched ahead of the sequential readahead
+
+// Read-only view of a whole elementary stream followed by at least STREAM_PADDING zero bytes,
+// so it can be passed to mp2v_decoder_c::decode() as is.
+class mapped_file_c {
+public:
+    mapped_file_c() {}
+    ~mapped_file_c() { close(); }
+    bool open(const char* file_name);
+    void close();
+
+    uint8_t* get_data() { return m_data; }
+    size_t   get_size() { return m_size; }
+private:
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_map_size = 0;
+    std::vector<uint8_t> m_buffer; // used where the file can't be mapped
+};
@@ -4,47 +4,40 @@
 #include "mp2v_vlc.h"
 #include "mc.h"
 #include "scan.h"
-
-#if defined(CPU_PLATFORM_AARCH64)
-#include "idct_aarch64.hpp"
-#elif defined(CPU_PLATFORM_X64)
-#include "idct_sse2.hpp"
-#else
-#include "idct_c.hpp"
-#endif
+#include "idct.h"
+#include "iquant.h"
+#include "kernels.h"
 
 enum mc_template_e {
     mc_templ_field,
     mc_templ_frame
 };
 
+template <int chroma_format, int plane_idx>
+constexpr int macroblock_width() {
+    return (plane_idx == 0 || chroma_format == chroma_format_444) ? 16 : 8;
+}
+
+template <int chroma_format, int plane_idx>
+constexpr int macroblock_height() {
+    return (plane_idx == 0 || chroma_format != chroma_format_420) ? 16 : 8;
+}
+
 template <int chroma_format>
-MP2V_INLINE static void inc_macroblock_yuv_ptr(uint8_t* (&yuv)[3]) {
-    yuv[0] += 16;
-    switch (chroma_format) {
-    case chroma_format_420:
-        yuv[1] += 8;
-        yuv[2] += 8;
-        break;
-    case chroma_format_422:
-        yuv[1] += 8;
-        yuv[2] += 8;
-        break;
-    case chroma_format_444:
-        yuv[1] += 16;
-        yuv[2] += 16;
-        break;
-    }
+MP2V_INLINE static void inc_macroblock_yuv_ptr(uint8_t* (&yuv)[3], uint32_t num = 1) {
+    yuv[0] += macroblock_width<chroma_format, 0>() * num;
+    yuv[1] += macroblock_width<chroma_format, 1>() * num;
+    yuv[2] += macroblock_width<chroma_format, 2>() * num;
 }
 
 template <int chroma_format>
-MP2V_INLINE static void inc_macroblock_yuv_ptrs(uint8_t* (&yuv)[3][3]) {
-    inc_macroblock_yuv_ptr<chroma_format>(yuv[REF_TYPE_SRC]);
-    inc_macroblock_yuv_ptr<chroma_format>(yuv[REF_TYPE_L0]);
-    inc_macroblock_yuv_ptr<chroma_format>(yuv[REF_TYPE_L1]);
+MP2V_INLINE static void inc_macroblock_yuv_ptrs(uint8_t* (&yuv)[3][3], uint32_t num = 1) {
+    inc_macroblock_yuv_ptr<chroma_format>(yuv[REF_TYPE_SRC], num);
+    inc_macroblock_yuv_ptr<chroma_format>(yuv[REF_TYPE_L0], num);
+    inc_macroblock_yuv_ptr<chroma_format>(yuv[REF_TYPE_L1], num);
 }
-template<bool luma>
-MP2V_INLINE int16_t parse_dct_dc_coeff(bitstream_reader_c* bs, uint16_t& dct_dc_pred, int intra_dc_precision) {
+template<bool luma, class bitstream_reader_t>
+MP2V_INLINE int16_t parse_dct_dc_coeff(bitstream_reader_t* bs, uint16_t& dct_dc_pred, int intra_dc_precision) {
     uint16_t dct_dc_differential;
     uint16_t dct_dc_size;
     if (luma) {
@@ -71,18 +64,53 @@ MP2V_INLINE int16_t parse_dct_dc_coeff(bitstream_reader_c* bs, uint16_t& dct_dc_
     return dct_dc_pred << (3 - intra_dc_precision);;
 }
 
-template<bool use_dct_one_table, bool intra, bool alt_scan>
-static void parse_block(bitstream_reader_c* bs, int16_t* qfs, uint8_t W[64], uint8_t quantizer_scale) {
-    int run = 0, level = 0, i = intra ? 1 : 0, sign = 0, sum = 0;
+// Rows (high byte) and columns (low byte) of QFS holding coefficients, as reported by parse_block()
+constexpr uint32_t BLOCK_OCCUPANCY_DC  = 0x0101;
+constexpr uint32_t BLOCK_OCCUPANCY_4x4 = 0x0f0f;
+
+enum block_pass_e {
+    block_pass_full,       // parse and reconstruct
+    block_pass_parse,      // parse into cache.batch
+    block_pass_reconstruct // reconstruct from cache.batch
+};
+
+// Coefficient destinations of parse_block(): the QFS block itself or the list of the two-phase batch.
+// Both scans end at raster position 63, so the mismatch control coefficient is the last one of the list.
+struct dense_coeffs_t {
+    int16_t* qfs;
+    MP2V_INLINE void put(int idx, int16_t val) { qfs[idx] = val; }
+    MP2V_INLINE void toggle_last() { qfs[63] ^= 1; }
+    MP2V_INLINE int16_t last() { return qfs[63]; }
+};
+
+struct sparse_coeffs_t {
+    mb_coeff_t* coeffs;
+    int num;
+    MP2V_INLINE void put(int idx, int16_t val) { coeffs[num].idx = (uint16_t)idx; coeffs[num++].value = val; }
+    MP2V_INLINE void toggle_last() {
+        if (num && coeffs[num - 1].idx == 63) coeffs[num - 1].value ^= 1;
+        else put(63, 1);
+    }
+    MP2V_INLINE int16_t last() { return (num && coeffs[num - 1].idx == 63) ? coeffs[num - 1].value : 0; }
+};
+
+// The VLC loop only collects signed levels and their raster positions, inverse quantisation runs on all of them
+// at once with the premultiplied weights WQ (see quant_tables_t) and the values are scattered afterwards
+template<bool use_dct_one_table, bool intra, bool alt_scan, class bitstream_reader_t, class coeffs_t>
+static uint32_t parse_block(const kernels_t& kernels, bitstream_reader_t* bs, coeffs_t& qfs, const uint16_t WQ[64]) {
+    ALIGN(16) int16_t levels[64 + 8];
+    ALIGN(16) int16_t values[64 + 8];
+    uint8_t idx[64 + 8];
+    int run = 0, level = 0, i = intra ? 1 : 0, sign = 0, num = 0;
+    uint32_t occupancy = 0;
     BITSTREAM(bs);
 
-    if (!use_dct_one_table) {
+    if (!use_dct_one_table && !intra) { // first coefficient of a non-intra block, '10' isn't an end of block
         UPDATE_BITS();
         uint32_t coef = GET_NEXT_BITS(2);
         if (coef & 2) {
-            sign = -(coef & 1);
-            int16_t val = (3 * W[i] * quantizer_scale) >> 5;
-            sum = qfs[i++] = (val ^ sign) - sign;
+            levels[0] = (coef & 1) ? -1 : 1;
+            idx[num++] = g_scan_trans[alt_scan ? 1 : 0][i++];
             SKIP_BITS(2);
         }
     }
@@ -90,109 +118,125 @@ static void parse_block(bitstream_reader_c* bs, int16_t* qfs, uint8_t W[64], uin
     while (1) {
         UPDATE_BITS();
         uint32_t buffer = GET_NEXT_BITS(32);
+        SKIP_BITS(get_coeff_run_level<use_dct_one_table>(buffer, run, level, sign));
+        if (run == COEFF_LUT_EOB) break;
 
-        // EOB
-        if (use_dct_one_table) { if ((buffer & 0xF0000000u) == (0b0110u << (32u - 4u))) { SKIP_BITS(4); break; } }
-        else                   { if ((buffer & 0xc0000000u) == (0b10u << (32u - 2u)))     { SKIP_BITS(2); break; } }
-
-        if ((buffer & 0xfc000000u) == (0b000001u << (32u - 6u))) { // escape code
-            buffer <<= 6;
-            run = ((uint32_t)buffer >> (32 - 6));
-            buffer <<= 6;
-            level = ((int32_t)buffer >> (32 - 12));
-            sign = ((int32_t)level >> 31); // store sign
-            level = (level ^ sign) - sign; // remove sign
-            SKIP_BITS(24);
-        }
-        else if ((buffer & 0xf8000000) == (0b00100 << (32 - 5))) {
-            coeff_t coeff = (use_dct_one_table ? vlc_coeff_one_ex : vlc_coeff_zero_ex)[(buffer >> (32 - 8)) & 7];
-            level = coeff.level;
-            sign = (buffer & (1 << (31 - 8))) ? -1 : 0;
-            run = coeff.run;
-            SKIP_BITS(9);
-        }
-        else {
-            vlc_lut_coeff_t coeff;
-            if (use_dct_one_table) {
-                int nlz = bit_scan_reverse(buffer);
-                if (nlz > 0) {
-                    int idx = buffer >> (32 - nlz - 5);
-                    coeff = vlc_coeff_one0[nlz - 1][idx];
-                }
-                else {
-                    nlz = std::min<uint32_t>(bit_scan_reverse(~buffer), 8);
-                    int idx = (buffer >> (32 - nlz - 3)) & 7;
-                    coeff = vlc_coeff_one1[nlz - 1][idx];
-                }
-            }
-            else {
-                int nlz = bit_scan_reverse(buffer);
-                int idx = buffer >> (32 - nlz - 5);
-                coeff = vlc_coeff_zero[nlz][idx];
-            }
-            run = coeff.coeff.run;
-            sign = (buffer & (1 << (31 - coeff.len))) ? -1 : 0;
-            level = coeff.coeff.level;
-            SKIP_BITS(coeff.len + 1);
-        }
-
-        int32_t val;
         i += run;
-        int idx = (int)g_scan_trans[alt_scan ? 1 : 0][i];
-        if (intra) val = (level * W[i] * quantizer_scale) >> 4;
-        else       val = ((2 * level + 1) * W[i] * quantizer_scale) >> 5;
-        val = (val ^ sign) - sign; // apply sign
+        if (i > 63) break; // malformed block, bits are out of sync anyway
+        levels[num] = (int16_t)((level ^ sign) - sign);
+        idx[num++] = g_scan_trans[alt_scan ? 1 : 0][i++];
+    }
 
-        sum += (qfs[idx] = std::max<int16_t>(std::min<int16_t>(val, (int16_t)2047), (int16_t)-2048));
-        i++;
+    memset(&levels[num], 0, 8 * sizeof(levels[0]));
+    memset(&idx[num], 0, 8);
+    int sum = kernels.inverse_quant[intra](values, levels, idx, WQ, num);
+    for (int k = 0; k < num; k++) {
+        qfs.put(idx[k], values[k]);
+        occupancy |= (0x100 << (idx[k] >> 3)) | (1 << (idx[k] & 7));
     }
 
-    sum &= 1;
-    sum ^= 1;
-    qfs[63] ^= sum;
+    if (!(sum & 1))
+        qfs.toggle_last();
+    int16_t last = qfs.last();
+    if (last && !(kernels.idct_ignores_mismatch_bit && last == 1))
+        occupancy |= 0x8080;
 
     UPDATE_BITS();
+    return occupancy;
 }
 
-template<bool alt_scan, bool intra, bool add, bool use_dct_one_table, bool luma = false>
-MP2V_INLINE void decode_block_template(bitstream_reader_c* m_bs, uint8_t* plane, uint32_t stride, uint8_t W_i[64], uint8_t W[64], uint8_t quantizer_scale, uint16_t& dct_dc_pred, uint8_t intra_dc_prec) {
-    ALIGN(32) int16_t QFS[64] = { 0 };
+template<bool add>
+MP2V_INLINE void reconstruct_block_template(const kernels_t& kernels, uint8_t* plane, int16_t QFS[64], uint32_t stride, uint32_t occupancy) {
+    if (!(occupancy & ~BLOCK_OCCUPANCY_DC))
+        kernels.inverse_dct_dc[add](plane, QFS, stride);
+    else if (!(occupancy & ~BLOCK_OCCUPANCY_4x4))
+        kernels.inverse_dct_4x4[add](plane, QFS, stride);
+    else
+        kernels.inverse_dct[add](plane, QFS, stride);
+}
+
+// Coefficients of the next block into the zeroed QFS, parsed from the bitstream or replayed from the batch
+template<bool alt_scan, bool intra, bool use_dct_one_table, bool luma, block_pass_e pass, class bitstream_reader_t>
+MP2V_INLINE uint32_t get_block_coeffs(const kernels_t& kernels, bitstream_reader_t* m_bs, int16_t QFS[64], const uint16_t WQ_i[64], const uint16_t WQ[64], uint16_t& dct_dc_pred, uint8_t intra_dc_prec, mb_batch_t* batch) {
+    if (pass == block_pass_reconstruct) {
+        mb_block_t& block = batch->blocks[batch->next_block++];
+        mb_coeff_t* coeffs = &batch->coeffs[batch->next_coeff];
+        batch->next_coeff += block.num_coeffs;
+        for (uint32_t i = 0; i < block.num_coeffs; i++)
+            QFS[coeffs[i].idx] = coeffs[i].value;
+        return block.occupancy;
+    }
+    dense_coeffs_t coeffs = { QFS };
     if (intra) QFS[0] = parse_dct_dc_coeff<luma>(m_bs, dct_dc_pred, intra_dc_prec);
-    parse_block<use_dct_one_table, intra, alt_scan>(m_bs, QFS, intra ? W_i : W, quantizer_scale);
-    inverse_dct_template<add>(plane, QFS, stride);
+    return parse_block<use_dct_one_table, intra, alt_scan>(kernels, m_bs, coeffs, intra ? WQ_i : WQ);
+}
+
+template<bool alt_scan, bool intra, bool add, bool use_dct_one_table, bool luma = false, block_pass_e pass = block_pass_full, class bitstream_reader_t>
+MP2V_INLINE void decode_block_template(const kernels_t& kernels, bitstream_reader_t* m_bs, uint8_t* plane, uint32_t stride, const uint16_t WQ_i[64], const uint16_t WQ[64], uint16_t& dct_dc_pred, uint8_t intra_dc_prec, mb_batch_t* batch) {
+    if (pass == block_pass_parse) {
+        sparse_coeffs_t coeffs = { &batch->coeffs[batch->num_coeffs], 0 };
+        mb_block_t& block = batch->blocks[batch->num_blocks++];
+        if (intra) coeffs.put(0, parse_dct_dc_coeff<luma>(m_bs, dct_dc_pred, intra_dc_prec));
+        block.occupancy = parse_block<use_dct_one_table, intra, alt_scan>(kernels, m_bs, coeffs, intra ? WQ_i : WQ);
+        block.num_coeffs = coeffs.num;
+        batch->num_coeffs += coeffs.num;
+    }
+    else {
+        ALIGN(32) int16_t QFS[64] = { 0 };
+        uint32_t occupancy = get_block_coeffs<alt_scan, intra, use_dct_one_table, luma, pass>(kernels, m_bs, QFS, WQ_i, WQ, dct_dc_pred, intra_dc_prec, batch);
+        reconstruct_block_template<add>(kernels, plane, QFS, stride, occupancy);
+    }
+}
+
+// Two consecutive blocks sharing the stride. With a two block IDCT kernel both are transformed in one pass unless both are DC only.
+template<bool alt_scan, bool intra, bool add, bool use_dct_one_table, bool luma = false, block_pass_e pass = block_pass_full, class bitstream_reader_t>
+MP2V_INLINE void decode_block_pair_template(const kernels_t& kernels, bitstream_reader_t* m_bs, uint16_t coded_block_pattern, int idx, uint8_t* plane0, uint8_t* plane1, uint32_t stride, const uint16_t WQ_i[64], const uint16_t WQ[64], uint16_t& dct_dc_pred0, uint16_t& dct_dc_pred1, uint8_t intra_dc_prec, mb_batch_t* batch) {
+    bool coded0 = (coded_block_pattern >> idx) & 1;
+    bool coded1 = (coded_block_pattern >> (idx + 1)) & 1;
+    if (pass != block_pass_parse && coded0 && coded1 && kernels.inverse_dct_x2[add]) {
+        ALIGN(32) int16_t QFS[2][64] = { { 0 } };
+        uint32_t occupancy0 = get_block_coeffs<alt_scan, intra, use_dct_one_table, luma, pass>(kernels, m_bs, QFS[0], WQ_i, WQ, dct_dc_pred0, intra_dc_prec, batch);
+        uint32_t occupancy1 = get_block_coeffs<alt_scan, intra, use_dct_one_table, luma, pass>(kernels, m_bs, QFS[1], WQ_i, WQ, dct_dc_pred1, intra_dc_prec, batch);
+        if ((occupancy0 | occupancy1) & ~BLOCK_OCCUPANCY_DC)
+            kernels.inverse_dct_x2[add](plane0, plane1, QFS[0], QFS[1], stride);
+        else {
+            kernels.inverse_dct_dc[add](plane0, QFS[0], stride);
+            kernels.inverse_dct_dc[add](plane1, QFS[1], stride);
+        }
+        return;
+    }
+    if (coded0) decode_block_template<alt_scan, intra, add, use_dct_one_table, luma, pass>(kernels, m_bs, plane0, stride, WQ_i, WQ, dct_dc_pred0, intra_dc_prec, batch);
+    if (coded1) decode_block_template<alt_scan, intra, add, use_dct_one_table, luma, pass>(kernels, m_bs, plane1, stride, WQ_i, WQ, dct_dc_pred1, intra_dc_prec, batch);
 }
 
 //decode_transform_template<chroma_format, alt_scan, true, true >(m_bs, cache.yuv_planes[REF_TYPE_SRC], cache.luma_stride, cache.W, coded_block_pattern, cache.quantiser_scale, cache.dct_dc_pred, cache.intra_dc_prec);
-template<int chroma_format, bool alt_scan, bool intra, bool add, bool use_dct_one_table>
-MP2V_INLINE void decode_transform_template(bitstream_reader_c* m_bs, macroblock_context_cache_t& cache, uint16_t coded_block_pattern, bool dct_type) {
+template<int chroma_format, bool alt_scan, bool intra, bool add, bool use_dct_one_table, block_pass_e pass = block_pass_full, class bitstream_reader_t>
+MP2V_INLINE void decode_transform_template(bitstream_reader_t* m_bs, macroblock_context_cache_t& cache, uint16_t coded_block_pattern, bool dct_type) {
     auto yuv_planes      = cache.yuv_planes[REF_TYPE_SRC];
     auto &dct_dc_pred    = cache.dct_dc_pred;
     auto intra_dc_prec   = cache.intra_dc_prec;
-    auto quantizer_scale = cache.quantiser_scale;
     int chroma_stride    = (dct_type && (chroma_format != 1)) ? cache.chroma_stride << 1 : cache.chroma_stride;
     int stride           = dct_type ? cache.luma_stride << 1 : cache.luma_stride;
-    auto W               = cache.W;
+    auto WQ              = cache.WQ;
+    auto& kernels        = *cache.kernels;
 
     // Luma
-    if (coded_block_pattern & (1 << 0)) decode_block_template<alt_scan, intra, add, use_dct_one_table, true>(m_bs, yuv_planes[0], stride, W[0], W[1], quantizer_scale, dct_dc_pred[0], intra_dc_prec);
-    if (coded_block_pattern & (1 << 1)) decode_block_template<alt_scan, intra, add, use_dct_one_table, true>(m_bs, yuv_planes[0] + 8, stride, W[0], W[1], quantizer_scale, dct_dc_pred[0], intra_dc_prec);
-    if (coded_block_pattern & (1 << 2)) decode_block_template<alt_scan, intra, add, use_dct_one_table, true>(m_bs, yuv_planes[0] + (dct_type ? cache.luma_stride : 8 * stride), stride, W[0], W[1], quantizer_scale, dct_dc_pred[0], intra_dc_prec);
-    if (coded_block_pattern & (1 << 3)) decode_block_template<alt_scan, intra, add, use_dct_one_table, true>(m_bs, yuv_planes[0] + (dct_type ? cache.luma_stride : 8 * stride) + 8, stride, W[0], W[1], quantizer_scale, dct_dc_pred[0], intra_dc_prec);
+    uint8_t* luma_bottom = yuv_planes[0] + (dct_type ? cache.luma_stride : 8 * stride);
+    decode_block_pair_template<alt_scan, intra, add, use_dct_one_table, true, pass>(kernels, m_bs, coded_block_pattern, 0, yuv_planes[0], yuv_planes[0] + 8, stride, WQ[0], WQ[1], dct_dc_pred[0], dct_dc_pred[0], intra_dc_prec, cache.batch);
+    decode_block_pair_template<alt_scan, intra, add, use_dct_one_table, true, pass>(kernels, m_bs, coded_block_pattern, 2, luma_bottom, luma_bottom + 8, stride, WQ[0], WQ[1], dct_dc_pred[0], dct_dc_pred[0], intra_dc_prec, cache.batch);
 
     // Chroma format 4:2:0
-    if (chroma_format >= 1) {
-        if (coded_block_pattern & (1 << 4)) decode_block_template<alt_scan, intra, add, use_dct_one_table>(m_bs, yuv_planes[1], chroma_stride, W[0], W[1], quantizer_scale, dct_dc_pred[1], intra_dc_prec);
-        if (coded_block_pattern & (1 << 5)) decode_block_template<alt_scan, intra, add, use_dct_one_table>(m_bs, yuv_planes[2], chroma_stride, W[0], W[1], quantizer_scale, dct_dc_pred[2], intra_dc_prec); }
+    if (chroma_format >= 1)
+        decode_block_pair_template<alt_scan, intra, add, use_dct_one_table, false, pass>(kernels, m_bs, coded_block_pattern, 4, yuv_planes[1], yuv_planes[2], chroma_stride, WQ[0], WQ[1], dct_dc_pred[1], dct_dc_pred[2], intra_dc_prec, cache.batch);
     // Chroma format 4:2:2
     if (chroma_format >= 2) {
-        if (coded_block_pattern & (1 << 6)) decode_block_template<alt_scan, intra, add, use_dct_one_table>(m_bs, yuv_planes[1] + (dct_type ? cache.chroma_stride : 8 * chroma_stride), chroma_stride, W[2], W[3], quantizer_scale, dct_dc_pred[1], intra_dc_prec);
-        if (coded_block_pattern & (1 << 7)) decode_block_template<alt_scan, intra, add, use_dct_one_table>(m_bs, yuv_planes[2] + (dct_type ? cache.chroma_stride : 8 * chroma_stride), chroma_stride, W[2], W[3], quantizer_scale, dct_dc_pred[2], intra_dc_prec); }
+        ptrdiff_t offset = dct_type ? cache.chroma_stride : 8 * chroma_stride;
+        decode_block_pair_template<alt_scan, intra, add, use_dct_one_table, false, pass>(kernels, m_bs, coded_block_pattern, 6, yuv_planes[1] + offset, yuv_planes[2] + offset, chroma_stride, WQ[2], WQ[3], dct_dc_pred[1], dct_dc_pred[2], intra_dc_prec, cache.batch); }
     // Chroma format 4:4:4
     if (chroma_format == 3) {
-        if (coded_block_pattern & (1 << 8))  decode_block_template<alt_scan, intra, add, use_dct_one_table>(m_bs, yuv_planes[1] + 8, chroma_stride, W[2], W[3], quantizer_scale, dct_dc_pred[1], intra_dc_prec);
-        if (coded_block_pattern & (1 << 9))  decode_block_template<alt_scan, intra, add, use_dct_one_table>(m_bs, yuv_planes[2] + 8, chroma_stride, W[2], W[3], quantizer_scale, dct_dc_pred[2], intra_dc_prec);
-        if (coded_block_pattern & (1 << 10)) decode_block_template<alt_scan, intra, add, use_dct_one_table>(m_bs, yuv_planes[1] + (dct_type ? 1 : 8) * stride + 8, chroma_stride, W[2], W[3], quantizer_scale, dct_dc_pred[1], intra_dc_prec);
-        if (coded_block_pattern & (1 << 11)) decode_block_template<alt_scan, intra, add, use_dct_one_table>(m_bs, yuv_planes[2] + (dct_type ? 1 : 8) * stride + 8, chroma_stride, W[2], W[3], quantizer_scale, dct_dc_pred[2], intra_dc_prec); }
+        ptrdiff_t offset = (dct_type ? 1 : 8) * stride + 8;
+        decode_block_pair_template<alt_scan, intra, add, use_dct_one_table, false, pass>(kernels, m_bs, coded_block_pattern, 8, yuv_planes[1] + 8, yuv_planes[2] + 8, chroma_stride, WQ[2], WQ[3], dct_dc_pred[1], dct_dc_pred[2], intra_dc_prec, cache.batch);
+        decode_block_pair_template<alt_scan, intra, add, use_dct_one_table, false, pass>(kernels, m_bs, coded_block_pattern, 10, yuv_planes[1] + offset, yuv_planes[2] + offset, chroma_stride, WQ[2], WQ[3], dct_dc_pred[1], dct_dc_pred[2], intra_dc_prec, cache.batch); }
 }
 
 template<int chroma_format, int plane_idx>
@@ -210,7 +254,7 @@ MP2V_INLINE int mc_bidir_idx(int16_t mvfx, int16_t mvfy, int16_t mvbx, int16_t m
 }
 
 template<int chroma_format, int plane_idx, int vect_idx, mc_template_e mc_templ>
-MP2V_INLINE void mc_bidir_template(uint8_t* dst, uint8_t* ref0, uint8_t* ref1, macroblock_t &mb, uint32_t stride, uint32_t chroma_stride, int16_t MVs[2][2][2]) {
+MP2V_INLINE void mc_bidir_template(const kernels_t& kernels, uint8_t* dst, uint8_t* ref0, uint8_t* ref1, macroblock_t &mb, uint32_t stride, uint32_t chroma_stride, int16_t MVs[2][2][2]) {
     auto  _stride = (mc_templ == mc_templ_field) ? stride << 1 : stride;
     auto  _chroma_stride = (mc_templ == mc_templ_field) ? chroma_stride << 1 : chroma_stride;
     uint8_t* fref = ref0;
@@ -237,15 +281,15 @@ MP2V_INLINE void mc_bidir_template(uint8_t* dst, uint8_t* ref0, uint8_t* ref1, m
 
     if (plane_idx == 0) {
         switch (mc_templ) {
-        case mc_templ_field: mc_bidir_16xh[mvs_ridx](dst, bref, fref, _stride, 8); break;
-        case mc_templ_frame: mc_bidir_16xh[mvs_ridx](dst, bref, fref, _stride, 16); break;
+        case mc_templ_field: kernels.mc_bidir_16xh[mvs_ridx](dst, bref, fref, _stride, 8); break;
+        case mc_templ_frame: kernels.mc_bidir_16xh[mvs_ridx](dst, bref, fref, _stride, 16); break;
         }
     }
     else {
         switch (chroma_format) {
-        case chroma_format_420: mc_bidir_8xh[mvs_ridx](dst, bref, fref, _chroma_stride, (mc_templ == mc_templ_field) ? 4 : 8); break;
-        case chroma_format_422: mc_bidir_8xh[mvs_ridx](dst, bref, fref, _chroma_stride, (mc_templ == mc_templ_field) ? 8 : 16); break;
-        case chroma_format_444: mc_bidir_16xh[mvs_ridx](dst, bref, fref, _chroma_stride, (mc_templ == mc_templ_field) ? 8 : 16); break;
+        case chroma_format_420: kernels.mc_bidir_8xh[mvs_ridx](dst, bref, fref, _chroma_stride, (mc_templ == mc_templ_field) ? 4 : 8); break;
+        case chroma_format_422: kernels.mc_bidir_8xh[mvs_ridx](dst, bref, fref, _chroma_stride, (mc_templ == mc_templ_field) ? 8 : 16); break;
+        case chroma_format_444: kernels.mc_bidir_16xh[mvs_ridx](dst, bref, fref, _chroma_stride, (mc_templ == mc_templ_field) ? 8 : 16); break;
         }
     }
 }
@@ -255,7 +299,7 @@ MP2V_INLINE int mc_unidir_idx(int16_t mvx, int16_t mvy) {
 }
 
 template<int chroma_format, int plane_idx, int vect_idx, mc_template_e mc_templ, bool forward>
-MP2V_INLINE void mc_unidir_template(uint8_t* dst, uint8_t* ref, macroblock_t &mb, uint32_t stride, uint32_t chroma_stride, int16_t MVs[2][2][2]) {
+MP2V_INLINE void mc_unidir_template(const kernels_t& kernels, uint8_t* dst, uint8_t* ref, macroblock_t &mb, uint32_t stride, uint32_t chroma_stride, int16_t MVs[2][2][2]) {
     auto  _stride = (mc_templ == mc_templ_field) ? stride << 1 : stride;
     auto  _chroma_stride = (mc_templ == mc_templ_field) ? chroma_stride << 1 : chroma_stride;
     auto  mvx = MVs[vect_idx][forward ? 0 : 1][0];
@@ -275,71 +319,241 @@ MP2V_INLINE void mc_unidir_template(uint8_t* dst, uint8_t* ref, macroblock_t &mb
 
     if (plane_idx == 0) {
         switch (mc_templ) {
-        case mc_templ_field: mc_pred_16xh[mvs_ridx](dst, ref, _stride,  8); break;
-        case mc_templ_frame: mc_pred_16xh[mvs_ridx](dst, ref, _stride, 16); break;
+        case mc_templ_field: kernels.mc_pred_16xh[mvs_ridx](dst, ref, _stride,  8); break;
+        case mc_templ_frame: kernels.mc_pred_16xh[mvs_ridx](dst, ref, _stride, 16); break;
         }
     }
     else {
         switch (chroma_format) {
-        case chroma_format_420: mc_pred_8xh[mvs_ridx](dst, ref, _chroma_stride, (mc_templ == mc_templ_field) ? 4 :  8); break;
-        case chroma_format_422: mc_pred_8xh[mvs_ridx](dst, ref, _chroma_stride, (mc_templ == mc_templ_field) ? 8 : 16); break;
-        case chroma_format_444: mc_pred_16xh[mvs_ridx](dst, ref, _chroma_stride, (mc_templ == mc_templ_field) ? 8 : 16); break;
+        case chroma_format_420: kernels.mc_pred_8xh[mvs_ridx](dst, ref, _chroma_stride, (mc_templ == mc_templ_field) ? 4 :  8); break;
+        case chroma_format_422: kernels.mc_pred_8xh[mvs_ridx](dst, ref, _chroma_stride, (mc_templ == mc_templ_field) ? 8 : 16); break;
+        case chroma_format_444: kernels.mc_pred_16xh[mvs_ridx](dst, ref, _chroma_stride, (mc_templ == mc_templ_field) ? 8 : 16); break;
         }
     }
 }
 
-template<int chroma_format, mc_template_e mc_templ, bool two_vect, bool skipped = false>
+template<int chroma_format, mc_template_e mc_templ, bool two_vect>
 MP2V_INLINE void base_motion_compensation(macroblock_context_cache_t& cache, macroblock_t &mb, int16_t MVs[2][2][2]) {
     auto dst = cache.yuv_planes[REF_TYPE_SRC];
     auto ref0 = cache.yuv_planes[REF_TYPE_L0];
     auto ref1 = cache.yuv_planes[REF_TYPE_L1];
     auto stride = cache.luma_stride;
     auto chroma_stride = cache.chroma_stride;
-    auto macroblock_type = skipped ? cache.previous_mb_type : mb.macroblock_type;
+    auto macroblock_type = mb.macroblock_type;
+    auto& kernels = *cache.kernels;
 
     if ((macroblock_type & macroblock_motion_forward_bit) && (macroblock_type & macroblock_motion_backward_bit)) {
-        mc_bidir_template<chroma_format, 0, 0, mc_templ>(dst[0], ref0[0], ref1[0], mb, stride, chroma_stride, MVs);
-        mc_bidir_template<chroma_format, 1, 0, mc_templ>(dst[1], ref0[1], ref1[1], mb, stride, chroma_stride, MVs);
-        mc_bidir_template<chroma_format, 2, 0, mc_templ>(dst[2], ref0[2], ref1[2], mb, stride, chroma_stride, MVs);
+        mc_bidir_template<chroma_format, 0, 0, mc_templ>(kernels, dst[0], ref0[0], ref1[0], mb, stride, chroma_stride, MVs);
+        mc_bidir_template<chroma_format, 1, 0, mc_templ>(kernels, dst[1], ref0[1], ref1[1], mb, stride, chroma_stride, MVs);
+        mc_bidir_template<chroma_format, 2, 0, mc_templ>(kernels, dst[2], ref0[2], ref1[2], mb, stride, chroma_stride, MVs);
         if (two_vect) {
-            mc_bidir_template<chroma_format, 0, 1, mc_templ>(dst[0], ref0[0], ref1[0], mb, stride, chroma_stride, MVs);
-            mc_bidir_template<chroma_format, 1, 1, mc_templ>(dst[1], ref0[1], ref1[1], mb, stride, chroma_stride, MVs);
-            mc_bidir_template<chroma_format, 2, 1, mc_templ>(dst[2], ref0[2], ref1[2], mb, stride, chroma_stride, MVs);
+            mc_bidir_template<chroma_format, 0, 1, mc_templ>(kernels, dst[0], ref0[0], ref1[0], mb, stride, chroma_stride, MVs);
+            mc_bidir_template<chroma_format, 1, 1, mc_templ>(kernels, dst[1], ref0[1], ref1[1], mb, stride, chroma_stride, MVs);
+            mc_bidir_template<chroma_format, 2, 1, mc_templ>(kernels, dst[2], ref0[2], ref1[2], mb, stride, chroma_stride, MVs);
         }
     } else
     if ((macroblock_type & macroblock_motion_forward_bit) && !(macroblock_type & macroblock_motion_backward_bit)) {
-        mc_unidir_template<chroma_format, 0, 0, mc_templ, true>(dst[0], ref0[0], mb, stride, chroma_stride, MVs);
-        mc_unidir_template<chroma_format, 1, 0, mc_templ, true>(dst[1], ref0[1], mb, stride, chroma_stride, MVs);
-        mc_unidir_template<chroma_format, 2, 0, mc_templ, true>(dst[2], ref0[2], mb, stride, chroma_stride, MVs);
+        mc_unidir_template<chroma_format, 0, 0, mc_templ, true>(kernels, dst[0], ref0[0], mb, stride, chroma_stride, MVs);
+        mc_unidir_template<chroma_format, 1, 0, mc_templ, true>(kernels, dst[1], ref0[1], mb, stride, chroma_stride, MVs);
+        mc_unidir_template<chroma_format, 2, 0, mc_templ, true>(kernels, dst[2], ref0[2], mb, stride, chroma_stride, MVs);
         if (two_vect) {
-            mc_unidir_template<chroma_format, 0, 1, mc_templ, true>(dst[0], ref0[0], mb, stride, chroma_stride, MVs);
-            mc_unidir_template<chroma_format, 1, 1, mc_templ, true>(dst[1], ref0[1], mb, stride, chroma_stride, MVs);
-            mc_unidir_template<chroma_format, 2, 1, mc_templ, true>(dst[2], ref0[2], mb, stride, chroma_stride, MVs);
+            mc_unidir_template<chroma_format, 0, 1, mc_templ, true>(kernels, dst[0], ref0[0], mb, stride, chroma_stride, MVs);
+            mc_unidir_template<chroma_format, 1, 1, mc_templ, true>(kernels, dst[1], ref0[1], mb, stride, chroma_stride, MVs);
+            mc_unidir_template<chroma_format, 2, 1, mc_templ, true>(kernels, dst[2], ref0[2], mb, stride, chroma_stride, MVs);
         }
     } else
     if (!(macroblock_type & macroblock_motion_forward_bit) && (macroblock_type & macroblock_motion_backward_bit)) {
-        mc_unidir_template<chroma_format, 0, 0, mc_templ, false>(dst[0], ref1[0], mb, stride, chroma_stride, MVs);
-        mc_unidir_template<chroma_format, 1, 0, mc_templ, false>(dst[1], ref1[1], mb, stride, chroma_stride, MVs);
-        mc_unidir_template<chroma_format, 2, 0, mc_templ, false>(dst[2], ref1[2], mb, stride, chroma_stride, MVs);
+        mc_unidir_template<chroma_format, 0, 0, mc_templ, false>(kernels, dst[0], ref1[0], mb, stride, chroma_stride, MVs);
+        mc_unidir_template<chroma_format, 1, 0, mc_templ, false>(kernels, dst[1], ref1[1], mb, stride, chroma_stride, MVs);
+        mc_unidir_template<chroma_format, 2, 0, mc_templ, false>(kernels, dst[2], ref1[2], mb, stride, chroma_stride, MVs);
         if (two_vect) {
-            mc_unidir_template<chroma_format, 0, 1, mc_templ, false>(dst[0], ref1[0], mb, stride, chroma_stride, MVs);
-            mc_unidir_template<chroma_format, 1, 1, mc_templ, false>(dst[1], ref1[1], mb, stride, chroma_stride, MVs);
-            mc_unidir_template<chroma_format, 2, 1, mc_templ, false>(dst[2], ref1[2], mb, stride, chroma_stride, MVs);
+            mc_unidir_template<chroma_format, 0, 1, mc_templ, false>(kernels, dst[0], ref1[0], mb, stride, chroma_stride, MVs);
+            mc_unidir_template<chroma_format, 1, 1, mc_templ, false>(kernels, dst[1], ref1[1], mb, stride, chroma_stride, MVs);
+            mc_unidir_template<chroma_format, 2, 1, mc_templ, false>(kernels, dst[2], ref1[2], mb, stride, chroma_stride, MVs);
         }
     } else {
-        mc_unidir_template<chroma_format, 0, 0, mc_templ, true>(dst[0], ref0[0], mb, stride, chroma_stride, MVs);
-        mc_unidir_template<chroma_format, 1, 0, mc_templ, true>(dst[1], ref0[1], mb, stride, chroma_stride, MVs);
-        mc_unidir_template<chroma_format, 2, 0, mc_templ, true>(dst[2], ref0[2], mb, stride, chroma_stride, MVs);
+        mc_unidir_template<chroma_format, 0, 0, mc_templ, true>(kernels, dst[0], ref0[0], mb, stride, chroma_stride, MVs);
+        mc_unidir_template<chroma_format, 1, 0, mc_templ, true>(kernels, dst[1], ref0[1], mb, stride, chroma_stride, MVs);
+        mc_unidir_template<chroma_format, 2, 0, mc_templ, true>(kernels, dst[2], ref0[2], mb, stride, chroma_stride, MVs);
         if (two_vect) {
-            mc_unidir_template<chroma_format, 0, 1, mc_templ, true>(dst[0], ref0[0], mb, stride, chroma_stride, MVs);
-            mc_unidir_template<chroma_format, 1, 1, mc_templ, true>(dst[1], ref0[1], mb, stride, chroma_stride, MVs);
-            mc_unidir_template<chroma_format, 2, 1, mc_templ, true>(dst[2], ref0[2], mb, stride, chroma_stride, MVs);
+            mc_unidir_template<chroma_format, 0, 1, mc_templ, true>(kernels, dst[0], ref0[0], mb, stride, chroma_stride, MVs);
+            mc_unidir_template<chroma_format, 1, 1, mc_templ, true>(kernels, dst[1], ref0[1], mb, stride, chroma_stride, MVs);
+            mc_unidir_template<chroma_format, 2, 1, mc_templ, true>(kernels, dst[2], ref0[2], mb, stride, chroma_stride, MVs);
+        }
+    }
+}
+
+template<int chroma_format>
+MP2V_INLINE void motion_compensation(macroblock_context_cache_t& cache, macroblock_t& mb, int16_t MVs[2][2][2]) {
+    switch (mb.prediction_type) {
+    case Field_based:
+        if (mb.motion_vector_count == 2) base_motion_compensation<chroma_format, mc_templ_field, true>(cache, mb, MVs);
+        else                             base_motion_compensation<chroma_format, mc_templ_field, false>(cache, mb, MVs); 
+        break;
+    case Frame_based:
+        if (mb.motion_vector_count == 2) base_motion_compensation<chroma_format, mc_templ_frame, true>(cache, mb, MVs);
+        else                             base_motion_compensation<chroma_format, mc_templ_frame, false>(cache, mb, MVs); 
+        break;
+    case Dual_Prime:
+    case MC16x8: break; // Not supported
+    }
+}
+
+// A skipped macroblock of a P picture has a zero vector, so a run of them is one rectangle copied from the reference
+template<int chroma_format, int plane_idx>
+MP2V_INLINE void copy_skipped_run(uint8_t* dst, uint8_t* ref, uint32_t stride, uint32_t num_skipped) {
+    const uint32_t width = macroblock_width<chroma_format, plane_idx>() * num_skipped;
+    for (int y = 0; y < macroblock_height<chroma_format, plane_idx>(); y++, dst += stride, ref += stride)
+        memcpy(dst, ref, width);
+}
+
+// Skipped macroblocks of a B picture all share the vectors and the direction of the macroblock before them, so the
+// kernel and the reference offsets are chosen once and the run is walked macroblock by macroblock
+template<int chroma_format, int plane_idx>
+MP2V_INLINE void mc_skipped_run(const kernels_t& kernels, uint8_t* dst, uint8_t* ref0, uint8_t* ref1, int macroblock_type, uint32_t stride, int16_t PMVs[2][2][2], uint32_t num_skipped) {
+    constexpr int width  = macroblock_width<chroma_format, plane_idx>();
+    constexpr int height = macroblock_height<chroma_format, plane_idx>();
+    bool forward  = (macroblock_type & macroblock_motion_forward_bit) || !(macroblock_type & macroblock_motion_backward_bit);
+    bool backward = (macroblock_type & macroblock_motion_backward_bit) != 0;
+    int16_t mvfx = PMVs[0][0][0], mvfy = PMVs[0][0][1];
+    int16_t mvbx = PMVs[0][1][0], mvby = PMVs[0][1][1];
+    apply_chroma_scale<chroma_format, plane_idx>(mvfx, mvfy);
+    apply_chroma_scale<chroma_format, plane_idx>(mvbx, mvby);
+    ref0 += static_cast<ptrdiff_t>(mvfx >> 1) + static_cast<ptrdiff_t>(mvfy >> 1) * stride;
+    ref1 += static_cast<ptrdiff_t>(mvbx >> 1) + static_cast<ptrdiff_t>(mvby >> 1) * stride;
+
+    if (forward && backward) {
+        auto mc = (width == 16 ? kernels.mc_bidir_16xh : kernels.mc_bidir_8xh)[mc_bidir_idx(mvfx, mvfy, mvbx, mvby)];
+        for (uint32_t i = 0; i < num_skipped; i++, dst += width, ref0 += width, ref1 += width)
+            mc(dst, ref1, ref0, stride, height);
+    }
+    else {
+        auto ref = forward ? ref0 : ref1;
+        auto mc = (width == 16 ? kernels.mc_pred_16xh : kernels.mc_pred_8xh)[forward ? mc_unidir_idx(mvfx, mvfy) : mc_unidir_idx(mvbx, mvby)];
+        for (uint32_t i = 0; i < num_skipped; i++, dst += width, ref += width)
+            mc(dst, ref, stride, height);
+    }
+}
+
+// Macroblocks skipped ahead of the current one, predicted from PMVs with the motion of cache.previous_mb_type. The whole run is
+// handled at once, per plane, and the plane pointers step over it in one go.
+template<int picture_coding_type, int picture_structure, int chroma_format>
+MP2V_INLINE void skipped_motion_compensation(macroblock_context_cache_t& cache, int16_t PMVs[2][2][2], uint32_t num_skipped) {
+    if (picture_structure == picture_structure_framepic) {
+        auto dst = cache.yuv_planes[REF_TYPE_SRC];
+        auto ref0 = cache.yuv_planes[REF_TYPE_L0];
+        auto ref1 = cache.yuv_planes[REF_TYPE_L1];
+        if (picture_coding_type == picture_coding_type_bidir) {
+            mc_skipped_run<chroma_format, 0>(*cache.kernels, dst[0], ref0[0], ref1[0], cache.previous_mb_type, cache.luma_stride, PMVs, num_skipped);
+            mc_skipped_run<chroma_format, 1>(*cache.kernels, dst[1], ref0[1], ref1[1], cache.previous_mb_type, cache.chroma_stride, PMVs, num_skipped);
+            mc_skipped_run<chroma_format, 2>(*cache.kernels, dst[2], ref0[2], ref1[2], cache.previous_mb_type, cache.chroma_stride, PMVs, num_skipped);
+        }
+        else {
+            copy_skipped_run<chroma_format, 0>(dst[0], ref0[0], cache.luma_stride, num_skipped);
+            copy_skipped_run<chroma_format, 1>(dst[1], ref0[1], cache.chroma_stride, num_skipped);
+            copy_skipped_run<chroma_format, 2>(dst[2], ref0[2], cache.chroma_stride, num_skipped);
         }
     }
+    inc_macroblock_yuv_ptrs<chroma_format>(cache.yuv_planes, num_skipped);
 }
 
-template<int picture_coding_type, int picture_structure, int frame_pred_frame_dct>
-static bool parse_modes(bitstream_reader_c* m_bs, macroblock_t& mb, int spatial_temporal_weight_code_table_index, mv_format_e& mv_format) {
+// Inter macroblocks with a coded pattern whose prediction and residual go through the fused kernels of mc.h, so
+// the prediction is never stored to be loaded again by the IDCT. Frame prediction with frame DCT only, with field
+// DCT the rows of a block aren't the rows the MC averages over.
+template<int picture_structure, int chroma_format>
+MP2V_INLINE bool mc_transform_fused(const kernels_t& kernels, int macroblock_type, int prediction_type, bool dct_type) {
+    return (picture_structure == picture_structure_framepic) && (chroma_format != chroma_format_444) &&
+        (macroblock_type & macroblock_pattern_bit) && !(macroblock_type & macroblock_intra_bit) &&
+        (prediction_type == Frame_based) && !dct_type && kernels.mc_pred_idct_8x8[MC_IDCT_8x8][0];
+}
+
+// Frame prediction of one plane, in the argument order and index of the mc_pred_8xh/mc_bidir_8xh kernels
+struct mc_block_pred_t {
+    uint8_t* src0;
+    uint8_t* src1;
+    int idx;
+    bool bidir;
+};
+
+template<int chroma_format, int plane_idx>
+MP2V_INLINE mc_block_pred_t get_mc_block_pred(macroblock_context_cache_t& cache, int macroblock_type, int16_t MVs[2][2][2]) {
+    ptrdiff_t stride = plane_idx ? cache.chroma_stride : cache.luma_stride;
+    bool forward  = macroblock_type & macroblock_motion_forward_bit;
+    bool backward = macroblock_type & macroblock_motion_backward_bit;
+    mc_block_pred_t pred;
+    pred.bidir = forward && backward;
+    if (pred.bidir) {
+        auto mvfx = MVs[0][0][0], mvfy = MVs[0][0][1];
+        auto mvbx = MVs[0][1][0], mvby = MVs[0][1][1];
+        apply_chroma_scale<chroma_format, plane_idx>(mvfx, mvfy);
+        apply_chroma_scale<chroma_format, plane_idx>(mvbx, mvby);
+        pred.idx  = mc_bidir_idx(mvfx, mvfy, mvbx, mvby);
+        pred.src0 = cache.yuv_planes[REF_TYPE_L1][plane_idx] + (mvbx >> 1) + (mvby >> 1) * stride;
+        pred.src1 = cache.yuv_planes[REF_TYPE_L0][plane_idx] + (mvfx >> 1) + (mvfy >> 1) * stride;
+    }
+    else {
+        // P macroblocks without forward motion are predicted from L0 with the vectors zeroed
+        auto mvx = MVs[0][backward ? 1 : 0][0];
+        auto mvy = MVs[0][backward ? 1 : 0][1];
+        apply_chroma_scale<chroma_format, plane_idx>(mvx, mvy);
+        pred.idx  = mc_unidir_idx(mvx, mvy);
+        pred.src0 = cache.yuv_planes[backward ? REF_TYPE_L1 : REF_TYPE_L0][plane_idx] + (mvx >> 1) + (mvy >> 1) * stride;
+        pred.src1 = nullptr;
+    }
+    return pred;
+}
+
+template<bool alt_scan, block_pass_e pass, class bitstream_reader_t>
+MP2V_INLINE void mc_decode_block_template(bitstream_reader_t* m_bs, macroblock_context_cache_t& cache, bool coded, uint8_t* dst, const mc_block_pred_t& pred, ptrdiff_t offset, uint32_t stride, const uint16_t WQ[64]) {
+    auto& kernels = *cache.kernels;
+    if (!coded) {
+        if (pred.bidir) kernels.mc_bidir_8xh[pred.idx](dst + offset, pred.src0 + offset, pred.src1 + offset, stride, 8);
+        else            kernels.mc_pred_8xh[pred.idx](dst + offset, pred.src0 + offset, stride, 8);
+        return;
+    }
+    ALIGN(32) int16_t QFS[64] = { 0 };
+    uint32_t occupancy = get_block_coeffs<alt_scan, false, false, false, pass>(kernels, m_bs, QFS, WQ, WQ, cache.dct_dc_pred[0], cache.intra_dc_prec, cache.batch);
+    mc_idct_type_e type = !(occupancy & ~BLOCK_OCCUPANCY_DC) ? MC_IDCT_DC : !(occupancy & ~BLOCK_OCCUPANCY_4x4) ? MC_IDCT_4x4 : MC_IDCT_8x8;
+    if (pred.bidir) kernels.mc_bidir_idct_8x8[type][pred.idx](dst + offset, pred.src0 + offset, pred.src1 + offset, QFS, stride);
+    else            kernels.mc_pred_idct_8x8[type][pred.idx](dst + offset, pred.src0 + offset, QFS, stride);
+}
+
+// Two luma blocks side by side, a 16 wide MC if neither is coded
+template<bool alt_scan, block_pass_e pass, class bitstream_reader_t>
+MP2V_INLINE void mc_decode_luma_pair_template(bitstream_reader_t* m_bs, macroblock_context_cache_t& cache, uint16_t coded_block_pattern, int idx, uint8_t* dst, const mc_block_pred_t& pred, ptrdiff_t offset, uint32_t stride, const uint16_t WQ[64]) {
+    if (!((coded_block_pattern >> idx) & 3)) {
+        if (pred.bidir) cache.kernels->mc_bidir_16xh[pred.idx](dst + offset, pred.src0 + offset, pred.src1 + offset, stride, 8);
+        else            cache.kernels->mc_pred_16xh[pred.idx](dst + offset, pred.src0 + offset, stride, 8);
+        return;
+    }
+    mc_decode_block_template<alt_scan, pass>(m_bs, cache, (coded_block_pattern >> idx) & 1, dst, pred, offset, stride, WQ);
+    mc_decode_block_template<alt_scan, pass>(m_bs, cache, (coded_block_pattern >> (idx + 1)) & 1, dst, pred, offset + 8, stride, WQ);
+}
+
+// Motion compensation and decode_transform_template<..., add = true> in one, see mc_transform_fused()
+template<int chroma_format, bool alt_scan, block_pass_e pass = block_pass_full, class bitstream_reader_t>
+MP2V_INLINE void mc_decode_transform_template(bitstream_reader_t* m_bs, macroblock_context_cache_t& cache, int macroblock_type, int16_t MVs[2][2][2], uint16_t coded_block_pattern) {
+    auto dst = cache.yuv_planes[REF_TYPE_SRC];
+    uint32_t stride = cache.luma_stride;
+    uint32_t chroma_stride = cache.chroma_stride;
+    auto WQ = cache.WQ;
+
+    mc_block_pred_t pred = get_mc_block_pred<chroma_format, 0>(cache, macroblock_type, MVs);
+    mc_decode_luma_pair_template<alt_scan, pass>(m_bs, cache, coded_block_pattern, 0, dst[0], pred, 0, stride, WQ[1]);
+    mc_decode_luma_pair_template<alt_scan, pass>(m_bs, cache, coded_block_pattern, 2, dst[0], pred, 8 * stride, stride, WQ[1]);
+
+    mc_block_pred_t pred_cb = get_mc_block_pred<chroma_format, 1>(cache, macroblock_type, MVs);
+    mc_block_pred_t pred_cr = get_mc_block_pred<chroma_format, 2>(cache, macroblock_type, MVs);
+    mc_decode_block_template<alt_scan, pass>(m_bs, cache, (coded_block_pattern >> 4) & 1, dst[1], pred_cb, 0, chroma_stride, WQ[1]);
+    mc_decode_block_template<alt_scan, pass>(m_bs, cache, (coded_block_pattern >> 5) & 1, dst[2], pred_cr, 0, chroma_stride, WQ[1]);
+    if (chroma_format == chroma_format_422) {
+        mc_decode_block_template<alt_scan, pass>(m_bs, cache, (coded_block_pattern >> 6) & 1, dst[1], pred_cb, 8 * chroma_stride, chroma_stride, WQ[3]);
+        mc_decode_block_template<alt_scan, pass>(m_bs, cache, (coded_block_pattern >> 7) & 1, dst[2], pred_cr, 8 * chroma_stride, chroma_stride, WQ[3]);
+    }
+}
+
+template<int picture_coding_type, int picture_structure, int frame_pred_frame_dct, class bitstream_reader_t>
+static bool parse_modes(bitstream_reader_t* m_bs, macroblock_t& mb, int spatial_temporal_weight_code_table_index, mv_format_e& mv_format) {
     mb.macroblock_type = get_macroblock_type(m_bs, picture_coding_type);
     if ((mb.macroblock_type & spatial_temporal_weight_code_flag_bit) && (spatial_temporal_weight_code_table_index != 0)) {
         /*uint32_t spatial_temporal_weight_code = */m_bs->read_next_bits(2);
@@ -354,7 +568,7 @@ static bool parse_modes(bitstream_reader_c* m_bs, macroblock_t& mb, int spatial_
             mb.field_motion_type = m_bs->read_next_bits(2);
         }
     }
-    if (frame_pred_frame_dct) mb.dct_type = 0;
+    mb.dct_type = 0; // field pictures, frame_pred_frame_dct and macroblocks without coefficients use frame DCT
     if ((picture_structure == picture_structure_framepic) && (frame_pred_frame_dct == 0) &&
         ((mb.macroblock_type & macroblock_intra_bit) || (mb.macroblock_type & macroblock_pattern_bit))) {
         mb.dct_type = m_bs->read_next_bits(1);
@@ -418,8 +632,8 @@ static bool parse_modes(bitstream_reader_c* m_bs, macroblock_t& mb, int spatial_
     return true;
 }
 
-template<int chroma_format>
-MP2V_INLINE uint16_t parse_coded_block_pattern(bitstream_reader_c* m_bs, macroblock_t& mb) {
+template<int chroma_format, class bitstream_reader_t>
+MP2V_INLINE uint16_t parse_coded_block_pattern(bitstream_reader_t* m_bs, macroblock_t& mb) {
     uint16_t coded_block_pattern = 0;
     uint32_t coded_block_pattern_1, coded_block_pattern_2, cbp;
 
@@ -476,8 +690,8 @@ MP2V_INLINE void update_motion_predictor(uint32_t f_code, int32_t motion_code, u
         PMV = MVs;
 }
 
-template<uint8_t picture_structure, bool dmv>
-MP2V_INLINE bool parse_motion_vector(bitstream_reader_c* m_bs, uint32_t f_code[2], int16_t PMV[2], int16_t MVs[2], mv_format_e mv_format) {
+template<uint8_t picture_structure, bool dmv, class bitstream_reader_t>
+MP2V_INLINE bool parse_motion_vector(bitstream_reader_t* m_bs, uint32_t f_code[2], int16_t PMV[2], int16_t MVs[2], mv_format_e mv_format) {
     int32_t motion_code = get_motion_code(m_bs);
     if ((f_code[0] != 1) && (motion_code != 0)) {
         uint32_t motion_residual = m_bs->read_next_bits(f_code[0] - 1);
@@ -502,8 +716,8 @@ MP2V_INLINE bool parse_motion_vector(bitstream_reader_c* m_bs, uint32_t f_code[2
     return true;
 }
 
-template <uint8_t picture_structure, int s, bool dmv>
-MP2V_INLINE bool parse_motion_vectors(bitstream_reader_c* m_bs, macroblock_t& mb, uint32_t f_code[2][2], int16_t PMV[2][2][2], int16_t MVs[2][2][2], mv_format_e mv_format) {
+template <uint8_t picture_structure, int s, bool dmv, class bitstream_reader_t>
+MP2V_INLINE bool parse_motion_vectors(bitstream_reader_t* m_bs, macroblock_t& mb, uint32_t f_code[2][2], int16_t PMV[2][2][2], int16_t MVs[2][2][2], mv_format_e mv_format) {
     if (mb.motion_vector_count == 1) {
         if ((mv_format == Field) && !dmv)
             mb.motion_vertical_field_select[0][s] = m_bs->read_next_bits(1);
@@ -523,8 +737,10 @@ template<uint8_t picture_coding_type,        //3 bit (I, P, B)
          uint8_t frame_pred_frame_dct,       //1 bit // only with picture_structure == frame
          uint8_t concealment_motion_vectors, //1 bit // only with picture_coding_type == I
          uint8_t chroma_format,              //2 bit (420, 422, 444)
-         bool q_scale_type, bool alt_scan>
-bool parse_macroblock_template(bitstream_reader_c* m_bs, macroblock_context_cache_t &cache) {
+         bool q_scale_type, bool alt_scan,
+         bool two_phase,                     // parse into cache.batch only
+         class bitstream_reader_t>           // bitstream_reader_c or bitstream_reader64_c
+bool parse_macroblock_template(bitstream_reader_t* m_bs, macroblock_context_cache_t &cache) {
 #ifdef _DEBUG
     auto& mb = cache.mb;
 #else
@@ -541,26 +757,21 @@ bool parse_macroblock_template(bitstream_reader_c* m_bs, macroblock_context_cach
     // decode skipped macroblocks
     if ((mb.macroblock_address_increment > 1) && (picture_coding_type == picture_coding_type_pred))
         memset(cache.PMVs, 0, sizeof(cache.PMVs));
-    for (int i = 0; i < (int)mb.macroblock_address_increment; i++) {
-        if ((uint32_t)i == (mb.macroblock_address_increment - 1)) break;
-        if (picture_structure == picture_structure_framepic) {
-            if (picture_coding_type == picture_coding_type_bidir) base_motion_compensation<chroma_format, mc_templ_frame, true,  true>(cache, mb, cache.PMVs);
-            else                                                  base_motion_compensation<chroma_format, mc_templ_frame, false, true>(cache, mb, cache.PMVs); }
-        inc_macroblock_yuv_ptrs<chroma_format>(cache.yuv_planes);
+    mb_record_t* rec = two_phase ? &cache.batch->records[cache.batch->num_records++] : nullptr;
+    if (two_phase) {
+        rec->skipped = mb.macroblock_address_increment - 1;
+        rec->skipped_mb_type = (uint8_t)cache.previous_mb_type;
+        if (rec->skipped)
+            memcpy(rec->skipped_MVs, cache.PMVs, sizeof(cache.PMVs));
     }
+    else if (mb.macroblock_address_increment > 1)
+        skipped_motion_compensation<picture_coding_type, picture_structure, chroma_format>(cache, cache.PMVs, mb.macroblock_address_increment - 1);
 
     // Parse Macroblock Modes
     mv_format_e mv_format;
     parse_modes<picture_coding_type, picture_structure, frame_pred_frame_dct>(m_bs, mb, 0, mv_format);
-    if (mb.macroblock_type & macroblock_quant_bit) {
-        auto quantiser_scale_code = m_bs->read_next_bits(5);
-        if (q_scale_type) {
-            if (quantiser_scale_code < 9)       cache.quantiser_scale =  quantiser_scale_code;
-            else if (quantiser_scale_code < 17) cache.quantiser_scale = (quantiser_scale_code -  4) << 1;
-            else if (quantiser_scale_code < 25) cache.quantiser_scale = (quantiser_scale_code - 10) << 2;
-            else                                cache.quantiser_scale = (quantiser_scale_code - 17) << 3;
-        }   else                                cache.quantiser_scale =  quantiser_scale_code << 1;
-    }
+    if (mb.macroblock_type & macroblock_quant_bit)
+        cache.WQ = cache.quant_tables->WQ[q_scale_type][m_bs->read_next_bits(5)];
 
     // Parse Motion Vectors
     int16_t  MVs[2][2][2];
@@ -577,6 +788,7 @@ bool parse_macroblock_template(bitstream_reader_c* m_bs, macroblock_context_cach
     memcpy(mb.MVs, MVs, sizeof(MVs));
 #endif
 
+    bool fused = false;
     // Update motion vectors predictors conditions (Table 7-9 � Updating of motion vector predictors in frame pictures)
     if (picture_coding_type != picture_coding_type_intra) {
         if (mb.prediction_type == Frame_based) {
@@ -602,21 +814,21 @@ bool parse_macroblock_template(bitstream_reader_c* m_bs, macroblock_context_cach
             memset(MVs, 0, sizeof(MVs));
             mb.prediction_type = (picture_structure == picture_structure_framepic) ? Frame_based : Field_based;
         }
+        fused = !two_phase && mc_transform_fused<picture_structure, chroma_format>(*cache.kernels, mb.macroblock_type, mb.prediction_type, mb.dct_type);
 
         // Motion compensation
         if (!(mb.macroblock_type & macroblock_intra_bit)) {
-            switch (mb.prediction_type) {
-            case Field_based:
-                if (mb.motion_vector_count == 2) base_motion_compensation<chroma_format, mc_templ_field, true>(cache, mb, MVs);
-                else                             base_motion_compensation<chroma_format, mc_templ_field, false>(cache, mb, MVs); 
-                break;
-            case Frame_based:
-                if (mb.motion_vector_count == 2) base_motion_compensation<chroma_format, mc_templ_frame, true>(cache, mb, MVs);
-                else                             base_motion_compensation<chroma_format, mc_templ_frame, false>(cache, mb, MVs); 
-                break;
-            case Dual_Prime:
-            case MC16x8: break; // Not supported
+            if (two_phase) {
+                memcpy(rec->MVs, MVs, sizeof(MVs));
+                rec->prediction_type = (uint8_t)mb.prediction_type;
+                rec->motion_vector_count = (uint8_t)mb.motion_vector_count;
+                rec->motion_vertical_field_select = 0;
+                for (int v : { 0, 1 })
+                    for (int s : { 0, 1 })
+                        rec->motion_vertical_field_select |= (mb.motion_vertical_field_select[v][s] & 1) << (v * 2 + s);
             }
+            else if (!fused)
+                motion_compensation<chroma_format>(cache, mb, MVs);
         }
     }
 
@@ -629,37 +841,151 @@ bool parse_macroblock_template(bitstream_reader_c* m_bs, macroblock_context_cach
     uint16_t coded_block_pattern = 0xffff;
     if (mb.macroblock_type & macroblock_pattern_bit)
         coded_block_pattern = parse_coded_block_pattern<chroma_format>(m_bs, mb);
+    constexpr block_pass_e pass = two_phase ? block_pass_parse : block_pass_full;
     if ((mb.macroblock_type & macroblock_pattern_bit) || intra_block){
-        if (dct_one_table)    decode_transform_template<chroma_format, alt_scan, true, false, true >(m_bs, cache, coded_block_pattern, mb.dct_type);
-        else if (intra_block) decode_transform_template<chroma_format, alt_scan, true, false, false>(m_bs, cache, coded_block_pattern, mb.dct_type);
-        else                  decode_transform_template<chroma_format, alt_scan, false, true, false>(m_bs, cache, coded_block_pattern, mb.dct_type);
+        if (fused)              mc_decode_transform_template<chroma_format, alt_scan>(m_bs, cache, mb.macroblock_type, MVs, coded_block_pattern);
+        else if (dct_one_table) decode_transform_template<chroma_format, alt_scan, true, false, true,  pass>(m_bs, cache, coded_block_pattern, mb.dct_type);
+        else if (intra_block)   decode_transform_template<chroma_format, alt_scan, true, false, false, pass>(m_bs, cache, coded_block_pattern, mb.dct_type);
+        else                    decode_transform_template<chroma_format, alt_scan, false, true, false, pass>(m_bs, cache, coded_block_pattern, mb.dct_type);
     }
+    else
+        coded_block_pattern = 0;
 
-    inc_macroblock_yuv_ptrs<chroma_format>(cache.yuv_planes);
+    if (two_phase) {
+        rec->macroblock_type = (uint8_t)mb.macroblock_type;
+        rec->coded_block_pattern = coded_block_pattern;
+        rec->dct_type = (picture_structure == picture_structure_framepic) && coded_block_pattern && mb.dct_type;
+    }
+    else
+        inc_macroblock_yuv_ptrs<chroma_format>(cache.yuv_planes);
     cache.previous_mb_type = mb.macroblock_type;
     return true;
 }
 
+// Prefetches the rows of a block that doesn't cross a cache line, a macroblock column of a plane
+MP2V_INLINE void prefetch_rows(const uint8_t* ptr, int height, ptrdiff_t stride) {
+    for (int y = 0; y < height; y++, ptr += stride)
+        MP2V_PREFETCH(ptr);
+}
+
+// Prefetches a width x height area of a plane, the first and the last sample of each row
+MP2V_INLINE void prefetch_area(const uint8_t* ptr, int width, int height, ptrdiff_t stride) {
+    for (int y = 0; y < height; y++, ptr += stride) {
+        MP2V_PREFETCH(ptr);
+        MP2V_PREFETCH(ptr + width - 1);
+    }
+}
+
+// Reference areas the motion compensation of rec will read, with a half sample row and column more. The macroblock
+// is mb_offset macroblocks right of the current plane pointers. Prefetch never faults, the addresses aren't clipped.
+template<uint8_t chroma_format>
+MP2V_INLINE void prefetch_macroblock_refs(macroblock_context_cache_t& cache, const mb_record_t& rec, uint32_t mb_offset) {
+    if ((rec.macroblock_type & macroblock_intra_bit) || rec.prediction_type != Frame_based)
+        return;
+    bool forward  = (rec.macroblock_type & macroblock_motion_forward_bit) || !(rec.macroblock_type & macroblock_motion_backward_bit);
+    bool backward = (rec.macroblock_type & macroblock_motion_backward_bit) != 0;
+    for (int s : { 0, 1 }) {
+        if (!(s ? backward : forward))
+            continue;
+        auto& ref = cache.yuv_planes[s ? REF_TYPE_L1 : REF_TYPE_L0];
+        int16_t mvx = rec.MVs[0][s][0], mvy = rec.MVs[0][s][1];
+        prefetch_area(ref[0] + mb_offset * 16 + (mvx >> 1) + (mvy >> 1) * cache.luma_stride, 17, 17, cache.luma_stride);
+        apply_chroma_scale<chroma_format, 1>(mvx, mvy);
+        ptrdiff_t offset = mb_offset * macroblock_width<chroma_format, 1>() + (mvx >> 1) + (mvy >> 1) * cache.chroma_stride;
+        prefetch_area(ref[1] + offset, macroblock_width<chroma_format, 1>() + 1, macroblock_height<chroma_format, 1>() + 1, cache.chroma_stride);
+        prefetch_area(ref[2] + offset, macroblock_width<chroma_format, 1>() + 1, macroblock_height<chroma_format, 1>() + 1, cache.chroma_stride);
+    }
+}
+
+// Reference rows the macroblock below will need that the current row doesn't read: with vertical vectors within
+// +-range the current row reads down to row 16 + range, the next one down to row 32 + range
+template<uint8_t chroma_format>
+MP2V_INLINE void prefetch_next_row_refs(macroblock_context_cache_t& cache, reference_type_t ref_type, uint32_t f_code, uint32_t mb_offset) {
+    if (f_code < 1 || f_code > 9)
+        return; // 15 - the direction isn't used
+    auto& ref = cache.yuv_planes[ref_type];
+    int range = 8 << (f_code - 1);
+    prefetch_rows(ref[0] + mb_offset * 16 + (16 + range) * cache.luma_stride, 16, cache.luma_stride);
+    constexpr int width  = macroblock_width<chroma_format, 1>();
+    constexpr int height = macroblock_height<chroma_format, 1>();
+    int chroma_range = (chroma_format == chroma_format_420) ? range >> 1 : range;
+    ptrdiff_t offset = mb_offset * width + (height + chroma_range) * cache.chroma_stride;
+    prefetch_rows(ref[1] + offset, height, cache.chroma_stride);
+    prefetch_rows(ref[2] + offset, height, cache.chroma_stride);
+}
+
+// Second pass of two-phase decoding: motion compensation and IDCT of the macroblocks parsed into cache.batch
+template<uint8_t picture_coding_type, uint8_t picture_structure, uint8_t chroma_format>
+void reconstruct_macroblocks_template(macroblock_context_cache_t& cache) {
+    mb_batch_t* batch = cache.batch;
+    macroblock_t mb;
+    int previous_mb_type = cache.previous_mb_type; // parse state, the batch may be flushed in the middle of a slice
+    int ahead = 0;          // next record to prefetch
+    uint32_t ahead_pos = 0; // its position and the one of the plane pointers, in macroblocks from the batch start
+    uint32_t pos = 0;
+    for (int n = 0; n < batch->num_records; n++) {
+        mb_record_t& rec = batch->records[n];
+        if ((picture_coding_type != picture_coding_type_intra) && (picture_structure == picture_structure_framepic) && cache.prefetch) {
+            for (; ahead <= n + MB_PREFETCH_DISTANCE && ahead < batch->num_records; ahead++) {
+                ahead_pos += batch->records[ahead].skipped;
+                prefetch_macroblock_refs<chroma_format>(cache, batch->records[ahead], ahead_pos - pos);
+                prefetch_next_row_refs<chroma_format>(cache, REF_TYPE_L0, cache.f_code[0][1], ahead_pos - pos);
+                if (picture_coding_type == picture_coding_type_bidir)
+                    prefetch_next_row_refs<chroma_format>(cache, REF_TYPE_L1, cache.f_code[1][1], ahead_pos - pos);
+                ahead_pos++;
+            }
+            pos += rec.skipped + 1;
+        }
+        if (rec.skipped) {
+            cache.previous_mb_type = rec.skipped_mb_type;
+            skipped_motion_compensation<picture_coding_type, picture_structure, chroma_format>(cache, rec.skipped_MVs, rec.skipped);
+        }
+
+        bool intra_block = rec.macroblock_type & macroblock_intra_bit;
+        bool fused = (picture_coding_type != picture_coding_type_intra) && rec.coded_block_pattern &&
+            mc_transform_fused<picture_structure, chroma_format>(*cache.kernels, rec.macroblock_type, rec.prediction_type, rec.dct_type != 0);
+        if ((picture_coding_type != picture_coding_type_intra) && !intra_block && !fused) {
+            mb.macroblock_type = rec.macroblock_type;
+            mb.prediction_type = (prediction_type_e)rec.prediction_type;
+            mb.motion_vector_count = rec.motion_vector_count;
+            for (int v : { 0, 1 })
+                for (int s : { 0, 1 })
+                    mb.motion_vertical_field_select[v][s] = (rec.motion_vertical_field_select >> (v * 2 + s)) & 1;
+            motion_compensation<chroma_format>(cache, mb, rec.MVs);
+        }
+
+        if (fused)
+            mc_decode_transform_template<chroma_format, false, block_pass_reconstruct>((macroblock_reader_t*)nullptr, cache, rec.macroblock_type, rec.MVs, rec.coded_block_pattern);
+        else if (rec.coded_block_pattern) {
+            if (intra_block) decode_transform_template<chroma_format, false, true, false, false, block_pass_reconstruct>((macroblock_reader_t*)nullptr, cache, rec.coded_block_pattern, rec.dct_type != 0);
+            else             decode_transform_template<chroma_format, false, false, true, false, block_pass_reconstruct>((macroblock_reader_t*)nullptr, cache, rec.coded_block_pattern, rec.dct_type != 0);
+        }
+        inc_macroblock_yuv_ptrs<chroma_format>(cache.yuv_planes);
+    }
+    cache.previous_mb_type = previous_mb_type;
+    batch->reset();
+}
+
 #define SEL_CHROMA_FROMATS_PARSE_MACROBLOCKS_ROUTINES(pct, ps, fpfdct, cmv) { \
     switch (chroma_format) { \
     case chroma_format_420:  \
         if (!q_scale_type) { \
-               if (!alt_scan) return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_420, false, false>;    \
-               else           return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_420, false, true>; }   \
-        else { if (!alt_scan) return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_420, true, false>;     \
-               else           return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_420, true, true>; }    \
+               if (!alt_scan) return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_420, false, false, two_phase>;    \
+               else           return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_420, false, true, two_phase>; }   \
+        else { if (!alt_scan) return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_420, true, false, two_phase>;     \
+               else           return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_420, true, true, two_phase>; }    \
     case chroma_format_422:                                                                                               \
         if (!q_scale_type) {                                                                                              \
-               if (!alt_scan) return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_422, false, false>;    \
-               else           return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_422, false, true>; }   \
-        else { if (!alt_scan) return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_422, true, false>;     \
-               else           return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_422, true, true>; }    \
+               if (!alt_scan) return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_422, false, false, two_phase>;    \
+               else           return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_422, false, true, two_phase>; }   \
+        else { if (!alt_scan) return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_422, true, false, two_phase>;     \
+               else           return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_422, true, true, two_phase>; }    \
     case chroma_format_444:                                                                                               \
         if (!q_scale_type) {                                                                                              \
-               if (!alt_scan) return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_444, false, false>;    \
-               else           return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_444, false, true>; }   \
-        else { if (!alt_scan) return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_444, true, false>;     \
-               else           return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_444, true, true>; } } }
+               if (!alt_scan) return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_444, false, false, two_phase>;    \
+               else           return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_444, false, true, two_phase>; }   \
+        else { if (!alt_scan) return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_444, true, false, two_phase>;     \
+               else           return parse_macroblock_template<pct, ps, fpfdct, cmv, chroma_format_444, true, true, two_phase>; } } }
 
 #define SEL_FRAME_FIELD_PARSE_MACROBLOCKS_ROUTINES(pct, cmv) \
     if (picture_structure == picture_structure_framepic) { \
@@ -670,7 +996,8 @@ bool parse_macroblock_template(bitstream_reader_c* m_bs, macroblock_context_cach
     } else \
         SEL_CHROMA_FROMATS_PARSE_MACROBLOCKS_ROUTINES(pct, picture_structure_topfield, 0, cmv)
 
-parse_macroblock_func_t select_parse_macroblock_func(uint8_t picture_coding_type, uint8_t picture_structure, uint8_t frame_pred_frame_dct, uint8_t concealment_motion_vectors, uint8_t chroma_format, bool q_scale_type, bool alt_scan)
+template<bool two_phase>
+static parse_macroblock_func_t select_parse_macroblock_func_template(uint8_t picture_coding_type, uint8_t picture_structure, uint8_t frame_pred_frame_dct, uint8_t concealment_motion_vectors, uint8_t chroma_format, bool q_scale_type, bool alt_scan)
 {
     switch (picture_coding_type) {
     case picture_coding_type_intra:
@@ -688,3 +1015,34 @@ parse_macroblock_func_t select_parse_macroblock_func(uint8_t picture_coding_type
         return 0;
     };
 };
+
+parse_macroblock_func_t select_parse_macroblock_func(uint8_t picture_coding_type, uint8_t picture_structure, uint8_t frame_pred_frame_dct, uint8_t concealment_motion_vectors, uint8_t chroma_format, bool q_scale_type, bool alt_scan, bool two_phase)
+{
+    if (two_phase)
+        return select_parse_macroblock_func_template<true>(picture_coding_type, picture_structure, frame_pred_frame_dct, concealment_motion_vectors, chroma_format, q_scale_type, alt_scan);
+    return select_parse_macroblock_func_template<false>(picture_coding_type, picture_structure, frame_pred_frame_dct, concealment_motion_vectors, chroma_format, q_scale_type, alt_scan);
+}
+
+#define SEL_CHROMA_FORMATS_RECONSTRUCT_ROUTINES(pct, ps) { \
+    switch (chroma_format) { \
+    case chroma_format_420: return reconstruct_macroblocks_template<pct, ps, chroma_format_420>; \
+    case chroma_format_422: return reconstruct_macroblocks_template<pct, ps, chroma_format_422>; \
+    case chroma_format_444: return reconstruct_macroblocks_template<pct, ps, chroma_format_444>; \
+    default: return 0; } }
+
+#define SEL_FRAME_FIELD_RECONSTRUCT_ROUTINES(pct) \
+    if (picture_structure == picture_structure_framepic) \
+        SEL_CHROMA_FORMATS_RECONSTRUCT_ROUTINES(pct, picture_structure_framepic) \
+    else \
+        SEL_CHROMA_FORMATS_RECONSTRUCT_ROUTINES(pct, picture_structure_topfield)
+
+reconstruct_macroblocks_func_t select_reconstruct_macroblocks_func(uint8_t picture_coding_type, uint8_t picture_structure, uint8_t chroma_format)
+{
+    switch (picture_coding_type) {
+    case picture_coding_type_intra: SEL_FRAME_FIELD_RECONSTRUCT_ROUTINES(picture_coding_type_intra)
+    case picture_coding_type_pred:  SEL_FRAME_FIELD_RECONSTRUCT_ROUTINES(picture_coding_type_pred)
+    case picture_coding_type_bidir: SEL_FRAME_FIELD_RECONSTRUCT_ROUTINES(picture_coding_type_bidir)
+    default:
+        return 0;
+    };
+}
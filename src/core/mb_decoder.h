@@ -8,8 +8,68 @@ enum reference_type_t  {
     REF_TYPE_L1  = 2,
 };
 
+constexpr int MB_BATCH_SIZE = 128;              // macroblocks, a full 1920 wide row
+constexpr int MB_BATCH_BLOCKS = MB_BATCH_SIZE * 12;
+constexpr int MB_BATCH_COEFFS = 1 << 15;
+constexpr int MB_MAX_COEFFS = 12 * 64;          // worst case of one macroblock
+constexpr int MB_PREFETCH_DISTANCE = 2;         // records ahead of the reconstruction whose references are prefetched
+
+// Two-phase slice decoding (decoder_config_t::two_phase): the parse pass stores macroblocks as records,
+// one mb_block_t per coded block and the nonzero coefficients in raster positions, the reconstruction
+// pass replays them with motion compensation and IDCT.
+struct mb_coeff_t {
+    uint16_t idx;
+    int16_t  value;
+};
+
+// The IDCT variant is picked from occupancy alone. The last scan position isn't kept: it bounds the coefficients
+// only along the scan, a region that differs between the zigzag and the alternate scan, and the rows and columns
+// of occupancy are never wider than what it would give.
+struct mb_block_t {
+    uint32_t occupancy; // see parse_block()
+    uint32_t num_coeffs;
+};
+
+struct mb_record_t {
+    int16_t  MVs[2][2][2];
+    int16_t  skipped_MVs[2][2][2];  // PMVs the skipped run ahead of this macroblock is predicted from
+    uint32_t skipped;               // number of skipped macroblocks ahead of this one
+    uint16_t coded_block_pattern;
+    uint8_t  macroblock_type;
+    uint8_t  skipped_mb_type;
+    uint8_t  prediction_type;
+    uint8_t  motion_vector_count;
+    uint8_t  motion_vertical_field_select; // bit v * 2 + s
+    uint8_t  dct_type;              // field DCT, coded macroblocks of frame pictures only
+};
+
+struct mb_batch_t {
+    int num_records;
+    int num_blocks;
+    int num_coeffs;
+    int next_block; // reconstruction cursors
+    int next_coeff;
+    mb_record_t records[MB_BATCH_SIZE];
+    mb_block_t  blocks[MB_BATCH_BLOCKS];
+    mb_coeff_t  coeffs[MB_BATCH_COEFFS];
+
+    void reset() { num_records = num_blocks = num_coeffs = next_block = next_coeff = 0; }
+    bool full() { return num_records == MB_BATCH_SIZE || num_coeffs > MB_BATCH_COEFFS - MB_MAX_COEFFS; }
+};
+
+// Quantiser matrices premultiplied by quantiser_scale, WQ[q_scale_type][quantiser_scale_code][matrix][idx]
+// with the matrices intra, non-intra, chroma intra and chroma non-intra and idx the raster position in QFS.
+// Built by the decoder whenever the matrices change and shared read-only by the pictures decoded with them.
+struct quant_tables_t {
+    uint16_t WQ[2][32][4][64];
+};
+
+struct kernels_t;
+
 struct macroblock_context_cache_t {
-    uint8_t W[4][64];
+    const kernels_t* kernels; // of the decoder
+    const quant_tables_t* quant_tables;
+    const uint16_t (*WQ)[64]; // quant_tables->WQ[q_scale_type][quantiser_scale_code]
     uint32_t f_code[2][2]; 
     int16_t  PMVs[2][2][2];
     uint16_t dct_dc_pred[3];
@@ -17,16 +77,22 @@ struct macroblock_context_cache_t {
     int spatial_temporal_weight_code_table_index;
     int luma_stride;
     int chroma_stride;
-    int quantiser_scale;
     int intra_dc_prec;
     int intra_vlc_format;
     int previous_mb_type;
+    mb_batch_t* batch; // two-phase decoding only
+    bool prefetch;     // two-phase decoding only, see decoder_config_t::prefetch
 
 #ifdef _DEBUG
     macroblock_t mb;
 #endif
 };
 
-typedef bool (*parse_macroblock_func_t)(bitstream_reader_c* m_bs, macroblock_context_cache_t &cache);
+// Reader used below the slice header. Both bitstream readers fit, bitstream_reader64_c measured slower on x64
+typedef bitstream_reader_c macroblock_reader_t;
+typedef bool (*parse_macroblock_func_t)(macroblock_reader_t* m_bs, macroblock_context_cache_t &cache);
+typedef void (*reconstruct_macroblocks_func_t)(macroblock_context_cache_t &cache);
 
-parse_macroblock_func_t select_parse_macroblock_func(uint8_t picture_coding_type, uint8_t picture_structure, uint8_t frame_pred_frame_dct, uint8_t concealment_motion_vectors, uint8_t chroma_format, bool q_scale_type, bool alt_scan);
+// two_phase selects the parse pass which only fills cache.batch
+parse_macroblock_func_t select_parse_macroblock_func(uint8_t picture_coding_type, uint8_t picture_structure, uint8_t frame_pred_frame_dct, uint8_t concealment_motion_vectors, uint8_t chroma_format, bool q_scale_type, bool alt_scan, bool two_phase = false);
+reconstruct_macroblocks_func_t select_reconstruct_macroblocks_func(uint8_t picture_coding_type, uint8_t picture_structure, uint8_t chroma_format);
@@ -1,25 +1,75 @@
+#include <string.h>
 #include "mc.h"
+#include "kernels.h"
 #include "core/common/cpu.hpp"
+#include "mc_c.hpp"
+#if defined(CPU_PLATFORM_AARCH64)
+#include "mc_aarch64.hpp"
+#elif defined(CPU_PLATFORM_X64)
+#include "mc_sse2.hpp"
+#include "mc_avx2.hpp"
+#include "mc_idct_sse2.hpp"
+#endif
+
+#define MC_ARRAYS_16XH(prefix) \
+static mc_pred_func_t mc_pred_16xh_##prefix[4]    = { mc_pred00_16xh_##prefix,    mc_pred01_16xh_##prefix,    mc_pred10_16xh_##prefix,    mc_pred11_16xh_##prefix }; \
+static mc_bidir_func_t mc_bidir_16xh_##prefix[16] = { mc_bidir0000_16xh_##prefix, mc_bidir0001_16xh_##prefix, mc_bidir0010_16xh_##prefix, mc_bidir0011_16xh_##prefix, \
+                                                      mc_bidir0100_16xh_##prefix, mc_bidir0101_16xh_##prefix, mc_bidir0110_16xh_##prefix, mc_bidir0111_16xh_##prefix, \
+                                                      mc_bidir1000_16xh_##prefix, mc_bidir1001_16xh_##prefix, mc_bidir1010_16xh_##prefix, mc_bidir1011_16xh_##prefix, \
+                                                      mc_bidir1100_16xh_##prefix, mc_bidir1101_16xh_##prefix, mc_bidir1110_16xh_##prefix, mc_bidir1111_16xh_##prefix };
 
 #define MC_ARRAYS(prefix) \
-mc_pred_func_t mc_pred_16xh[4]    = { mc_pred00_16xh_##prefix,    mc_pred01_16xh_##prefix,    mc_pred10_16xh_##prefix,    mc_pred11_16xh_##prefix }; \
-mc_pred_func_t mc_pred_8xh[4]     = { mc_pred00_8xh_##prefix,     mc_pred01_8xh_##prefix,     mc_pred10_8xh_##prefix,     mc_pred11_8xh_##prefix }; \
-mc_bidir_func_t mc_bidir_16xh[16] = { mc_bidir0000_16xh_##prefix, mc_bidir0001_16xh_##prefix, mc_bidir0010_16xh_##prefix, mc_bidir0011_16xh_##prefix, \
-                                      mc_bidir0100_16xh_##prefix, mc_bidir0101_16xh_##prefix, mc_bidir0110_16xh_##prefix, mc_bidir0111_16xh_##prefix, \
-                                      mc_bidir1000_16xh_##prefix, mc_bidir1001_16xh_##prefix, mc_bidir1010_16xh_##prefix, mc_bidir1011_16xh_##prefix, \
-                                      mc_bidir1100_16xh_##prefix, mc_bidir1101_16xh_##prefix, mc_bidir1110_16xh_##prefix, mc_bidir1111_16xh_##prefix }; \
-mc_bidir_func_t mc_bidir_8xh[16] = {  mc_bidir0000_8xh_##prefix,  mc_bidir0001_8xh_##prefix,  mc_bidir0010_8xh_##prefix,  mc_bidir0011_8xh_##prefix, \
-                                      mc_bidir0100_8xh_##prefix,  mc_bidir0101_8xh_##prefix,  mc_bidir0110_8xh_##prefix,  mc_bidir0111_8xh_##prefix, \
-                                      mc_bidir1000_8xh_##prefix,  mc_bidir1001_8xh_##prefix,  mc_bidir1010_8xh_##prefix,  mc_bidir1011_8xh_##prefix, \
-                                      mc_bidir1100_8xh_##prefix,  mc_bidir1101_8xh_##prefix,  mc_bidir1110_8xh_##prefix,  mc_bidir1111_8xh_##prefix };
+MC_ARRAYS_16XH(prefix) \
+static mc_pred_func_t mc_pred_8xh_##prefix[4]     = { mc_pred00_8xh_##prefix,     mc_pred01_8xh_##prefix,     mc_pred10_8xh_##prefix,     mc_pred11_8xh_##prefix }; \
+static mc_bidir_func_t mc_bidir_8xh_##prefix[16] = {  mc_bidir0000_8xh_##prefix,  mc_bidir0001_8xh_##prefix,  mc_bidir0010_8xh_##prefix,  mc_bidir0011_8xh_##prefix, \
+                                                      mc_bidir0100_8xh_##prefix,  mc_bidir0101_8xh_##prefix,  mc_bidir0110_8xh_##prefix,  mc_bidir0111_8xh_##prefix, \
+                                                      mc_bidir1000_8xh_##prefix,  mc_bidir1001_8xh_##prefix,  mc_bidir1010_8xh_##prefix,  mc_bidir1011_8xh_##prefix, \
+                                                      mc_bidir1100_8xh_##prefix,  mc_bidir1101_8xh_##prefix,  mc_bidir1110_8xh_##prefix,  mc_bidir1111_8xh_##prefix };
 
+#define MC_BIND(prefix) \
+    memcpy(kernels.mc_pred_16xh,  mc_pred_16xh_##prefix,  sizeof(kernels.mc_pred_16xh)); \
+    memcpy(kernels.mc_pred_8xh,   mc_pred_8xh_##prefix,   sizeof(kernels.mc_pred_8xh)); \
+    memcpy(kernels.mc_bidir_16xh, mc_bidir_16xh_##prefix, sizeof(kernels.mc_bidir_16xh)); \
+    memcpy(kernels.mc_bidir_8xh,  mc_bidir_8xh_##prefix,  sizeof(kernels.mc_bidir_8xh));
+
+MC_ARRAYS(c)
 #if defined(CPU_PLATFORM_AARCH64)
-#include "mc_aarch64.hpp"
 MC_ARRAYS(aarch64)
 #elif defined(CPU_PLATFORM_X64)
-#include "mc_sse2.hpp"
 MC_ARRAYS(sse2)
-#else
-#include "mc_c.hpp"
-MC_ARRAYS(c)
+MC_ARRAYS_16XH(avx2)
+#endif
+
+void mc_init(kernels_t& kernels, cpu_isa_e isa, idct_accuracy_e accuracy) {
+    memset(kernels.mc_pred_idct_8x8,  0, sizeof(kernels.mc_pred_idct_8x8));
+    memset(kernels.mc_bidir_idct_8x8, 0, sizeof(kernels.mc_bidir_idct_8x8));
+#if defined(CPU_PLATFORM_X64)
+    // the AVX2 IDCT level is the SSE2 one for single blocks
+    if (isa == cpu_isa_sse2 || isa == cpu_isa_avx2) {
+        memcpy(kernels.mc_pred_idct_8x8,  mc_pred_idct_8x8_sse2[accuracy],  sizeof(kernels.mc_pred_idct_8x8));
+        memcpy(kernels.mc_bidir_idct_8x8, mc_bidir_idct_8x8_sse2[accuracy], sizeof(kernels.mc_bidir_idct_8x8));
+    }
+#endif
+    switch (isa) {
+#if defined(CPU_PLATFORM_AARCH64)
+    case cpu_isa_neon:
+        MC_BIND(aarch64);
+        break;
+#elif defined(CPU_PLATFORM_X64)
+    case cpu_isa_avx2:
+        MC_BIND(sse2);
+        // The AVX2 kernels only pay off where a vertical half-pel average lets two row pairs share a row, copies
+        // and horizontal averages are bound by loads and stores either way and measured slower than SSE2
+        for (int i = 0; i < 4; i++)
+            if (i & 2) kernels.mc_pred_16xh[i] = mc_pred_16xh_avx2[i];
+        for (int i = 0; i < 16; i++)
+            if (i & 0xa) kernels.mc_bidir_16xh[i] = mc_bidir_16xh_avx2[i];
+        break;
+    case cpu_isa_sse2:
+        MC_BIND(sse2);
+        break;
 #endif
+    default:
+        MC_BIND(c);
+    }
+}
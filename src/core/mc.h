@@ -1,12 +1,14 @@
 #pragma once
 #include <stdint.h>
+#include "cpu_dispatch.h"
 
 enum mc_type_e { MC_00, MC_10, MC_01, MC_11 };
+enum mc_idct_type_e { MC_IDCT_8x8, MC_IDCT_4x4, MC_IDCT_DC }; // the IDCT kernel of idct.h the block occupancy selects
 
 typedef void(*mc_pred_func_t)(uint8_t* dst, uint8_t* src, uint32_t stride, uint32_t height);
 typedef void(*mc_bidir_func_t)(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height);
+typedef void(*mc_pred_idct_func_t)(uint8_t* dst, uint8_t* src, int16_t F[64], uint32_t stride);
+typedef void(*mc_bidir_idct_func_t)(uint8_t* dst, uint8_t* src0, uint8_t* src1, int16_t F[64], uint32_t stride);
 
-extern mc_pred_func_t  mc_pred_16xh[4];
-extern mc_pred_func_t  mc_pred_8xh[4];
-extern mc_bidir_func_t mc_bidir_16xh[16];
-extern mc_bidir_func_t mc_bidir_8xh[16];
\ No newline at end of file
+struct kernels_t;
+void mc_init(kernels_t& kernels, cpu_isa_e isa, idct_accuracy_e accuracy); // see cpu_dispatch_init()
@@ -0,0 +1,103 @@
+#include "mc.h"
+#include <immintrin.h>
+#include "common/cpu.hpp"
+
+// 16 wide blocks two rows at a time, row y in the low lane and row y + 1 in the high one. The averages
+// are the ones of mc_sse2.hpp, 8 wide blocks stay there as they would fill only half of a register.
+// Rows are broadcast to both lanes and paired by a blend, which keeps the lane crossing instructions
+// out of the loops, and the half-pel types with a vertical part carry the horizontal stage of the last
+// row over to the next pair instead of loading it again.
+
+MP2V_TARGET("avx2") MP2V_INLINE __m256i mc16_broadcast_avx2(uint8_t* src) {
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)src));
+}
+
+MP2V_TARGET("avx2") MP2V_INLINE __m256i mc16x2_pair_avx2(__m256i row0, __m256i row1) {
+    return _mm256_blend_epi32(row0, row1, 0xf0);
+}
+
+MP2V_TARGET("avx2") MP2V_INLINE void mc16x2_store_avx2(uint8_t* dst, uint32_t stride, __m256i val) {
+    _mm_store_si128((__m128i*)dst, _mm256_castsi256_si128(val));
+    _mm_store_si128((__m128i*) & dst[stride], _mm256_extracti128_si256(val, 1));
+}
+
+// horizontal stage of one row, in both lanes
+template<mc_type_e mc_type>
+MP2V_TARGET("avx2") MP2V_INLINE __m256i mc16_row_template_avx2(uint8_t* src) {
+    if (mc_type == MC_01 || mc_type == MC_11)
+        return _mm256_avg_epu8(mc16_broadcast_avx2(src), mc16_broadcast_avx2(&src[1]));
+    return mc16_broadcast_avx2(src);
+}
+
+// rows y and y + 1, row is the horizontal stage of row y for MC_10 and MC_11 and becomes the one of row y + 2
+template<mc_type_e mc_type>
+MP2V_TARGET("avx2") MP2V_INLINE __m256i mc16x2_func_template_avx2(uint8_t* src, uint32_t stride, __m256i& row) {
+    if (mc_type == MC_00 || mc_type == MC_01)
+        return mc16x2_pair_avx2(mc16_row_template_avx2<mc_type>(src), mc16_row_template_avx2<mc_type>(&src[stride]));
+    __m256i row1 = mc16_row_template_avx2<mc_type>(&src[stride]);
+    __m256i row2 = mc16_row_template_avx2<mc_type>(&src[stride * 2]);
+    __m256i res = _mm256_avg_epu8(mc16x2_pair_avx2(row, row1), mc16x2_pair_avx2(row1, row2));
+    row = row2;
+    return res;
+}
+
+template<mc_type_e mc_type>
+MP2V_TARGET("avx2") MP2V_INLINE __m256i mc16_first_row_template_avx2(uint8_t* src) {
+    return (mc_type == MC_10 || mc_type == MC_11) ? mc16_row_template_avx2<mc_type>(src) : _mm256_setzero_si256();
+}
+
+template<mc_type_e mc_type>
+MP2V_TARGET("avx2") MP2V_INLINE void pred_mc16_template_avx2(uint8_t* dst, uint8_t* src, uint32_t stride, int height)
+{
+    __m256i row = mc16_first_row_template_avx2<mc_type>(src);
+    for (int j = 0; j < height; j += 8) {
+        mc16x2_store_avx2(dst + stride * 0, stride, mc16x2_func_template_avx2<mc_type>(src + stride * 0, stride, row));
+        mc16x2_store_avx2(dst + stride * 2, stride, mc16x2_func_template_avx2<mc_type>(src + stride * 2, stride, row));
+        mc16x2_store_avx2(dst + stride * 4, stride, mc16x2_func_template_avx2<mc_type>(src + stride * 4, stride, row));
+        mc16x2_store_avx2(dst + stride * 6, stride, mc16x2_func_template_avx2<mc_type>(src + stride * 6, stride, row));
+        src += stride * 8; dst += stride * 8;
+    }
+}
+
+MP2V_TARGET("avx2") void mc_pred00_16xh_avx2(uint8_t* dst, uint8_t* src, uint32_t stride, uint32_t height) { pred_mc16_template_avx2<MC_00>(dst, src, stride, height); }
+MP2V_TARGET("avx2") void mc_pred01_16xh_avx2(uint8_t* dst, uint8_t* src, uint32_t stride, uint32_t height) { pred_mc16_template_avx2<MC_01>(dst, src, stride, height); }
+MP2V_TARGET("avx2") void mc_pred10_16xh_avx2(uint8_t* dst, uint8_t* src, uint32_t stride, uint32_t height) { pred_mc16_template_avx2<MC_10>(dst, src, stride, height); }
+MP2V_TARGET("avx2") void mc_pred11_16xh_avx2(uint8_t* dst, uint8_t* src, uint32_t stride, uint32_t height) { pred_mc16_template_avx2<MC_11>(dst, src, stride, height); }
+
+template<mc_type_e mc_type_src0, mc_type_e mc_type_src1>
+MP2V_TARGET("avx2") MP2V_INLINE void bidir_mc16x2_template_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, __m256i& row0, __m256i& row1) {
+    __m256i tmp0 = mc16x2_func_template_avx2<mc_type_src0>(src0, stride, row0);
+    __m256i tmp1 = mc16x2_func_template_avx2<mc_type_src1>(src1, stride, row1);
+    mc16x2_store_avx2(dst, stride, _mm256_avg_epu8(tmp0, tmp1));
+}
+
+template<mc_type_e mc_type_src0, mc_type_e mc_type_src1>
+MP2V_TARGET("avx2") MP2V_INLINE void bidir_mc16_template_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, int height)
+{
+    __m256i row0 = mc16_first_row_template_avx2<mc_type_src0>(src0);
+    __m256i row1 = mc16_first_row_template_avx2<mc_type_src1>(src1);
+    for (int j = 0; j < height; j += 8) {
+        bidir_mc16x2_template_avx2<mc_type_src0, mc_type_src1>(dst + stride * 0, src0 + stride * 0, src1 + stride * 0, stride, row0, row1);
+        bidir_mc16x2_template_avx2<mc_type_src0, mc_type_src1>(dst + stride * 2, src0 + stride * 2, src1 + stride * 2, stride, row0, row1);
+        bidir_mc16x2_template_avx2<mc_type_src0, mc_type_src1>(dst + stride * 4, src0 + stride * 4, src1 + stride * 4, stride, row0, row1);
+        bidir_mc16x2_template_avx2<mc_type_src0, mc_type_src1>(dst + stride * 6, src0 + stride * 6, src1 + stride * 6, stride, row0, row1);
+        dst += stride * 8; src0 += stride * 8; src1 += stride * 8;
+    }
+}
+
+MP2V_TARGET("avx2") void mc_bidir0000_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_00, MC_00>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir0001_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_00, MC_01>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir0010_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_00, MC_10>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir0011_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_00, MC_11>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir0100_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_01, MC_00>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir0101_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_01, MC_01>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir0110_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_01, MC_10>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir0111_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_01, MC_11>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir1000_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_10, MC_00>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir1001_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_10, MC_01>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir1010_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_10, MC_10>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir1011_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_10, MC_11>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir1100_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_11, MC_00>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir1101_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_11, MC_01>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir1110_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_11, MC_10>(dst, src0, src1, stride, height); }
+MP2V_TARGET("avx2") void mc_bidir1111_16xh_avx2(uint8_t* dst, uint8_t* src0, uint8_t* src1, uint32_t stride, uint32_t height) { bidir_mc16_template_avx2<MC_11, MC_11>(dst, src0, src1, stride, height); }
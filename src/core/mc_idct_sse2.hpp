@@ -0,0 +1,74 @@
+#include "mc.h"
+#include <emmintrin.h>
+#include "common/cpu.hpp"
+#include "idct_sse2.hpp"
+
+// 8x8 prediction and residual in one pass: the rows of the prediction come from the averages of mc_sse2.hpp
+// straight into the store stage of the IDCT, so the block is written once and never read back.
+
+template<mc_type_e mc_type>
+struct mc8_pred_sse2 {
+    uint8_t* src;
+    uint32_t stride;
+    MP2V_INLINE __m128i row(int i) const { return mc8_func_template_sse2<mc_type>(src + stride * i, stride); }
+};
+
+template<mc_type_e mc_type_src0, mc_type_e mc_type_src1>
+struct mc8_bidir_pred_sse2 {
+    uint8_t* src0;
+    uint8_t* src1;
+    uint32_t stride;
+    MP2V_INLINE __m128i row(int i) const {
+        return _mm_avg_epu8(mc8_func_template_sse2<mc_type_src0>(src0 + stride * i, stride), mc8_func_template_sse2<mc_type_src1>(src1 + stride * i, stride));
+    }
+};
+
+template<bool conformant, mc_idct_type_e idct_type, class pred_t>
+MP2V_INLINE void mc_idct_template_sse2(uint8_t* dst, int16_t F[64], uint32_t stride, const pred_t& pred) {
+    if (idct_type == MC_IDCT_DC) {
+        add_dc_block_sse2(dst, conformant ? idct_dc_conformant_sse2(F) : idct_dc_sse2(F), stride, pred);
+        return;
+    }
+    __m128i buffer[8];
+    if (conformant) {
+        idct_block_conformant_sse2(buffer, F); // no shortcut for sparse blocks, as in inverse_dct_4x4_template_conformant
+        add_idct_block_sse2<0>(dst, buffer, stride, pred);
+    }
+    else {
+        if (idct_type == MC_IDCT_4x4) idct_4x4_block_sse2(buffer, F);
+        else                          idct_block_sse2(buffer, F);
+        add_idct_block_sse2<6>(dst, buffer, stride, pred);
+    }
+}
+
+template<bool conformant, mc_idct_type_e idct_type, mc_type_e mc_type>
+void mc_pred_idct_8x8_template_sse2(uint8_t* dst, uint8_t* src, int16_t F[64], uint32_t stride) {
+    mc_idct_template_sse2<conformant, idct_type>(dst, F, stride, mc8_pred_sse2<mc_type>{ src, stride });
+}
+
+template<bool conformant, mc_idct_type_e idct_type, mc_type_e mc_type_src0, mc_type_e mc_type_src1>
+void mc_bidir_idct_8x8_template_sse2(uint8_t* dst, uint8_t* src0, uint8_t* src1, int16_t F[64], uint32_t stride) {
+    mc_idct_template_sse2<conformant, idct_type>(dst, F, stride, mc8_bidir_pred_sse2<mc_type_src0, mc_type_src1>{ src0, src1, stride });
+}
+
+#define MC_PRED_IDCT_ARRAY_SSE2(conformant, idct_type) { \
+    mc_pred_idct_8x8_template_sse2<conformant, idct_type, MC_00>, mc_pred_idct_8x8_template_sse2<conformant, idct_type, MC_01>, \
+    mc_pred_idct_8x8_template_sse2<conformant, idct_type, MC_10>, mc_pred_idct_8x8_template_sse2<conformant, idct_type, MC_11> }
+
+#define MC_BIDIR_IDCT_ARRAY_SSE2(conformant, idct_type) { \
+    mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_00, MC_00>, mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_00, MC_01>, \
+    mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_00, MC_10>, mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_00, MC_11>, \
+    mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_01, MC_00>, mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_01, MC_01>, \
+    mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_01, MC_10>, mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_01, MC_11>, \
+    mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_10, MC_00>, mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_10, MC_01>, \
+    mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_10, MC_10>, mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_10, MC_11>, \
+    mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_11, MC_00>, mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_11, MC_01>, \
+    mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_11, MC_10>, mc_bidir_idct_8x8_template_sse2<conformant, idct_type, MC_11, MC_11> }
+
+// Indexed by idct_accuracy_e, the conformant IDCT has no 4x4 shortcut
+static mc_pred_idct_func_t mc_pred_idct_8x8_sse2[2][3][4] = {
+    { MC_PRED_IDCT_ARRAY_SSE2(false, MC_IDCT_8x8), MC_PRED_IDCT_ARRAY_SSE2(false, MC_IDCT_4x4), MC_PRED_IDCT_ARRAY_SSE2(false, MC_IDCT_DC) },
+    { MC_PRED_IDCT_ARRAY_SSE2(true,  MC_IDCT_8x8), MC_PRED_IDCT_ARRAY_SSE2(true,  MC_IDCT_8x8), MC_PRED_IDCT_ARRAY_SSE2(true,  MC_IDCT_DC) } };
+static mc_bidir_idct_func_t mc_bidir_idct_8x8_sse2[2][3][16] = {
+    { MC_BIDIR_IDCT_ARRAY_SSE2(false, MC_IDCT_8x8), MC_BIDIR_IDCT_ARRAY_SSE2(false, MC_IDCT_4x4), MC_BIDIR_IDCT_ARRAY_SSE2(false, MC_IDCT_DC) },
+    { MC_BIDIR_IDCT_ARRAY_SSE2(true,  MC_IDCT_8x8), MC_BIDIR_IDCT_ARRAY_SSE2(true,  MC_IDCT_8x8), MC_BIDIR_IDCT_ARRAY_SSE2(true,  MC_IDCT_DC) } };
@@ -1,6 +1,35 @@
 // Copyright  2021 Vladislav Ovchinnikov. All rights reserved.
 #include "mp2v_luts.hpp"
 
+vlc_lut_run_level_t vlc_coeff_lut[2][1 << COEFF_LUT_BITS];
+
+// every code short enough for the lookup fills all entries sharing its prefix
+static void init_coeff_lut(vlc_lut_run_level_t* lut, const vlc_coeff_t* codes, int num_codes, vlc_t eob) {
+    const vlc_t escape = { 0b000001, 6 };
+    for (int i = 0; i < (1 << COEFF_LUT_BITS); i++)
+        lut[i] = { COEFF_LUT_LONG, 0, 0, 0 };
+    for (int i = 0; i < num_codes; i++) {
+        int len = codes[i].vlc.len + 1;
+        if (len > COEFF_LUT_BITS) continue;
+        for (int sign = 0; sign < 2; sign++) {
+            int code = ((codes[i].vlc.value << 1) | sign) << (COEFF_LUT_BITS - len);
+            for (int j = 0; j < (1 << (COEFF_LUT_BITS - len)); j++)
+                lut[code + j] = { codes[i].coeff.run, codes[i].coeff.level, (int8_t)-sign, (uint8_t)len };
+        }
+    }
+    for (int j = 0; j < (1 << (COEFF_LUT_BITS - eob.len)); j++)
+        lut[(eob.value << (COEFF_LUT_BITS - eob.len)) + j] = { COEFF_LUT_EOB, 0, 0, (uint8_t)eob.len };
+    for (int j = 0; j < (1 << (COEFF_LUT_BITS - escape.len)); j++)
+        lut[(escape.value << (COEFF_LUT_BITS - escape.len)) + j] = { COEFF_LUT_ESCAPE, 0, 0, 24 };
+}
+
+static struct coeff_lut_initializer_t {
+    coeff_lut_initializer_t() {
+        init_coeff_lut(vlc_coeff_lut[0], coeff_zero_vlc, sizeof(coeff_zero_vlc) / sizeof(coeff_zero_vlc[0]), { 0b10, 2 });
+        init_coeff_lut(vlc_coeff_lut[1], coeff_one_vlc, sizeof(coeff_one_vlc) / sizeof(coeff_one_vlc[0]), { 0b0110, 4 });
+    }
+} coeff_lut_initializer;
+
 macroblock_type_vlc_t snr_macroblock_type[3] = {
     { { 0b1,   1 }, 0b000100 }, //0x80
     { { 0b01,  2 }, 0b100100 },
@@ -34,6 +34,13 @@ struct vlc_lut_coeff_t {
     coeff_t coeff;
 };
 
+struct vlc_lut_run_level_t {
+    uint8_t run;   // or one of COEFF_LUT_EOB, COEFF_LUT_ESCAPE, COEFF_LUT_LONG
+    uint8_t level;
+    int8_t  sign;  // 0 or -1
+    uint8_t len;   // including the sign bit
+};
+
 constexpr vlc_t    vlc_start_code = { 0x000001, 24 };
 constexpr uint32_t macroblock_escape_code = 34;
 constexpr vlc_t    vlc_macroblock_escape_code = { 0b00000001000, 11 };;
@@ -72,4 +79,5 @@ extern vlc_coeff_t coeff_zero_vlc[111];
 extern vlc_coeff_t coeff_one_vlc[111];
 
 #include "mp2v_vlc_dec.hpp"
-DEFINE_CAVLC_METHODS(bitstream_reader_c)
\ No newline at end of file
+DEFINE_CAVLC_METHODS(bitstream_reader_c)
+DEFINE_CAVLC_METHODS(bitstream_reader64_c)
\ No newline at end of file
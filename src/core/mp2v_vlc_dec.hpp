@@ -32,11 +32,26 @@ extern vlc_lut_coeff_t vlc_coeff_one0[11][32];
 extern vlc_lut_coeff_t vlc_coeff_one1[8][8];
 extern coeff_t vlc_coeff_one_ex[8];
 
+// Run, level, sign and length of a B.14/B.15 code in one lookup of the next COEFF_LUT_BITS bits. All codes up to
+// 10 bits fit with their sign, longer ones start with 0000 000 and are flagged for the leading zeros tables above.
+constexpr int     COEFF_LUT_BITS   = 11;
+constexpr uint8_t COEFF_LUT_EOB    = 64;
+constexpr uint8_t COEFF_LUT_ESCAPE = 65;
+constexpr uint8_t COEFF_LUT_LONG   = 66;
+extern vlc_lut_run_level_t vlc_coeff_lut[2][1 << COEFF_LUT_BITS]; // [intra_vlc_format]
+
+// Leading zeros of a VLC saturated to the last row of its LUT: invalid codes and the zero guard words
+// behind the bitstream land on zero entries instead of reading past the table.
+template<int max_nlz>
+MP2V_INLINE int vlc_leading_zeros(uint32_t buffer) {
+    return bit_scan_reverse(buffer | (1u << (31 - max_nlz)));
+}
+
 //ISO/IEC 13818-2 : 2000 (E) Annex B - Variable length code tables. B.1 Macroblock addressing
 template<class bitstream_reader_t>
 MP2V_INLINE int32_t get_macroblock_address_increment_lut_template(bitstream_reader_t* bs) {
     uint32_t buffer = bs->get_next_bits(32);
-    int nlz = bit_scan_reverse(buffer);
+    int nlz = vlc_leading_zeros<7>(buffer);
     int idx = buffer >> (32 - nlz - 6);
     int val = vlc_mba[nlz][idx].value;
     bs->skip_bits(vlc_mba[nlz][idx].vlc_len);
@@ -135,7 +150,7 @@ MP2V_INLINE uint8_t get_snr_scalability_macroblock_type_template(bitstream_reade
 template<class bitstream_reader_t>
 MP2V_INLINE int32_t get_coded_block_pattern_template(bitstream_reader_t* bs) {
     uint32_t buffer = bs->get_next_bits(32);
-    int nlz = bit_scan_reverse(buffer);
+    int nlz = vlc_leading_zeros<8>(buffer);
     int idx = buffer >> (32 - nlz - 5);
     int val = vlc_cbp[nlz][idx].value;
     bs->skip_bits(vlc_cbp[nlz][idx].vlc_len);
@@ -146,7 +161,7 @@ MP2V_INLINE int32_t get_coded_block_pattern_template(bitstream_reader_t* bs) {
 template<class bitstream_reader_t>
 MP2V_INLINE int32_t get_motion_code_template(bitstream_reader_t* bs) {
     uint32_t buffer = bs->get_next_bits(32);
-    int nlz = bit_scan_reverse(buffer);
+    int nlz = vlc_leading_zeros<6>(buffer);
     int idx = buffer >> (32 - nlz - 6);
     int val = vlc_motion_code[nlz][idx].value;
     bs->skip_bits(vlc_motion_code[nlz][idx].vlc_len);
@@ -231,7 +246,7 @@ MP2V_INLINE coeff_t get_coeff_zero_template(bitstream_reader_t* bs) {
         return vlc_coeff_zero_ex[idx];
     }
     else {
-        int nlz = bit_scan_reverse(buffer);
+        int nlz = vlc_leading_zeros<11>(buffer);
         int idx = buffer >> (32 - nlz - 5);
         coeff_t val = vlc_coeff_zero[nlz][idx].coeff;
         bs->skip_bits(vlc_coeff_zero[nlz][idx].len);
@@ -248,7 +263,7 @@ MP2V_INLINE coeff_t get_coeff_one_template(bitstream_reader_t* bs) {
         return vlc_coeff_one_ex[idx];
     }
     else {
-        int nlz = bit_scan_reverse(buffer);
+        int nlz = vlc_leading_zeros<11>(buffer);
         if (nlz > 0) {
             int idx = buffer >> (32 - nlz - 5);
             coeff_t val = vlc_coeff_one0[nlz - 1][idx].coeff;
@@ -266,6 +281,33 @@ MP2V_INLINE coeff_t get_coeff_one_template(bitstream_reader_t* bs) {
     }
 }
 
+// Next symbol of a block from 32 bits of look ahead, returns the code length. run is COEFF_LUT_EOB at the end of block.
+template<bool use_dct_one_table>
+MP2V_INLINE int get_coeff_run_level(uint32_t buffer, int& run, int& level, int& sign) {
+    vlc_lut_run_level_t coeff = vlc_coeff_lut[use_dct_one_table][buffer >> (32 - COEFF_LUT_BITS)];
+    run = coeff.run;
+    level = coeff.level;
+    sign = coeff.sign;
+    if (run < COEFF_LUT_EOB)
+        return coeff.len;
+    if (run == COEFF_LUT_ESCAPE) {
+        run = (buffer >> (32 - 12)) & 63;
+        level = (int32_t)(buffer << 12) >> (32 - 12);
+        sign = level >> 31;            // store sign
+        level = (level ^ sign) - sign; // remove sign
+    }
+    else if (run == COEFF_LUT_LONG) {
+        int nlz = vlc_leading_zeros<11>(buffer);
+        int idx = buffer >> (32 - nlz - 5);
+        vlc_lut_coeff_t long_coeff = use_dct_one_table ? vlc_coeff_one0[nlz - 1][idx] : vlc_coeff_zero[nlz][idx];
+        run = long_coeff.coeff.run;
+        level = long_coeff.coeff.level;
+        sign = (buffer & (1 << (31 - long_coeff.len))) ? -1 : 0;
+        return long_coeff.len + 1;
+    }
+    return coeff.len;
+}
+
 #define DEFINE_CAVLC_METHODS(STREAM_READER) \
 MP2V_INLINE int32_t get_macroblock_address_increment_lut(STREAM_READER* bs) { return get_macroblock_address_increment_lut_template(bs);  } \
 MP2V_INLINE int32_t get_macroblock_address_increment(STREAM_READER* bs) { return get_macroblock_address_increment_template(bs); } \
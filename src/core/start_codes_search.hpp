@@ -1,12 +1,35 @@
 #pragma once
-#include <vector>
-#include <functional>
+#include <stdint.h>
 #include "core/common/cpu.hpp"
+#include "cpu_dispatch.h"
 
 #if defined(CPU_PLATFORM_X64)
-void scan_start_codes(uint8_t* buffer_ptr, uint8_t* buffer_end, std::function<void(uint8_t*)> func) {
-    static const __m128i pattern_0 = _mm_setzero_si128();
-    static const __m128i pattern_1 = _mm_set1_epi8(1);
+#include <immintrin.h>
+#elif defined(CPU_PLATFORM_AARCH64)
+#include "arm_neon.h"
+#endif
+
+// All scanners report the address of the first zero byte of every 0x000001 prefix starting in [buffer_ptr, buffer_end),
+// in increasing order and nothing past buffer_end, so a prefix split by buffer_end belongs to the range it starts in.
+// The C version reads up to 2 bytes past buffer_end, SIMD versions up to 65, the buffer has to be padded accordingly.
+template<typename func_t>
+MP2V_INLINE void scan_start_codes_c(uint8_t* buffer_ptr, uint8_t* buffer_end, func_t func) {
+    int zcnt = 0;
+    for (auto ptr = buffer_ptr; ptr < buffer_end + 2; ptr++) {
+        if (*ptr == 0) zcnt++;
+        else {
+            if ((*ptr == 1) && (zcnt >= 2))
+                func(ptr - 2);
+            zcnt = 0;
+        }
+    }
+}
+
+#if defined(CPU_PLATFORM_X64)
+template<typename func_t>
+MP2V_INLINE void scan_start_codes_sse2(uint8_t* buffer_ptr, uint8_t* buffer_end, func_t func) {
+    const __m128i pattern_0 = _mm_setzero_si128();
+    const __m128i pattern_1 = _mm_set1_epi8(1);
 
     for (auto dword_ptr = buffer_ptr; dword_ptr < buffer_end; dword_ptr += 16) {
         uint8_t* ptr = dword_ptr;
@@ -20,20 +43,86 @@ void scan_start_codes(uint8_t* buffer_ptr, uint8_t* buffer_end, std::function<vo
             int zcnt = bit_scan_forward(mask);
             mask >>= (zcnt + 1);
             ptr += zcnt;
+            if (ptr >= buffer_end)
+                return;
             func(ptr++);
         }
     }
 }
-#else
-void scan_start_codes(uint8_t* buffer_ptr, uint8_t* buffer_end, std::function<void(uint8_t*)> func) {
-    int zcnt = 0;
-    for (auto ptr = buffer_ptr; ptr < buffer_end; ptr++) {
-        if (*ptr == 0) zcnt++;
-        else {
-            if ((*ptr == 1) && (zcnt >= 2))
-                func(ptr - 2);
-            zcnt = 0;
+
+// Two 32-byte lanes per iteration: the zero test of the second byte of each prefix is folded into a single
+// zero mask (z & z >> 1), so only the first byte compare of both lanes needs a separate 0x01 test.
+template<typename func_t>
+MP2V_TARGET("avx2") void scan_start_codes_avx2(uint8_t* buffer_ptr, uint8_t* buffer_end, func_t func) {
+    const __m256i pattern_0 = _mm256_setzero_si256();
+    const __m256i pattern_1 = _mm256_set1_epi8(1);
+
+    for (auto qword_ptr = buffer_ptr; qword_ptr < buffer_end; qword_ptr += 64) {
+        __m256i zero0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i*)(qword_ptr + 0)), pattern_0);
+        __m256i zero1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i*)(qword_ptr + 32)), pattern_0);
+        __m256i one0  = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i*)(qword_ptr + 2)), pattern_1);
+        __m256i one1  = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i*)(qword_ptr + 34)), pattern_1);
+
+        uint64_t zmask = (uint32_t)_mm256_movemask_epi8(zero0) | ((uint64_t)(uint32_t)_mm256_movemask_epi8(zero1) << 32);
+        uint64_t omask = (uint32_t)_mm256_movemask_epi8(one0)  | ((uint64_t)(uint32_t)_mm256_movemask_epi8(one1)  << 32);
+        if (!omask)
+            continue;
+
+        // zero flag of byte 64 is taken from the next lane
+        zmask &= (zmask >> 1) | ((uint64_t)(qword_ptr[64] == 0) << 63);
+        uint64_t mask = zmask & omask;
+
+        while (mask) {
+            uint8_t* ptr = qword_ptr + bit_scan_forward64(mask);
+            if (ptr >= buffer_end)
+                return;
+            func(ptr);
+            mask &= mask - 1;
         }
     }
 }
-#endif
\ No newline at end of file
+#elif defined(CPU_PLATFORM_AARCH64)
+// NEON has no movemask, the compare result is narrowed to a nibble per byte instead
+template<typename func_t>
+MP2V_INLINE void scan_start_codes_aarch64(uint8_t* buffer_ptr, uint8_t* buffer_end, func_t func) {
+    const uint8x16_t pattern_0 = vdupq_n_u8(0);
+    const uint8x16_t pattern_1 = vdupq_n_u8(1);
+
+    for (auto dword_ptr = buffer_ptr; dword_ptr < buffer_end; dword_ptr += 16) {
+        uint8x16_t tmp0 = vceqq_u8(vld1q_u8(dword_ptr + 0), pattern_0);
+        uint8x16_t tmp1 = vceqq_u8(vld1q_u8(dword_ptr + 1), pattern_0);
+        uint8x16_t tmp2 = vceqq_u8(vld1q_u8(dword_ptr + 2), pattern_1);
+        uint8x8_t  res  = vshrn_n_u16(vreinterpretq_u16_u8(vandq_u8(vandq_u8(tmp0, tmp1), tmp2)), 4);
+        uint64_t   mask = vget_lane_u64(vreinterpret_u64_u8(res), 0) & 0x1111111111111111ull;
+
+        while (mask) {
+            uint8_t* ptr = dword_ptr + (bit_scan_forward64(mask) >> 2);
+            if (ptr >= buffer_end)
+                return;
+            func(ptr);
+            mask &= mask - 1;
+        }
+    }
+}
+#endif
+
+// Scanner of the level, as returned by cpu_isa_select()
+template<typename func_t>
+void scan_start_codes(cpu_isa_e isa, uint8_t* buffer_ptr, uint8_t* buffer_end, func_t func) {
+    switch (isa) {
+#if defined(CPU_PLATFORM_X64)
+    case cpu_isa_avx2:
+        scan_start_codes_avx2(buffer_ptr, buffer_end, func);
+        break;
+    case cpu_isa_sse2:
+        scan_start_codes_sse2(buffer_ptr, buffer_end, func);
+        break;
+#elif defined(CPU_PLATFORM_AARCH64)
+    case cpu_isa_neon:
+        scan_start_codes_aarch64(buffer_ptr, buffer_end, func);
+        break;
+#endif
+    default:
+        scan_start_codes_c(buffer_ptr, buffer_end, func);
+    }
+}
@@ -0,0 +1,94 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#include <stdio.h>
+#include <algorithm>
+#include "stream_index.h"
+#include "decoder.h"
+#include "mp2v_hdr.h"
+#include "start_codes_search.hpp"
+
+bool stream_index_c::build(uint8_t* buffer, size_t len) {
+    bitstream_reader_c bs;
+    uint32_t picture_number = 0;
+
+    m_file.close();
+    m_buffer.clear();
+    scan_start_codes(cpu_isa_select(cpu_isa_auto), buffer, buffer + len, [&](uint8_t* ptr) {
+        uint8_t start_code = ptr[3];
+        if (start_code != sequence_header_code && start_code != group_start_code && start_code != picture_start_code)
+            return;
+        stream_index_entry_t entry = { (uint64_t)(ptr - buffer), picture_number, 0, start_code, 0 };
+        if (start_code == picture_start_code) {
+            bs.set_bitstream_buffer(ptr, buffer + len);
+            bs.skip_bits(32);
+            entry.temporal_reference = bs.read_next_bits(10);
+            entry.picture_coding_type = bs.read_next_bits(3);
+            picture_number++;
+        }
+        m_buffer.push_back(entry);
+        });
+    m_entries = m_buffer.empty() ? nullptr : &m_buffer[0];
+    m_num_entries = (int)m_buffer.size();
+    m_stream_size = len;
+    return true;
+}
+
+bool stream_index_c::save(const char* file_name) {
+    stream_index_header_t header = { STREAM_INDEX_MAGIC, STREAM_INDEX_VERSION, sizeof(stream_index_entry_t), (uint32_t)m_num_entries, m_stream_size, 0 };
+    FILE* fp = fopen(file_name, "wb");
+    if (!fp)
+        return false;
+    bool res = fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (res && m_num_entries)
+        res = fwrite(m_entries, sizeof(stream_index_entry_t), m_num_entries, fp) == (size_t)m_num_entries;
+    return (fclose(fp) == 0) && res;
+}
+
+bool stream_index_c::open(const char* file_name, size_t stream_size) {
+    m_buffer.clear();
+    m_entries = nullptr;
+    m_num_entries = 0;
+    m_stream_size = 0;
+    if (!m_file.open(file_name))
+        return false;
+
+    auto* header = (const stream_index_header_t*)m_file.get_data();
+    if (m_file.get_size() < sizeof(stream_index_header_t) ||
+        header->magic != STREAM_INDEX_MAGIC ||
+        header->version != STREAM_INDEX_VERSION ||
+        header->entry_size != sizeof(stream_index_entry_t) ||
+        header->stream_size != stream_size ||
+        m_file.get_size() != sizeof(stream_index_header_t) + (size_t)header->num_entries * sizeof(stream_index_entry_t)) {
+        m_file.close();
+        return false;
+    }
+    m_entries = (const stream_index_entry_t*)(header + 1);
+    m_num_entries = header->num_entries;
+    m_stream_size = header->stream_size;
+    return true;
+}
+
+const stream_index_entry_t* stream_index_c::find_intra_picture(uint32_t picture_number) const {
+    // entries are sorted by picture number, headers go before the picture they belong to
+    const stream_index_entry_t* end = m_entries + m_num_entries;
+    const stream_index_entry_t* entry = std::upper_bound(m_entries, end, picture_number, [](uint32_t num, const stream_index_entry_t& e) {
+        return num < e.picture_number;
+        });
+    for (ptrdiff_t i = entry - m_entries - 1; i >= 0; i--)
+        if (m_entries[i].start_code == picture_start_code && m_entries[i].picture_coding_type == picture_coding_type_intra)
+            return &m_entries[i];
+    return nullptr;
+}
+
+const stream_index_entry_t* stream_index_c::find_random_access_point(const stream_index_entry_t* picture) const {
+    const stream_index_entry_t* entry = picture;
+    while (entry != m_entries && entry[-1].start_code != picture_start_code)
+        entry--;
+    return entry;
+}
+
+const stream_index_entry_t* stream_index_c::find_sequence_header(const stream_index_entry_t* entry) const {
+    for (ptrdiff_t i = entry - m_entries; i >= 0; i--)
+        if (m_entries[i].start_code == sequence_header_code)
+            return &m_entries[i];
+    return nullptr;
+}
@@ -0,0 +1,54 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "mapped_file.h"
+
+constexpr uint32_t STREAM_INDEX_MAGIC = 0x4932564d; // "MV2I"
+constexpr uint32_t STREAM_INDEX_VERSION = 1;
+
+// Sidecar file layout: stream_index_header_t followed by num_entries of stream_index_entry_t, host byte order.
+// Both are fixed size and 16 byte aligned, so the entries are used in place from the mapped file.
+struct stream_index_header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t num_entries;
+    uint64_t stream_size; // size of the indexed elementary stream, a mismatch means a stale index
+    uint64_t reserved;
+};
+
+struct stream_index_entry_t {
+    uint64_t offset;              // position of the 0x000001 prefix in the stream
+    uint32_t picture_number;      // coded order number of the picture, or of the next one for headers
+    uint16_t temporal_reference;  // pictures only
+    uint8_t  start_code;          // sequence_header_code, group_start_code or picture_start_code
+    uint8_t  picture_coding_type; // pictures only
+};
+
+// Byte offsets of sequence headers, GOP headers and pictures of an elementary stream. Built with one
+// pass of the start code scanner, saved next to the stream and mapped back instead of rescanning.
+class stream_index_c {
+public:
+    bool build(uint8_t* buffer, size_t len); // buffer must be followed by STREAM_PADDING readable zero bytes
+    bool save(const char* file_name);
+    bool open(const char* file_name, size_t stream_size);
+
+    const stream_index_entry_t* get_entries() const { return m_entries; }
+    int get_num_entries() const { return m_num_entries; }
+    uint64_t get_stream_size() const { return m_stream_size; }
+
+    // last I-picture at or before the picture, nullptr if there is none
+    const stream_index_entry_t* find_intra_picture(uint32_t picture_number) const;
+    // sequence/GOP headers immediately preceding the picture, decoding may start from here
+    const stream_index_entry_t* find_random_access_point(const stream_index_entry_t* picture) const;
+    // last sequence header at or before the entry, nullptr if there is none
+    const stream_index_entry_t* find_sequence_header(const stream_index_entry_t* entry) const;
+private:
+    const stream_index_entry_t* m_entries = nullptr;
+    int m_num_entries = 0;
+    uint64_t m_stream_size = 0;
+    std::vector<stream_index_entry_t> m_buffer; // entries of a built index
+    mapped_file_c m_file;                       // entries of an opened index
+};
@@ -42,6 +42,7 @@ void picture_task_c::reset() {
     done_slices.store(0);
     num_waiters.store(0);
     render.store(false);
+    queued.store(false);
     slices_tasks.clear();
 }
 
@@ -59,7 +60,7 @@ void picture_task_c::wait_for_render() {
 
 void picture_task_c::wait_for_completion() {
     std::unique_lock<std::mutex> lk(mtx);
-    cv_completed.wait(lk, [this] { return done_slices.load() == slices_tasks.size(); });
+    cv_completed.wait(lk, [this] { return queued.load() && done_slices.load() == slices_tasks.size(); });
 }
 
 void picture_task_c::release_waiter() {
@@ -83,10 +84,17 @@ bool picture_task_c::slice_done() {
     bool pic_done = false;
     {
         std::lock_guard<std::mutex> lk(mtx);
-        int done_slices_ = ++done_slices;
-        pic_done = (done_slices_ >= slices_tasks.size());
+        pic_done = (done_slices + 1 >= (int)slices_tasks.size());
+        if (!pic_done)
+            ++done_slices;
     }
     if (pic_done) {
+        // the last slice is counted after completed(), wait_for_completion() returns only then
+        completed();
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            ++done_slices;
+        }
         for (int i = 0; i < num_dependencies; i++)
             if (dependencies[i])
                 dependencies[i]->release_waiter();
@@ -105,7 +113,9 @@ int task_queue_c::make_head(int num_slices, int task_idx) {
     return (task_idx << 17) + TASKQUEUE_HEAD + num_slices;
 }
 
-bool task_queue_c::wait_for_next_task() {
+// Only one worker waits here at a time, the others see a negative slice index. Side tasks queued meanwhile are
+// taken by the waiter as well: it hands the wait over through waiting_pic_idx and returns with the side task.
+bool task_queue_c::wait_for_next_task(int pic_idx, slice_task_c*& side_task) {
     while (1) {
         auto ready = ready_to_go_tasks.load();
         if (ready < 0) {
@@ -113,6 +123,13 @@ bool task_queue_c::wait_for_next_task() {
             return false;
         }
         if (ready > 0) break;
+        if (side_head.load() > 0) {
+            side_task = get_side_task();
+            if (side_task) {
+                waiting_pic_idx.store(pic_idx);
+                return false;
+            }
+        }
     }
     return true;
 }
@@ -140,6 +157,20 @@ task_status_e task_queue_c::get_task(slice_task_c*& slice_task) {
     while (1) {
         int head_desc = head.load();
         if (head_desc & TASKQUEUE_HEAD_KILL) return TASK_QUEUE_KILL;
+        if (side_head.load() > 0) {
+            slice_task = get_side_task();
+            if (slice_task) return TASK_QUEUE_SUCCESS;
+        }
+        if (waiting_pic_idx.load() >= 0) {
+            int pic_idx = waiting_pic_idx.exchange(-1);
+            if (pic_idx >= 0) {
+                if (wait_for_next_task(pic_idx, slice_task))
+                    next_task(pic_idx);
+                else if (slice_task)
+                    return TASK_QUEUE_SUCCESS;
+                continue;
+            }
+        }
         int slice_idx = get_slice_idx(head_desc);
         if (slice_idx >= 0) {
             head_desc = --head;
@@ -151,8 +182,10 @@ task_status_e task_queue_c::get_task(slice_task_c*& slice_task) {
                 return TASK_QUEUE_SUCCESS;
             }
             else if (slice_idx == TASKQUEUE_SLICE_NEXT_TASK) {
-                if (wait_for_next_task())
+                if (wait_for_next_task(pic_idx, slice_task))
                     next_task(pic_idx);
+                else if (slice_task)
+                    return TASK_QUEUE_SUCCESS;
             }
         }
     }
@@ -187,6 +220,11 @@ picture_task_c* task_queue_c::get_decoded() {
 
 void task_queue_c::add_task(picture_task_c* task, bool non_referenceable) {
     task->non_referenceable = non_referenceable;
+    {
+        std::lock_guard<std::mutex> lk(task->mtx);
+        task->queued.store(true);
+    }
+    task->cv_completed.notify_all(); // a picture without slices is complete right away
     if (status == QUEUE_SUSPENDED) {
         head.store(make_head(task_queue[0]->slices_tasks.size(), 0));
         status = QUEUE_WORK;
@@ -195,6 +233,17 @@ void task_queue_c::add_task(picture_task_c* task, bool non_referenceable) {
         ready_to_go_tasks++;
 }
 
+// Side tasks are not bound to a picture: workers pick them up ahead of slices, the caller tracks their completion
+void task_queue_c::add_side_tasks(slice_task_c** tasks, int num_tasks) {
+    side_tasks = tasks;
+    side_head.store(num_tasks);
+}
+
+slice_task_c* task_queue_c::get_side_task() {
+    int idx = --side_head;
+    return (idx >= 0) ? side_tasks[idx] : nullptr;
+}
+
 void task_queue_c::flush() {
     for (auto* task : task_queue) {
         task->wait_for_completion();
@@ -205,6 +254,8 @@ void task_queue_c::flush() {
 void task_queue_c::kill() {
     flush();
     ready_to_go_tasks.store(-1);
+    if (status == QUEUE_SUSPENDED) // nothing was queued, workers are still idle on the initial head
+        head.store(TASKQUEUE_HEAD | TASKQUEUE_HEAD_KILL | TASKQUEUE_HEAD_NOWORK);
     render_flush.store(true);
     for (auto* task : task_queue)
         task->wait_for_render();
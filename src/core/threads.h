@@ -26,18 +26,21 @@ protected:
     friend class picture_task_c;
 public:
     picture_task_c* owner = nullptr;
+    virtual ~slice_task_c() {}
+    virtual void decode() {}
     virtual bool done();
 };
 
 class picture_task_c {
 public:
-    picture_task_c() : done_slices(0), num_waiters(0), render(true) {}
+    picture_task_c() : done_slices(0), num_waiters(0), render(true), queued(true) {}
     int add_slice_task(slice_task_c *task);
     bool add_dependency(picture_task_c* dependency);
     void wait_for_dependencies();
     virtual void reset();
     void release_waiter();
     void render_done();
+    virtual void completed() {} // runs on the thread finishing the last slice, before any waiter sees the picture done
 
 protected:
     picture_task_c* dependencies[MAX_NUM_DEPENDENCIES] = {};
@@ -57,6 +60,7 @@ private:
     std::atomic<int> done_slices;
     std::atomic<int> num_waiters;
     std::atomic<bool> render;
+    std::atomic<bool> queued; // all slices are added, a reset picture isn't complete before that
     std::vector<slice_task_c*> slices_tasks;
     std::condition_variable cv_completed;
     std::condition_variable cv_render;
@@ -72,6 +76,8 @@ public:
     picture_task_c* create_task();
     picture_task_c* get_decoded();
     void add_task(picture_task_c* task, bool non_referenceable = false);
+    void add_side_tasks(slice_task_c** tasks, int num_tasks);
+    slice_task_c* get_side_task();
     void flush();
     void kill();
 
@@ -82,6 +88,9 @@ private:
     std::atomic<int> ready_to_go_tasks;
     std::atomic<int> head;
     std::atomic<bool> render_flush;
+    std::atomic<int> side_head{ 0 };
+    std::atomic<int> waiting_pic_idx{ -1 }; // picture whose successor a worker left waiting for to run a side task
+    slice_task_c** side_tasks = nullptr;
     std::vector<picture_task_c*> task_queue;
     std::mutex mtx;
     int head_to_work = 0;
@@ -90,7 +99,7 @@ private:
     static int get_pic_idx(int head_);
     static int get_slice_idx(int head_);
     static int make_head(int num_slices, int task_idx);
-    bool wait_for_next_task();
+    bool wait_for_next_task(int pic_idx, slice_task_c*& side_task);
     void next_task(int pic_idx);
 };
 
@@ -0,0 +1,105 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#include <vector>
+#include <random>
+#include <chrono>
+
+// unit test common
+#include "test_common.h"
+
+// Tiny MPEG2 headers
+#include "core/mp2v_vlc.h"
+
+constexpr int BS_NUM_CODES = 1 << 16;
+constexpr int BS_NUM_CODES_PERFORMANCE = 1 << 22;
+constexpr int BS_NUM_ITERATIONS_PERFORMANCE = 10;
+constexpr int BS_BUFFER_PADDING = 128;
+constexpr int BS_RANDOM_SEED = 1729;
+
+class bitstream_reader_test_c : public ::testing::Test {
+public:
+    bitstream_reader_test_c() : gen(BS_RANDOM_SEED) {}
+    ~bitstream_reader_test_c() {}
+    void SetUp() {}
+    void TearDown() {}
+
+    // sequence of random B.14 coefficient codes, each followed by a sign bit
+    void generate_bitstream(int num_codes) {
+        std::uniform_int_distribution<uint32_t> code_gen(0, ARRAY_SIZE(coeff_zero_vlc) - 1);
+        uint64_t acc = 0;
+        int acc_len = 0;
+
+        buffer.clear();
+        for (int i = 0; i < num_codes; i++) {
+            vlc_t vlc = coeff_zero_vlc[code_gen(gen)].vlc;
+            acc = (acc << (vlc.len + 1)) | ((uint64_t)vlc.value << 1) | (gen() & 1);
+            acc_len += vlc.len + 1;
+            for (; acc_len >= 8; acc_len -= 8)
+                buffer.push_back((uint8_t)(acc >> (acc_len - 8)));
+        }
+        if (acc_len)
+            buffer.push_back((uint8_t)(acc << (8 - acc_len)));
+        buffer_size = (int)buffer.size();
+        buffer.resize(((buffer_size + 3) & ~3) + BS_BUFFER_PADDING, 0);
+        codes = num_codes;
+    }
+
+    template<class bitstream_reader_t>
+    GTEST_NO_INLINE_ uint32_t parse_bitstream(std::vector<coeff_t>& coeffs) {
+        bitstream_reader_t bs;
+        uint32_t signs = 0;
+        bs.set_bitstream_buffer(&buffer[0], &buffer[(buffer_size + 3) & ~3]);
+        coeffs.resize(codes);
+        for (int i = 0; i < codes; i++) {
+            coeffs[i] = get_coeff_zero(&bs);
+            signs += bs.read_next_bits(1);
+        }
+        return signs;
+    }
+
+    template<class bitstream_reader_t>
+    double measure_speed(std::vector<coeff_t>& coeffs, uint32_t& signs) {
+        const auto start = std::chrono::system_clock::now();
+        for (int step = 0; step < BS_NUM_ITERATIONS_PERFORMANCE; step++)
+            signs = parse_bitstream<bitstream_reader_t>(coeffs);
+        const auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start).count();
+        return (double)codes * BS_NUM_ITERATIONS_PERFORMANCE / std::max<double>(1.0, (double)elapsed_us);
+    }
+
+protected:
+    std::vector<uint8_t> buffer;
+    int buffer_size = 0;
+    int codes = 0;
+    std::mt19937 gen{};
+};
+
+static bool operator==(const std::vector<coeff_t>& val0, const std::vector<coeff_t>& val1) {
+    if (val0.size() != val1.size())
+        return false;
+    for (size_t i = 0; i < val0.size(); i++)
+        if ((val0[i].run != val1[i].run) || (val0[i].level != val1[i].level))
+            return false;
+    return true;
+}
+
+TEST_F(bitstream_reader_test_c, validation_bitstream_reader64) {
+    std::vector<coeff_t> coeffs_ref, coeffs;
+    generate_bitstream(BS_NUM_CODES);
+    uint32_t signs_ref = parse_bitstream<bitstream_reader_c>(coeffs_ref);
+    uint32_t signs = parse_bitstream<bitstream_reader64_c>(coeffs);
+    EXPECT_TRUE(coeffs == coeffs_ref);
+    EXPECT_EQ(signs, signs_ref);
+}
+
+TEST_F(bitstream_reader_test_c, performance_bitstream_reader64) {
+    std::vector<coeff_t> coeffs_ref, coeffs;
+    uint32_t signs_ref = 0, signs = 0;
+    generate_bitstream(BS_NUM_CODES_PERFORMANCE);
+    double speed_ref = measure_speed<bitstream_reader_c>(coeffs_ref, signs_ref);
+    double speed = measure_speed<bitstream_reader64_c>(coeffs, signs);
+    testing::internal::ColoredPrintf(testing::internal::COLOR_DEFAULT, "%24s: ", "bitstream_reader_c");
+    testing::internal::ColoredPrintf(testing::internal::COLOR_YELLOW, "%8.2f Mcodes/s\n", speed_ref);
+    testing::internal::ColoredPrintf(testing::internal::COLOR_DEFAULT, "%24s: ", "bitstream_reader64_c");
+    testing::internal::ColoredPrintf(testing::internal::COLOR_GREEN, "%8.2f Mcodes/s\n", speed);
+    EXPECT_TRUE(coeffs == coeffs_ref);
+    EXPECT_EQ(signs, signs_ref);
+}
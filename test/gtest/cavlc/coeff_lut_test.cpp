@@ -0,0 +1,192 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#include <vector>
+#include <random>
+#include <chrono>
+
+// unit test common
+#include "test_common.h"
+
+// Tiny MPEG2 headers
+#include "core/mp2v_vlc.h"
+
+constexpr int COEFF_NUM_BLOCKS = 1 << 14;
+constexpr int COEFF_NUM_BLOCKS_PERFORMANCE = 1 << 19;
+constexpr int COEFF_NUM_ITERATIONS_PERFORMANCE = 10;
+constexpr int COEFF_MAX_SYMBOLS_PER_BLOCK = 24;
+constexpr int COEFF_ESCAPE_RATIO = 64; // one escape code per that many symbols
+constexpr int COEFF_BUFFER_PADDING = 128;
+constexpr int COEFF_RANDOM_SEED = 1729;
+
+// Branch chain decoder the lookup replaced in parse_block(): EOB, escape, 0010 0 prefix, then leading zeros tables
+template<bool use_dct_one_table>
+static int get_coeff_run_level_ref(uint32_t buffer, int& run, int& level, int& sign) {
+    if (use_dct_one_table) { if ((buffer & 0xF0000000u) == (0b0110u << (32u - 4u))) { run = COEFF_LUT_EOB; return 4; } }
+    else                   { if ((buffer & 0xc0000000u) == (0b10u << (32u - 2u)))     { run = COEFF_LUT_EOB; return 2; } }
+
+    if ((buffer & 0xfc000000u) == (0b000001u << (32u - 6u))) { // escape code
+        buffer <<= 6;
+        run = ((uint32_t)buffer >> (32 - 6));
+        buffer <<= 6;
+        level = ((int32_t)buffer >> (32 - 12));
+        sign = ((int32_t)level >> 31);
+        level = (level ^ sign) - sign;
+        return 24;
+    }
+    if ((buffer & 0xf8000000) == (0b00100 << (32 - 5))) {
+        coeff_t coeff = (use_dct_one_table ? vlc_coeff_one_ex : vlc_coeff_zero_ex)[(buffer >> (32 - 8)) & 7];
+        level = coeff.level;
+        sign = (buffer & (1 << (31 - 8))) ? -1 : 0;
+        run = coeff.run;
+        return 9;
+    }
+    vlc_lut_coeff_t coeff;
+    if (use_dct_one_table) {
+        int nlz = vlc_leading_zeros<11>(buffer);
+        if (nlz > 0)
+            coeff = vlc_coeff_one0[nlz - 1][buffer >> (32 - nlz - 5)];
+        else {
+            nlz = std::min<uint32_t>(bit_scan_reverse(~buffer), 8);
+            coeff = vlc_coeff_one1[nlz - 1][(buffer >> (32 - nlz - 3)) & 7];
+        }
+    }
+    else {
+        int nlz = vlc_leading_zeros<11>(buffer);
+        coeff = vlc_coeff_zero[nlz][buffer >> (32 - nlz - 5)];
+    }
+    run = coeff.coeff.run;
+    sign = (buffer & (1 << (31 - coeff.len))) ? -1 : 0;
+    level = coeff.coeff.level;
+    return coeff.len + 1;
+}
+
+typedef int (*get_coeff_run_level_func_t)(uint32_t buffer, int& run, int& level, int& sign);
+
+class coeff_lut_test_c : public ::testing::Test {
+public:
+    coeff_lut_test_c() : gen(COEFF_RANDOM_SEED) {}
+    ~coeff_lut_test_c() {}
+    void SetUp() {}
+    void TearDown() {}
+
+    void put_bits(uint32_t value, int len) {
+        acc = (acc << len) | value;
+        acc_len += len;
+        for (; acc_len >= 8; acc_len -= 8)
+            buffer.push_back((uint8_t)(acc >> (acc_len - 8)));
+    }
+
+    // Blocks of random B.14/B.15 symbols terminated by EOB. Codes are drawn with probability 2^-length,
+    // the distribution the tables are built for, so short codes dominate like in real streams.
+    void generate_blocks(const vlc_coeff_t* codes, int num_codes, vlc_t eob, int num_blocks) {
+        std::vector<double> weights(num_codes);
+        for (int i = 0; i < num_codes; i++)
+            weights[i] = 1.0 / (1 << codes[i].vlc.len);
+        std::discrete_distribution<int> code_gen(weights.begin(), weights.end());
+        std::uniform_int_distribution<int> count_gen(0, COEFF_MAX_SYMBOLS_PER_BLOCK);
+        std::uniform_int_distribution<int> escape_gen(0, COEFF_ESCAPE_RATIO - 1);
+        std::uniform_int_distribution<int> level_gen(1, 2047);
+
+        buffer.clear();
+        acc = 0;
+        acc_len = 0;
+        symbols = 0;
+        for (int blk = 0; blk < num_blocks; blk++) {
+            for (int n = count_gen(gen); n > 0; n--, symbols++) {
+                int sign = gen() & 1;
+                if (escape_gen(gen) == 0) {
+                    int level = sign ? -level_gen(gen) : level_gen(gen);
+                    put_bits(0b000001, 6);
+                    put_bits(gen() & 63, 6);
+                    put_bits(level & 0xfff, 12);
+                }
+                else {
+                    vlc_coeff_t code = codes[code_gen(gen)];
+                    put_bits(code.vlc.value, code.vlc.len);
+                    put_bits(sign, 1);
+                }
+            }
+            put_bits(eob.value, eob.len);
+            symbols++;
+        }
+        if (acc_len)
+            put_bits(0, 8 - acc_len);
+        buffer_size = (int)buffer.size();
+        buffer.resize(((buffer_size + 3) & ~3) + COEFF_BUFFER_PADDING, 0);
+        blocks = num_blocks;
+    }
+
+    // decodes all blocks into (run, signed level) pairs, run is COEFF_LUT_EOB at the end of each block
+    GTEST_NO_INLINE_ void parse_blocks(get_coeff_run_level_func_t func, std::vector<int>& out) {
+        bitstream_reader_c reader;
+        bitstream_reader_c* bs = &reader;
+        int run = 0, level = 0, sign = 0;
+        reader.set_bitstream_buffer(&buffer[0], &buffer[(buffer_size + 3) & ~3]);
+        out.resize(2 * symbols);
+        int* dst = &out[0];
+
+        BITSTREAM(bs);
+        for (int blk = 0; blk < blocks; blk++) {
+            do {
+                UPDATE_BITS();
+                SKIP_BITS(func((uint32_t)GET_NEXT_BITS(32), run, level, sign));
+                *dst++ = run;
+                *dst++ = (run == COEFF_LUT_EOB) ? 0 : (level ^ sign) - sign;
+            } while (run != COEFF_LUT_EOB);
+        }
+    }
+
+    double measure_speed(get_coeff_run_level_func_t func, std::vector<int>& out) {
+        const auto start = std::chrono::system_clock::now();
+        for (int step = 0; step < COEFF_NUM_ITERATIONS_PERFORMANCE; step++)
+            parse_blocks(func, out);
+        const auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start).count();
+        return (double)symbols * COEFF_NUM_ITERATIONS_PERFORMANCE / std::max<double>(1.0, (double)elapsed_us);
+    }
+
+    bool test_parse(get_coeff_run_level_func_t func_ref, get_coeff_run_level_func_t func) {
+        std::vector<int> out_ref, out;
+        parse_blocks(func_ref, out_ref);
+        parse_blocks(func, out);
+        return out == out_ref;
+    }
+
+    bool test_parse_performance(get_coeff_run_level_func_t func_ref, get_coeff_run_level_func_t func) {
+        std::vector<int> out_ref, out;
+        double speed_ref = measure_speed(func_ref, out_ref);
+        double speed = measure_speed(func, out);
+        testing::internal::ColoredPrintf(testing::internal::COLOR_DEFAULT, "%24s: ", "branch chain");
+        testing::internal::ColoredPrintf(testing::internal::COLOR_YELLOW, "%8.2f Msymbols/s\n", speed_ref);
+        testing::internal::ColoredPrintf(testing::internal::COLOR_DEFAULT, "%24s: ", "single lookup");
+        testing::internal::ColoredPrintf(testing::internal::COLOR_GREEN, "%8.2f Msymbols/s\n", speed);
+        return out == out_ref;
+    }
+
+protected:
+    std::vector<uint8_t> buffer;
+    uint64_t acc = 0;
+    int acc_len = 0;
+    int buffer_size = 0;
+    int symbols = 0;
+    int blocks = 0;
+    std::mt19937 gen{};
+};
+
+TEST_F(coeff_lut_test_c, validation_coeff_lut_b14) {
+    generate_blocks(coeff_zero_vlc, ARRAY_SIZE(coeff_zero_vlc), { 0b10, 2 }, COEFF_NUM_BLOCKS);
+    EXPECT_TRUE(test_parse(get_coeff_run_level_ref<false>, get_coeff_run_level<false>));
+}
+
+TEST_F(coeff_lut_test_c, validation_coeff_lut_b15) {
+    generate_blocks(coeff_one_vlc, ARRAY_SIZE(coeff_one_vlc), { 0b0110, 4 }, COEFF_NUM_BLOCKS);
+    EXPECT_TRUE(test_parse(get_coeff_run_level_ref<true>, get_coeff_run_level<true>));
+}
+
+TEST_F(coeff_lut_test_c, performance_coeff_lut_b14) {
+    generate_blocks(coeff_zero_vlc, ARRAY_SIZE(coeff_zero_vlc), { 0b10, 2 }, COEFF_NUM_BLOCKS_PERFORMANCE);
+    EXPECT_TRUE(test_parse_performance(get_coeff_run_level_ref<false>, get_coeff_run_level<false>));
+}
+
+TEST_F(coeff_lut_test_c, performance_coeff_lut_b15) {
+    generate_blocks(coeff_one_vlc, ARRAY_SIZE(coeff_one_vlc), { 0b0110, 4 }, COEFF_NUM_BLOCKS_PERFORMANCE);
+    EXPECT_TRUE(test_parse_performance(get_coeff_run_level_ref<true>, get_coeff_run_level<true>));
+}
@@ -0,0 +1,148 @@
+// Copyright  2021 Vladislav Ovchinnikov. All rights reserved.
+#include <vector>
+#include <algorithm>
+
+// unit test common
+#include "test_common.h"
+#include "decoder_test_common.hpp"
+
+// Tiny MPEG2 decoder
+#include "core/decoder.h"
+
+constexpr int TEST_WIDTH = 64;
+constexpr int TEST_HEIGHT = 64;
+constexpr int TEST_NUM_FRAMES = 4;
+constexpr int TEST_CHUNK_SIZES[] = { 1, 7, 4096 };
+
+class decoder_test_c : public ::testing::Test {
+public:
+    // Output frames one after another, the top rows of every plane only. Whole buffer decoding, or push() by
+    // chunks of chunk_size.
+    std::vector<uint8_t> decode(const std::vector<uint8_t>& stream, bool two_phase, int chunk_size = 0, int rows = TEST_HEIGHT) {
+        std::vector<uint8_t> output;
+        std::vector<uint8_t> buffer(stream);
+        buffer.resize(stream.size() + STREAM_PADDING, 0);
+        num_frames = 0;
+        {
+            mp2v_decoder_c decoder({ TEST_WIDTH, TEST_HEIGHT, chroma_format_420, 4, 2, true, false, two_phase, cpu_isa_auto, idct_accuracy_fast, FRAME_PADDING, false },
+                [&](frame_c* frame) {
+                    for (int i = 0; i < 3; i++) {
+                        uint8_t* plane = frame->get_planes(i);
+                        for (int y = 0; y < (i ? rows / 2 : rows); y++, plane += frame->get_strides(i))
+                            output.insert(output.end(), plane, plane + frame->get_width(i));
+                    }
+                    num_frames++;
+                });
+            if (chunk_size) {
+                for (size_t pos = 0; pos < stream.size(); pos += chunk_size)
+                    decoder.push(&stream[pos], (int)std::min(stream.size() - pos, (size_t)chunk_size));
+                decoder.end_of_stream();
+            }
+            else
+                decoder.decode(&buffer[0], stream.size());
+        }
+        return output;
+    }
+
+    // positions of the start codes with the given code range
+    static std::vector<size_t> find_start_codes(const std::vector<uint8_t>& stream, uint8_t code_min, uint8_t code_max) {
+        std::vector<size_t> pos;
+        for (size_t i = 0; i + 3 < stream.size(); i++)
+            if (!stream[i] && !stream[i + 1] && (stream[i + 2] == 1) && (stream[i + 3] >= code_min) && (stream[i + 3] <= code_max))
+                pos.push_back(i);
+        return pos;
+    }
+
+protected:
+    int num_frames = 0;
+};
+
+// Field pictures and frame pictures with field DCT: the two-phase records carry the DCT type of every macroblock
+TEST_F(decoder_test_c, two_phase_field_pictures) {
+    mp2v_stream_writer_c writer(TEST_WIDTH, TEST_HEIGHT);
+    writer.sequence_header(false);
+    writer.group_of_pictures();
+    for (int i = 0; i < TEST_NUM_FRAMES; i++)
+        writer.intra_frame(i, true);
+    writer.sequence_end();
+
+    // every field picture is decoded to the top half of a frame of its own
+    auto single_phase = decode(writer.get_stream(), false, 0, TEST_HEIGHT / 2);
+    EXPECT_EQ(num_frames, 2 * TEST_NUM_FRAMES);
+    auto two_phase = decode(writer.get_stream(), true, 0, TEST_HEIGHT / 2);
+    EXPECT_EQ(num_frames, 2 * TEST_NUM_FRAMES);
+    EXPECT_TRUE(single_phase == two_phase);
+}
+
+TEST_F(decoder_test_c, two_phase_field_dct) {
+    mp2v_stream_writer_c writer(TEST_WIDTH, TEST_HEIGHT);
+    writer.sequence_header(false);
+    writer.group_of_pictures();
+    for (int i = 0; i < TEST_NUM_FRAMES; i++)
+        writer.intra_frame(i);
+    writer.sequence_end();
+
+    auto single_phase = decode(writer.get_stream(), false);
+    EXPECT_EQ(num_frames, TEST_NUM_FRAMES);
+    auto two_phase = decode(writer.get_stream(), true);
+    EXPECT_EQ(num_frames, TEST_NUM_FRAMES);
+    EXPECT_TRUE(single_phase == two_phase);
+}
+
+// A slice cut off in the middle of a macroblock by the next picture decodes through push() as if the stream
+// ended there: the reader gets zero bits past the cut, not the start code of the next picture
+TEST_F(decoder_test_c, push_truncated_slice) {
+    mp2v_stream_writer_c writer(TEST_WIDTH, TEST_HEIGHT);
+    writer.sequence_header(true);
+    writer.group_of_pictures();
+    writer.intra_frame(0);
+    writer.intra_frame(1);
+    writer.sequence_end();
+    std::vector<uint8_t> stream = writer.get_stream();
+
+    size_t second_picture = find_start_codes(stream, picture_start_code, picture_start_code)[1];
+    size_t last_slice = 0;
+    for (size_t pos : find_start_codes(stream, slice_start_code_min, slice_start_code_max))
+        if (pos < second_picture)
+            last_slice = pos;
+    size_t cut = (last_slice + second_picture) / 2;
+    stream.erase(stream.begin() + cut, stream.begin() + second_picture);
+    std::vector<uint8_t> truncated(stream.begin(), stream.begin() + cut);
+
+    for (int chunk_size : TEST_CHUNK_SIZES) {
+        auto first = decode(truncated, false, chunk_size);
+        EXPECT_EQ(num_frames, 1);
+        auto both = decode(stream, false, chunk_size);
+        EXPECT_EQ(num_frames, 2);
+        ASSERT_EQ(both.size(), 2 * first.size());
+        EXPECT_TRUE(std::equal(first.begin(), first.end(), both.begin()));
+    }
+}
+
+// Sequences one after another, each ended by its sequence end code: push() decodes all of them, the frames are
+// those of every sequence decoded on its own
+TEST_F(decoder_test_c, push_concatenated_sequences) {
+    std::vector<uint8_t> sequences[2], stream;
+    for (int i = 0; i < 2; i++) {
+        mp2v_stream_writer_c writer(TEST_WIDTH, TEST_HEIGHT, 1729 + i);
+        writer.sequence_header(true);
+        writer.group_of_pictures();
+        for (int j = 0; j < TEST_NUM_FRAMES; j++)
+            writer.intra_frame(j);
+        writer.sequence_end();
+        sequences[i] = writer.get_stream();
+        stream.insert(stream.end(), sequences[i].begin(), sequences[i].end());
+    }
+
+    for (int chunk_size : TEST_CHUNK_SIZES) {
+        std::vector<uint8_t> expected;
+        for (auto& sequence : sequences) {
+            auto output = decode(sequence, false, chunk_size);
+            EXPECT_EQ(num_frames, TEST_NUM_FRAMES);
+            expected.insert(expected.end(), output.begin(), output.end());
+        }
+        auto output = decode(stream, false, chunk_size);
+        EXPECT_EQ(num_frames, 2 * TEST_NUM_FRAMES);
+        EXPECT_TRUE(output == expected);
+    }
+}
@@ -0,0 +1,148 @@
+// Copyright  2021 Vladislav Ovchinnikov. All rights reserved.
+#pragma once
+#include <vector>
+#include <random>
+#include "core/mp2v_hdr.h"
+#include "core/mp2v_vlc.h"
+
+// Writes a 4:2:0 elementary stream of intra pictures, the macroblocks carry random DC differentials and a few
+// escape coded coefficients per block. The syntax is valid, the content is noise.
+class mp2v_stream_writer_c {
+public:
+    mp2v_stream_writer_c(int width, int height, uint32_t seed = 1729) : width(width), height(height), gen(seed) {}
+
+    void put_bits(uint32_t value, int len) {
+        for (int i = len - 1; i >= 0; i--) {
+            bits = (bits << 1) | ((value >> i) & 1);
+            if (++num_bits == 8) {
+                stream.push_back((uint8_t)bits);
+                bits = num_bits = 0;
+            }
+        }
+    }
+
+    void put_vlc(vlc_t vlc) { put_bits(vlc.value, vlc.len); }
+
+    // zero stuffing up to the byte boundary, then the start code
+    void start_code(uint8_t code) {
+        if (num_bits)
+            put_bits(0, 8 - num_bits);
+        for (uint8_t byte : { 0, 0, 1 })
+            stream.push_back(byte);
+        stream.push_back(code);
+    }
+
+    void sequence_header(bool progressive_sequence) {
+        progressive = progressive_sequence;
+        start_code(sequence_header_code);
+        put_bits(width, 12); put_bits(height, 12);
+        put_bits(1, 4);        // aspect_ratio_information
+        put_bits(3, 4);        // frame_rate_code
+        put_bits(0x3ffff, 18); // bit_rate_value
+        put_bits(1, 1);        // marker_bit
+        put_bits(112, 10);     // vbv_buffer_size_value
+        put_bits(0, 3);        // constrained_parameters_flag, load_intra_quantiser_matrix, load_non_intra_quantiser_matrix
+        start_code(extension_start_code);
+        put_bits(sequence_extension_id, 4);
+        put_bits(0x48, 8);     // main profile, main level
+        put_bits(progressive, 1);
+        put_bits(chroma_format_420, 2);
+        put_bits(0, 2 + 2 + 12); // size extensions, bit_rate_extension
+        put_bits(1, 1);        // marker_bit
+        put_bits(0, 8 + 1 + 2 + 5); // vbv_buffer_size_extension, low_delay, frame_rate_extension_n/d
+    }
+
+    void group_of_pictures() {
+        start_code(group_start_code);
+        put_bits(1 << 12, 25); // time_code with its marker bit
+        put_bits(1, 1);        // closed_gop
+        put_bits(0, 1);        // broken_link
+    }
+
+    // A frame picture or the two field pictures of the frame. Field DCT is picked at random in frame pictures
+    // of interlaced sequences.
+    void intra_frame(int temporal_reference, bool field_pictures = false) {
+        if (!field_pictures)
+            intra_picture(temporal_reference, picture_structure_framepic);
+        else {
+            intra_picture(temporal_reference, picture_structure_topfield);
+            intra_picture(temporal_reference, picture_structure_botfield);
+        }
+    }
+
+    void intra_picture(int temporal_reference, uint8_t picture_structure) {
+        start_code(picture_start_code);
+        put_bits(temporal_reference, 10);
+        put_bits(picture_coding_type_intra, 3);
+        put_bits(0xffff, 16); // vbv_delay
+        put_bits(0, 1);       // extra_bit_picture
+        start_code(extension_start_code);
+        put_bits(picture_coding_extension_id, 4);
+        put_bits(0xffff, 16); // f_code
+        put_bits(0, 2);       // intra_dc_precision
+        put_bits(picture_structure, 2);
+        put_bits(1, 1);       // top_field_first
+        bool frame_pred_frame_dct = progressive || (picture_structure != picture_structure_framepic);
+        put_bits(frame_pred_frame_dct, 1);
+        put_bits(0, 4);       // concealment_motion_vectors, q_scale_type, intra_vlc_format, alternate_scan
+        put_bits(0, 1);       // repeat_first_field
+        put_bits(progressive, 1); // chroma_420_type
+        put_bits(progressive, 1); // progressive_frame
+        put_bits(0, 1);       // composite_display_flag
+
+        int mb_rows = (picture_structure == picture_structure_framepic) ? height / 16 : height / 32;
+        for (int row = 0; row < mb_rows; row++) {
+            start_code(slice_start_code_min + row);
+            put_bits(random(1, 31), 5); // quantiser_scale_code
+            put_bits(0, 1);             // extra_bit_slice
+            for (int col = 0; col < width / 16; col++)
+                intra_macroblock(!frame_pred_frame_dct);
+        }
+    }
+
+    void sequence_end() { start_code(sequence_end_code); }
+
+    // Stream so far, zero stuffed to the byte boundary
+    const std::vector<uint8_t>& get_stream() {
+        if (num_bits)
+            put_bits(0, 8 - num_bits);
+        return stream;
+    }
+
+private:
+    int random(int min, int max) { return std::uniform_int_distribution<int>(min, max)(gen); }
+
+    void intra_macroblock(bool dct_type_present) {
+        put_bits(1, 1); // macroblock_address_increment
+        put_bits(1, 1); // macroblock_type, intra
+        if (dct_type_present)
+            put_bits(random(0, 1), 1);
+        for (int i = 0; i < 6; i++)
+            intra_block(i < 4);
+    }
+
+    void intra_block(bool luma) {
+        int dct_dc_size = random(0, 4);
+        put_vlc(luma ? dct_size_luminance_to_vlc[dct_dc_size] : dct_size_chrominance_to_vlc[dct_dc_size]);
+        if (dct_dc_size)
+            put_bits(random(0, (1 << dct_dc_size) - 1), dct_dc_size);
+        for (int n = random(0, 3), pos = 0; n > 0; n--) {
+            int run = random(0, 10);
+            if ((pos += run + 1) > 63)
+                break;
+            int level = random(1, 40) * (random(0, 1) ? 1 : -1);
+            put_bits(0b000001, 6); // escape
+            put_bits(run, 6);
+            put_bits(level & 0xfff, 12);
+        }
+        put_bits(0b10, 2); // end of block
+    }
+
+    int width;
+    int height;
+    bool progressive = true;
+    std::vector<uint8_t> stream;
+    uint32_t bits = 0;
+    int num_bits = 0;
+    std::mt19937 gen;
+};
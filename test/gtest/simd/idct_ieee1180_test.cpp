@@ -0,0 +1,171 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+// unit test common
+#include "test_common.h"
+
+// Tiny MPEG2 IDCT headers
+#include "core/idct_c.hpp"
+#if defined(CPU_PLATFORM_X64)
+#include "core/idct_sse2.hpp"
+#elif defined(CPU_PLATFORM_AARCH64)
+#include "core/idct_aarch64.hpp"
+#endif
+
+// IEEE 1180-1990 accuracy test of the IDCT: random blocks of 10000 in each of three pixel ranges and both signs
+// go through a double precision forward DCT, the IDCT under test and the double precision reference IDCT.
+constexpr int IEEE1180_NUM_BLOCKS = 10000;
+constexpr int IEEE1180_PEAK_ERROR = 1;
+constexpr double IEEE1180_PEAK_MSE = 0.06;   // worst pixel position
+constexpr double IEEE1180_OVERALL_MSE = 0.02;
+constexpr double IEEE1180_PEAK_ME = 0.015;   // worst pixel position, absolute
+constexpr double IEEE1180_OVERALL_ME = 0.0015;
+
+typedef void (*idct_func_t)(uint8_t* plane, int16_t F[64], int stride);
+
+struct ieee1180_stats_t {
+    int peak_error;
+    double peak_mse;
+    double overall_mse;
+    double peak_me;
+    double overall_me;
+};
+
+class ieee1180_idct_test_c : public ::testing::Test {
+public:
+    ieee1180_idct_test_c() {
+        for (int k = 0; k < 8; k++)
+            for (int n = 0; n < 8; n++)
+                c[k][n] = (k ? 0.5 : sqrt(0.125)) * cos(M_PI * k * (2 * n + 1) / 16.0);
+    }
+
+    // The random generator of the standard, in unsigned 32 bit arithmetic: only the low 31 bits are used and they
+    // don't depend on the width, while a signed overflow would be undefined
+    long ieee_rand(long L, long H) {
+        randx = (randx * 1103515245u) + 12345u;
+        double x = (double)(randx & 0x7ffffffe) / (double)0x7fffffff;
+        return (long)(x * (L + H + 1)) - L;
+    }
+
+    // Separable transforms on rows of x/u, rounded to integers. Both are precise enough for the test.
+    void forward_dct(const int in[64], int out[64]) {
+        double tmp[64];
+        for (int x = 0; x < 8; x++)
+            for (int v = 0; v < 8; v++) {
+                double s = 0.0;
+                for (int y = 0; y < 8; y++)
+                    s += c[v][y] * in[x * 8 + y];
+                tmp[x * 8 + v] = s;
+            }
+        for (int u = 0; u < 8; u++)
+            for (int v = 0; v < 8; v++) {
+                double s = 0.0;
+                for (int x = 0; x < 8; x++)
+                    s += c[u][x] * tmp[x * 8 + v];
+                out[u * 8 + v] = std::max(std::min((int)floor(s + 0.5), 2047), -2048);
+            }
+    }
+
+    // The standard clips to [-256, 255], -256 can't be read back from a plane (see run_idct())
+    void reference_idct(const int in[64], int out[64]) {
+        double tmp[64];
+        for (int u = 0; u < 8; u++)
+            for (int y = 0; y < 8; y++) {
+                double s = 0.0;
+                for (int v = 0; v < 8; v++)
+                    s += c[v][y] * in[u * 8 + v];
+                tmp[u * 8 + y] = s;
+            }
+        for (int x = 0; x < 8; x++)
+            for (int y = 0; y < 8; y++) {
+                double s = 0.0;
+                for (int u = 0; u < 8; u++)
+                    s += c[u][x] * tmp[u * 8 + y];
+                out[x * 8 + y] = std::max(std::min((int)floor(s + 0.5), 255), -255);
+            }
+    }
+
+    // The kernels take F transposed (g_scan_trans) and output to a plane, the residual is read back as
+    // the positive part written over zeros and the negative part added to 255s
+    void run_idct(idct_func_t func_mov, idct_func_t func_add, const int in[64], int out[64]) {
+        ALIGN(32) int16_t F[64];
+        ALIGN(32) uint8_t pos[64], neg[64];
+        for (int u = 0; u < 8; u++)
+            for (int v = 0; v < 8; v++)
+                F[v * 8 + u] = (int16_t)in[u * 8 + v];
+        std::fill(pos, pos + 64, 0);
+        std::fill(neg, neg + 64, 255);
+        func_mov(pos, F, 8);
+        func_add(neg, F, 8);
+        for (int i = 0; i < 64; i++)
+            out[i] = pos[i] ? pos[i] : neg[i] - 255;
+    }
+
+    ieee1180_stats_t measure(idct_func_t func_mov, idct_func_t func_add, int L, int H, int sign) {
+        double me[64] = { 0 }, mse[64] = { 0 };
+        ieee1180_stats_t stats = { 0, 0.0, 0.0, 0.0, 0.0 };
+        randx = 1;
+        for (int n = 0; n < IEEE1180_NUM_BLOCKS; n++) {
+            int block[64], coeffs[64], ref[64], res[64];
+            for (int i = 0; i < 64; i++)
+                block[i] = sign * (int)ieee_rand(L, H);
+            forward_dct(block, coeffs);
+            reference_idct(coeffs, ref);
+            run_idct(func_mov, func_add, coeffs, res);
+            for (int i = 0; i < 64; i++) {
+                int err = res[i] - ref[i];
+                stats.peak_error = std::max(stats.peak_error, abs(err));
+                me[i] += err;
+                mse[i] += err * err;
+            }
+        }
+        for (int i = 0; i < 64; i++) {
+            me[i] /= IEEE1180_NUM_BLOCKS;
+            mse[i] /= IEEE1180_NUM_BLOCKS;
+            stats.peak_me = std::max(stats.peak_me, fabs(me[i]));
+            stats.peak_mse = std::max(stats.peak_mse, mse[i]);
+            stats.overall_me += me[i] / 64;
+            stats.overall_mse += mse[i] / 64;
+        }
+        stats.overall_me = fabs(stats.overall_me);
+        return stats;
+    }
+
+    // All six runs, the figures are printed either way. Returns false if any limit is exceeded.
+    bool test_ieee1180(idct_func_t func_mov, idct_func_t func_add) {
+        const int L[3] = { 256, 5, 300 }, H[3] = { 255, 5, 300 };
+        bool conforms = true;
+        for (int range = 0; range < 3; range++)
+            for (int sign = 1; sign >= -1; sign -= 2) {
+                ieee1180_stats_t s = measure(func_mov, func_add, L[range], H[range], sign);
+                bool ok = s.peak_error <= IEEE1180_PEAK_ERROR && s.peak_mse <= IEEE1180_PEAK_MSE && s.overall_mse <= IEEE1180_OVERALL_MSE &&
+                    s.peak_me <= IEEE1180_PEAK_ME && s.overall_me <= IEEE1180_OVERALL_ME;
+                testing::internal::ColoredPrintf(testing::internal::COLOR_DEFAULT, "[-%3d, %3d] x %+d: ", L[range], H[range], sign);
+                testing::internal::ColoredPrintf(ok ? testing::internal::COLOR_GREEN : testing::internal::COLOR_YELLOW,
+                    "peak %d, pmse %.4f, omse %.4f, pme %.4f, ome %.5f\n", s.peak_error, s.peak_mse, s.overall_mse, s.peak_me, s.overall_me);
+                conforms = conforms && ok;
+            }
+
+        int zero[64] = { 0 }, res[64];
+        run_idct(func_mov, func_add, zero, res);
+        for (int i = 0; i < 64; i++)
+            conforms = conforms && !res[i];
+        return conforms;
+    }
+
+protected:
+    double c[8][8]; // DCT basis
+    uint32_t randx = 1;
+};
+
+TEST_F(ieee1180_idct_test_c, ieee1180_idct_c) { EXPECT_TRUE(test_ieee1180(inverse_dct_template_c<false>, inverse_dct_template_c<true>)); }
+
+// The fast kernels are only characterised, they don't meet the limits
+#if defined(CPU_PLATFORM_X64)
+TEST_F(ieee1180_idct_test_c, ieee1180_idct_conformant_sse2) { EXPECT_TRUE(test_ieee1180(inverse_dct_template_conformant<false>, inverse_dct_template_conformant<true>)); }
+TEST_F(ieee1180_idct_test_c, characterisation_idct_sse2) { test_ieee1180(inverse_dct_template<false>, inverse_dct_template<true>); }
+#elif defined(CPU_PLATFORM_AARCH64)
+TEST_F(ieee1180_idct_test_c, characterisation_idct_aarch64) { test_ieee1180(inverse_dct_template<false>, inverse_dct_template<true>); }
+#endif
@@ -4,14 +4,17 @@
 #include <algorithm>
 #include <iterator>
 #include <chrono>
+#include <cmath>
 
 // unit test common
 #include "test_common.h"
 
 // Tiny MPEG2 MC headers
 #include "core/idct_ref.hpp"
+#include "core/idct_c.hpp"
 #if defined(CPU_PLATFORM_X64)
 #include "core/idct_sse2.hpp"
+#include "core/idct_avx2.hpp"
 #elif defined(CPU_PLATFORM_AARCH64)
 #include "core/idct_aarch64.hpp"
 #endif
@@ -22,9 +25,18 @@ constexpr int IDCT_PLANE_SIZE = 8;
 constexpr int IDCT_PLANE_STRIDE = 32;
 constexpr int IDCT_PIXEL_MIN_VALUE = -255;
 constexpr int IDCT_PIXEL_MAX_VALUE = 255;
+constexpr int IDCT_COEFF_MIN_VALUE = -2048;
+constexpr int IDCT_COEFF_MAX_VALUE = 2047;
+constexpr int IDCT_NUM_SPARSE_BLOCKS = 10000;
+constexpr int IDCT_NUM_BLOCKS = 10000;
+constexpr int IDCT_NUM_BLOCK_PAIRS = 10000;
+constexpr int IDCT_NUM_BLOCK_PAIRS_PERFORMANCE = 64;
+constexpr int IDCT_REF_COEFF_RANGE = 128; // idct_ref.hpp wraps around in 16 bits on dense blocks above that, the SIMD kernels saturate
+constexpr int IDCT_REF_TOLERANCE = 3;   // rounding of the mulhi based constants
 constexpr int IDCT_RANDOM_SEED = 1729;
 
 typedef void (*idct_func_t)(uint8_t* plane, int16_t F[64], int stride);
+typedef void (*idct_x2_func_t)(uint8_t* plane0, uint8_t* plane1, int16_t F0[64], int16_t F1[64], int stride);
 
 class simd_idct_test_c : public ::testing::Test {
 public:
@@ -50,6 +62,128 @@ public:
         return true;
     }
 
+    // Random blocks through kernels of different precision, pixels may differ by tolerance
+    bool test_idct_accuracy(idct_func_t func_ref, idct_func_t func, int coeff_range, int tolerance) {
+        std::uniform_int_distribution<int> coeff_gen(-coeff_range, coeff_range - 1);
+        std::uniform_int_distribution<int> pixel_gen(0, IDCT_PIXEL_MAX_VALUE);
+        for (int step = 0; step < IDCT_NUM_BLOCKS; step++) {
+            for (auto& val : src_plane)
+                val = (gen() & 1) ? coeff_gen(gen) : 0;
+            for (auto& val : dst_plane_ref)
+                val = pixel_gen(gen);
+            dst_plane = dst_plane_ref;
+            func_ref(&dst_plane_ref[0], src_plane, IDCT_PLANE_STRIDE);
+            func(&dst_plane[0], src_plane, IDCT_PLANE_STRIDE);
+            for (size_t i = 0; i < dst_plane.size(); i++)
+                if (std::abs((int)dst_plane[i] - (int)dst_plane_ref[i]) > tolerance)
+                    return false;
+        }
+        return true;
+    }
+
+    // Sparse kernels against the full one on blocks with coefficients in the top left size x size corner only,
+    // with ignores_mismatch_bit every other block also carries the F[7][7] = 1 of mismatch control
+    bool test_sparse_idct(idct_func_t func_full, idct_func_t func_sparse, int size, bool ignores_mismatch_bit) {
+        std::uniform_int_distribution<int> coeff_gen(IDCT_COEFF_MIN_VALUE, IDCT_COEFF_MAX_VALUE);
+        std::uniform_int_distribution<int> pixel_gen(0, IDCT_PIXEL_MAX_VALUE);
+        for (int step = 0; step < IDCT_NUM_SPARSE_BLOCKS; step++) {
+            std::fill(std::begin(src_plane), std::end(src_plane), 0);
+            for (int i = 0; i < size; i++)
+                for (int j = 0; j < size; j++)
+                    src_plane[i * 8 + j] = (gen() & 1) ? coeff_gen(gen) : 0;
+            for (auto& val : dst_plane_ref)
+                val = pixel_gen(gen);
+            dst_plane = dst_plane_ref;
+            func_sparse(&dst_plane[0], src_plane, IDCT_PLANE_STRIDE);
+            if (ignores_mismatch_bit && (step & 1))
+                src_plane[63] = 1;
+            func_full(&dst_plane_ref[0], src_plane, IDCT_PLANE_STRIDE);
+            if (dst_plane != dst_plane_ref)
+                return false;
+        }
+        return true;
+    }
+
+    // Blocks at the limits of the coefficient range: all coefficients 2047 or -2048 with the signs of the basis
+    // function of one output pixel or their negation, which drive that pixel and the intermediates of both
+    // passes to their extremes. A 32 bit overflow there is undefined behaviour in the C kernel, build with
+    // -fsanitize=undefined -fno-sanitize-recover to trap it.
+    bool test_idct_extreme(idct_func_t func_ref, idct_func_t func) {
+        std::uniform_int_distribution<int> pixel_gen(0, IDCT_PIXEL_MAX_VALUE);
+        for (int pattern = 0; pattern < 2 * 64 + 2; pattern++) {
+            for (int v = 0; v < 8; v++)
+                for (int u = 0; u < 8; u++) {
+                    const double pi = 3.14159265358979323846;
+                    int x = (pattern >> 1) & 7, y = (pattern >> 4) & 7; // pattern 128, 129: all positive, all negative
+                    bool positive = (pattern >= 128) || (std::cos((2 * x + 1) * u * pi / 16) * std::cos((2 * y + 1) * v * pi / 16) > 0);
+                    src_plane[v * 8 + u] = (positive != (pattern & 1)) ? IDCT_COEFF_MAX_VALUE : IDCT_COEFF_MIN_VALUE;
+                }
+            for (auto& val : dst_plane_ref)
+                val = pixel_gen(gen);
+            dst_plane = dst_plane_ref;
+            func_ref(&dst_plane_ref[0], src_plane, IDCT_PLANE_STRIDE);
+            func(&dst_plane[0], src_plane, IDCT_PLANE_STRIDE);
+            if (dst_plane != dst_plane_ref)
+                return false;
+        }
+        return true;
+    }
+
+    void generate_block_pair(int16_t (&pair)[2][64], int coeff_range) {
+        std::uniform_int_distribution<int> coeff_gen(-coeff_range, coeff_range - 1);
+        for (auto& block : pair)
+            for (auto& val : block)
+                val = (gen() & 1) ? coeff_gen(gen) : 0;
+    }
+
+    // Two blocks side by side as the left and right luma blocks of a macroblock, the pair kernel against
+    // two calls of the single block one
+    bool test_idct_x2(idct_func_t func, idct_x2_func_t func_x2, int coeff_range, int tolerance) {
+        std::uniform_int_distribution<int> pixel_gen(0, IDCT_PIXEL_MAX_VALUE);
+        for (int step = 0; step < IDCT_NUM_BLOCK_PAIRS; step++) {
+            ALIGN(32) int16_t pair[2][64];
+            generate_block_pair(pair, coeff_range);
+            for (auto& val : dst_plane_ref)
+                val = pixel_gen(gen);
+            dst_plane = dst_plane_ref;
+            func(&dst_plane_ref[0], pair[0], IDCT_PLANE_STRIDE);
+            func(&dst_plane_ref[8], pair[1], IDCT_PLANE_STRIDE);
+            func_x2(&dst_plane[0], &dst_plane[8], pair[0], pair[1], IDCT_PLANE_STRIDE);
+            for (size_t i = 0; i < dst_plane.size(); i++)
+                if (std::abs((int)dst_plane[i] - (int)dst_plane_ref[i]) > tolerance)
+                    return false;
+        }
+        return true;
+    }
+
+    bool test_idct_x2_performance(idct_func_t func, idct_x2_func_t func_x2, const char* name_func, const char* name_func_x2) {
+        std::vector<int16_t, AlignmentAllocator<int16_t, 32>> blocks(IDCT_NUM_BLOCK_PAIRS_PERFORMANCE * 2 * 64);
+        for (int i = 0; i < IDCT_NUM_BLOCK_PAIRS_PERFORMANCE; i++)
+            generate_block_pair(*(int16_t(*)[2][64])&blocks[i * 2 * 64], IDCT_COEFF_MAX_VALUE + 1);
+        std::vector<uint8_t, AlignmentAllocator<uint8_t, 32>> plane_ref = dst_plane;
+
+        const auto start = std::chrono::system_clock::now();
+        for (int step = 0; step < TEST_NUM_ITERATIONS_PERFORMANCE; step++)
+            for (int i = 0; i < IDCT_NUM_BLOCK_PAIRS_PERFORMANCE; i++) {
+                func(&plane_ref[0], &blocks[i * 2 * 64], IDCT_PLANE_STRIDE);
+                func(&plane_ref[8], &blocks[i * 2 * 64 + 64], IDCT_PLANE_STRIDE);
+            }
+        const auto middle = std::chrono::system_clock::now();
+        for (int step = 0; step < TEST_NUM_ITERATIONS_PERFORMANCE; step++)
+            for (int i = 0; i < IDCT_NUM_BLOCK_PAIRS_PERFORMANCE; i++)
+                func_x2(&dst_plane[0], &dst_plane[8], &blocks[i * 2 * 64], &blocks[i * 2 * 64 + 64], IDCT_PLANE_STRIDE);
+        const auto end = std::chrono::system_clock::now();
+
+        const double num_blocks = 2.0 * IDCT_NUM_BLOCK_PAIRS_PERFORMANCE * TEST_NUM_ITERATIONS_PERFORMANCE;
+        const auto elapsed_func_us = std::chrono::duration_cast<std::chrono::microseconds>(middle - start).count();
+        const auto elapsed_func_x2_us = std::chrono::duration_cast<std::chrono::microseconds>(end - middle).count();
+        testing::internal::ColoredPrintf(testing::internal::COLOR_DEFAULT, "%24s: ", name_func);
+        testing::internal::ColoredPrintf(testing::internal::COLOR_YELLOW, "%8.2f Mblocks/s\n", num_blocks / std::max<double>(1.0, (double)elapsed_func_us));
+        testing::internal::ColoredPrintf(testing::internal::COLOR_DEFAULT, "%24s: ", name_func_x2);
+        testing::internal::ColoredPrintf(testing::internal::COLOR_GREEN, "%8.2f Mblocks/s\n", num_blocks / std::max<double>(1.0, (double)elapsed_func_x2_us));
+        return plane_ref == dst_plane;
+    }
+
     void generate_sources() {
         std::uniform_int_distribution<int16_t> uniform_gen(0, IDCT_PIXEL_MAX_VALUE);
         for (auto& val : src_plane)
@@ -65,10 +199,47 @@ protected:
 
 #define TEST_IDCT_ROUTINES(simd) \
 TEST_F(simd_idct_test_c, validation_idct_add_##simd) { EXPECT_TRUE(test_idct(inverse_dct_template_ref<true>,  inverse_dct_template<true> )); } \
-TEST_F(simd_idct_test_c, validation_idct_mov_##simd) { EXPECT_TRUE(test_idct(inverse_dct_template_ref<false>, inverse_dct_template<false>)); }
+TEST_F(simd_idct_test_c, validation_idct_mov_##simd) { EXPECT_TRUE(test_idct(inverse_dct_template_ref<false>, inverse_dct_template<false>)); } \
+TEST_F(simd_idct_test_c, validation_idct_dc_add_##simd)  { EXPECT_TRUE(test_sparse_idct(inverse_dct_template<true>,  inverse_dct_dc_template<true>,  1, IDCT_IGNORES_MISMATCH_BIT)); } \
+TEST_F(simd_idct_test_c, validation_idct_dc_mov_##simd)  { EXPECT_TRUE(test_sparse_idct(inverse_dct_template<false>, inverse_dct_dc_template<false>, 1, IDCT_IGNORES_MISMATCH_BIT)); } \
+TEST_F(simd_idct_test_c, validation_idct_4x4_add_##simd) { EXPECT_TRUE(test_sparse_idct(inverse_dct_template<true>,  inverse_dct_4x4_template<true>,  4, IDCT_IGNORES_MISMATCH_BIT)); } \
+TEST_F(simd_idct_test_c, validation_idct_4x4_mov_##simd) { EXPECT_TRUE(test_sparse_idct(inverse_dct_template<false>, inverse_dct_4x4_template<false>, 4, IDCT_IGNORES_MISMATCH_BIT)); }
+
+// Integer C kernels: the full one within rounding of the 16 bit model, the sparse ones exact against the full one
+TEST_F(simd_idct_test_c, validation_idct_add_c) { EXPECT_TRUE(test_idct_accuracy(inverse_dct_template_ref<true>,  inverse_dct_template_c<true>,  IDCT_REF_COEFF_RANGE, IDCT_REF_TOLERANCE)); }
+TEST_F(simd_idct_test_c, validation_idct_mov_c) { EXPECT_TRUE(test_idct_accuracy(inverse_dct_template_ref<false>, inverse_dct_template_c<false>, IDCT_REF_COEFF_RANGE, IDCT_REF_TOLERANCE)); }
+TEST_F(simd_idct_test_c, validation_idct_dc_add_c)  { EXPECT_TRUE(test_sparse_idct(inverse_dct_template_c<true>,  inverse_dct_dc_template_c<true>,  1, IDCT_C_IGNORES_MISMATCH_BIT)); }
+TEST_F(simd_idct_test_c, validation_idct_dc_mov_c)  { EXPECT_TRUE(test_sparse_idct(inverse_dct_template_c<false>, inverse_dct_dc_template_c<false>, 1, IDCT_C_IGNORES_MISMATCH_BIT)); }
+TEST_F(simd_idct_test_c, validation_idct_4x4_add_c) { EXPECT_TRUE(test_sparse_idct(inverse_dct_template_c<true>,  inverse_dct_4x4_template_c<true>,  4, IDCT_C_IGNORES_MISMATCH_BIT)); }
+TEST_F(simd_idct_test_c, validation_idct_4x4_mov_c) { EXPECT_TRUE(test_sparse_idct(inverse_dct_template_c<false>, inverse_dct_4x4_template_c<false>, 4, IDCT_C_IGNORES_MISMATCH_BIT)); }
 
 #if defined(CPU_PLATFORM_X64)
 TEST_IDCT_ROUTINES(sse2);
+
+// conformant kernels are bit-exact with the C one over the whole coefficient range
+TEST_F(simd_idct_test_c, validation_idct_conformant_add_sse2) { EXPECT_TRUE(test_idct_accuracy(inverse_dct_template_c<true>,  inverse_dct_template_conformant<true>,  IDCT_COEFF_MAX_VALUE + 1, 0)); }
+TEST_F(simd_idct_test_c, validation_idct_conformant_mov_sse2) { EXPECT_TRUE(test_idct_accuracy(inverse_dct_template_c<false>, inverse_dct_template_conformant<false>, IDCT_COEFF_MAX_VALUE + 1, 0)); }
+TEST_F(simd_idct_test_c, validation_idct_conformant_extreme_add_sse2) { EXPECT_TRUE(test_idct_extreme(inverse_dct_template_c<true>,  inverse_dct_template_conformant<true> )); }
+TEST_F(simd_idct_test_c, validation_idct_conformant_extreme_mov_sse2) { EXPECT_TRUE(test_idct_extreme(inverse_dct_template_c<false>, inverse_dct_template_conformant<false>)); }
+TEST_F(simd_idct_test_c, validation_idct_conformant_dc_add_sse2) { EXPECT_TRUE(test_sparse_idct(inverse_dct_template_c<true>,  inverse_dct_dc_template_conformant<true>,  1, IDCT_C_IGNORES_MISMATCH_BIT)); }
+TEST_F(simd_idct_test_c, validation_idct_conformant_dc_mov_sse2) { EXPECT_TRUE(test_sparse_idct(inverse_dct_template_c<false>, inverse_dct_dc_template_conformant<false>, 1, IDCT_C_IGNORES_MISMATCH_BIT)); }
+TEST_F(simd_idct_test_c, validation_idct_conformant_4x4_add_sse2) { EXPECT_TRUE(test_sparse_idct(inverse_dct_template_c<true>,  inverse_dct_4x4_template_conformant<true>,  4, IDCT_C_IGNORES_MISMATCH_BIT)); }
+TEST_F(simd_idct_test_c, validation_idct_conformant_4x4_mov_sse2) { EXPECT_TRUE(test_sparse_idct(inverse_dct_template_c<false>, inverse_dct_4x4_template_conformant<false>, 4, IDCT_C_IGNORES_MISMATCH_BIT)); }
+
+#define TEST_IDCT_X2_ROUTINE(test_case, func, add, coeff_range, tolerance) \
+TEST_F(simd_idct_test_c, test_case##_avx2) { \
+    if (!cpu_support_avx2()) GTEST_SKIP(); \
+    EXPECT_TRUE(test_idct_x2(func<add>, inverse_dct_x2_template<add>, coeff_range, tolerance)); }
+
+TEST_IDCT_X2_ROUTINE(validation_idct_x2_add,     inverse_dct_template,     true,  IDCT_COEFF_MAX_VALUE + 1, 0)
+TEST_IDCT_X2_ROUTINE(validation_idct_x2_mov,     inverse_dct_template,     false, IDCT_COEFF_MAX_VALUE + 1, 0)
+TEST_IDCT_X2_ROUTINE(validation_idct_x2_ref_add, inverse_dct_template_ref, true,  IDCT_REF_COEFF_RANGE, IDCT_REF_TOLERANCE)
+TEST_IDCT_X2_ROUTINE(validation_idct_x2_ref_mov, inverse_dct_template_ref, false, IDCT_REF_COEFF_RANGE, IDCT_REF_TOLERANCE)
+
+TEST_F(simd_idct_test_c, performance_idct_x2_avx2) {
+    if (!cpu_support_avx2()) GTEST_SKIP();
+    EXPECT_TRUE(test_idct_x2_performance(inverse_dct_template<true>, inverse_dct_x2_template<true>, "inverse_dct_sse2 x 2", "inverse_dct_x2_avx2"));
+}
 #elif defined(CPU_PLATFORM_AARCH64)
 TEST_IDCT_ROUTINES(aarch64);
 #endif
@@ -0,0 +1,58 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#include <random>
+#include <string.h>
+
+// unit test common
+#include "test_common.h"
+
+// Tiny MPEG2 inverse quantisation headers
+#include "core/iquant_c.hpp"
+#if defined(CPU_PLATFORM_X64)
+#include "core/iquant_sse2.hpp"
+#endif
+
+constexpr int IQUANT_NUM_BLOCKS = 10000;
+constexpr int IQUANT_LEVEL_MAX_VALUE = 2048; // escape levels
+constexpr int IQUANT_WQ_MAX_VALUE = 255 * 112; // W * quantiser_scale
+constexpr int IQUANT_RANDOM_SEED = 1729;
+
+typedef int (*iquant_func_t)(int16_t* dst, const int16_t* levels, const uint8_t* idx, const uint16_t WQ[64], int num);
+
+class simd_iquant_test_c : public ::testing::Test {
+public:
+    // Blocks of any number of levels, mostly small ones like VLC codes carry and some escapes of any size
+    bool test_iquant(iquant_func_t func_ref, iquant_func_t func_simd) {
+        std::uniform_int_distribution<int> num_gen(0, 64);
+        std::uniform_int_distribution<int> small_gen(-8, 8);
+        std::uniform_int_distribution<int> escape_gen(-IQUANT_LEVEL_MAX_VALUE, IQUANT_LEVEL_MAX_VALUE - 1);
+        std::uniform_int_distribution<int> idx_gen(0, 63);
+        std::uniform_int_distribution<int> wq_gen(1, IQUANT_WQ_MAX_VALUE);
+        for (int step = 0; step < IQUANT_NUM_BLOCKS; step++) {
+            ALIGN(16) int16_t levels[64 + 8] = { 0 };
+            ALIGN(16) int16_t dst[64 + 8], dst_ref[64 + 8];
+            uint8_t idx[64 + 8] = { 0 };
+            uint16_t WQ[64];
+            int num = num_gen(gen);
+            for (int k = 0; k < num; k++) {
+                int level = (gen() & 7) ? small_gen(gen) : escape_gen(gen);
+                levels[k] = (int16_t)(level ? level : 1);
+                idx[k] = (uint8_t)idx_gen(gen);
+            }
+            for (auto& wq : WQ)
+                wq = (uint16_t)wq_gen(gen);
+            int parity_ref = func_ref(dst_ref, levels, idx, WQ, num);
+            int parity = func_simd(dst, levels, idx, WQ, num);
+            if (parity != parity_ref || memcmp(dst, dst_ref, num * sizeof(dst[0])))
+                return false;
+        }
+        return true;
+    }
+
+protected:
+    std::mt19937 gen{ IQUANT_RANDOM_SEED };
+};
+
+#if defined(CPU_PLATFORM_X64)
+TEST_F(simd_iquant_test_c, validation_iquant_intra_sse2)     { EXPECT_TRUE(test_iquant(inverse_quant_template_c<true>,  inverse_quant_template<true>)); }
+TEST_F(simd_iquant_test_c, validation_iquant_non_intra_sse2) { EXPECT_TRUE(test_iquant(inverse_quant_template_c<false>, inverse_quant_template<false>)); }
+#endif
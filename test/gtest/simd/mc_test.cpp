@@ -1,4 +1,5 @@
 // Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#include <string.h>
 #include <vector>
 #include <random>
 #include <algorithm>
@@ -13,15 +14,19 @@
 #include "core/mc_c.hpp"
 #if defined(CPU_PLATFORM_X64)
 #include "core/mc_sse2.hpp"
+#include "core/mc_avx2.hpp"
+#include "core/mc_idct_sse2.hpp"
 #elif defined(CPU_PLATFORM_AARCH64)
 #include "core/mc_aarch64.hpp"
 #endif
 
 constexpr int TEST_NUM_ITERATIONS = 10;
 constexpr int TEST_NUM_ITERATIONS_PERFORMANCE = 10000;
+constexpr int TEST_NUM_ITERATIONS_THROUGHPUT = 1000000;
 constexpr int MC_PLANE_SIZE = 16;
 constexpr int MC_PLANE_STRIDE = 32;
 constexpr int MC_PIXEL_MAX_VALUE = 255;
+constexpr int MC_IDCT_COEFF_MAX_VALUE = 256;
 constexpr int MC_RANDOM_SEED = 1729;
 
 #define OJECT_NAME(obj) std::string(#obj)
@@ -109,6 +114,65 @@ public:
         return perf_inc > 25.0f;
     }
 
+    // Compares two SIMD levels, whose difference is too small for the short runs above, the first calls
+    // also warm up the wider units
+    template<typename func_t>
+    bool test_mc_pred_throughput(func_t func_ref, func_t func_simd, const char* name_func_ref, const char* name_func_simd) {
+        generate_sources(std::is_same<func_t, mc_bidir_func_t>::value);
+        for (int step = 0; step < TEST_NUM_ITERATIONS_PERFORMANCE; step++) {
+            call_mc_routine(&dst_plane_ref[0], func_ref);
+            call_mc_routine(&dst_plane[0], func_simd);
+        }
+        const auto start = std::chrono::system_clock::now();
+        for (int step = 0; step < TEST_NUM_ITERATIONS_THROUGHPUT; step++)
+            call_mc_routine(&dst_plane_ref[0], func_ref);
+        const auto middle = std::chrono::system_clock::now();
+        for (int step = 0; step < TEST_NUM_ITERATIONS_THROUGHPUT; step++)
+            call_mc_routine(&dst_plane[0], func_simd);
+        const auto end = std::chrono::system_clock::now();
+
+        const auto elapsed_func_ref_us = std::chrono::duration_cast<std::chrono::microseconds>(middle - start).count();
+        const auto elapsed_func_simd_us = std::chrono::duration_cast<std::chrono::microseconds>(end - middle).count();
+        testing::internal::ColoredPrintf(testing::internal::COLOR_DEFAULT, "%24s: ", name_func_ref);
+        testing::internal::ColoredPrintf(testing::internal::COLOR_YELLOW, "%8.2f Mblocks/s\n", TEST_NUM_ITERATIONS_THROUGHPUT / std::max<double>(1.0, (double)elapsed_func_ref_us));
+        testing::internal::ColoredPrintf(testing::internal::COLOR_DEFAULT, "%24s: ", name_func_simd);
+        testing::internal::ColoredPrintf(testing::internal::COLOR_GREEN, "%8.2f Mblocks/s\n", TEST_NUM_ITERATIONS_THROUGHPUT / std::max<double>(1.0, (double)elapsed_func_simd_us));
+        return dst_plane == dst_plane_ref;
+    }
+
+    // Fused kernels against the MC kernels followed by the in place IDCT they stand for
+    bool test_mc_idct(mc_pred_func_t (&mc_pred)[4], mc_bidir_func_t (&mc_bidir)[16], mc_pred_idct_func_t (&mc_pred_idct)[4], mc_bidir_idct_func_t (&mc_bidir_idct)[16],
+                      void (*idct)(uint8_t* plane, int16_t F[64], int stride), int coeffs_size) {
+        std::uniform_int_distribution<int> coeff_gen(-MC_IDCT_COEFF_MAX_VALUE, MC_IDCT_COEFF_MAX_VALUE - 1);
+        for (int step = 0; step < TEST_NUM_ITERATIONS; step++) {
+            ALIGN(32) int16_t F[64] = { 0 };
+            ALIGN(32) int16_t F_tmp[64];
+            for (int i = 0; i < coeffs_size; i++)
+                for (int j = 0; j < coeffs_size; j++)
+                    F[i * 8 + j] = (int16_t)coeff_gen(gen);
+            generate_sources(true);
+            for (int idx = 0; idx < 4; idx++) {
+                mc_pred[idx](&dst_plane_ref[0], &src_plane_L0[0], MC_PLANE_STRIDE, 8);
+                memcpy(F_tmp, F, sizeof(F));
+                idct(&dst_plane_ref[0], F_tmp, MC_PLANE_STRIDE);
+                memcpy(F_tmp, F, sizeof(F));
+                mc_pred_idct[idx](&dst_plane[0], &src_plane_L0[0], F_tmp, MC_PLANE_STRIDE);
+                if (dst_plane != dst_plane_ref)
+                    return false;
+            }
+            for (int idx = 0; idx < 16; idx++) {
+                mc_bidir[idx](&dst_plane_ref[0], &src_plane_L0[0], &src_plane_L1[0], MC_PLANE_STRIDE, 8);
+                memcpy(F_tmp, F, sizeof(F));
+                idct(&dst_plane_ref[0], F_tmp, MC_PLANE_STRIDE);
+                memcpy(F_tmp, F, sizeof(F));
+                mc_bidir_idct[idx](&dst_plane[0], &src_plane_L0[0], &src_plane_L1[0], F_tmp, MC_PLANE_STRIDE);
+                if (dst_plane != dst_plane_ref)
+                    return false;
+            }
+        }
+        return true;
+    }
+
 protected:
     std::vector<uint8_t> src_plane_L0; // unaligned
     std::vector<uint8_t> src_plane_L1; // unaligned
@@ -159,9 +223,50 @@ TEST_F(simd_mc_test_c, test_case##_bidir1101_8xh_##simd)  { EXPECT_TRUE(test_fun
 TEST_F(simd_mc_test_c, test_case##_bidir1110_8xh_##simd)  { EXPECT_TRUE(test_func(mc_bidir1110_8xh_##plane_c,  mc_bidir1110_8xh_##simd,  "mc_bidir1110_8xh_" #plane_c , "mc_bidir1110_8xh_" #simd )); } \
 TEST_F(simd_mc_test_c, test_case##_bidir1111_8xh_##simd)  { EXPECT_TRUE(test_func(mc_bidir1111_8xh_##plane_c,  mc_bidir1111_8xh_##simd,  "mc_bidir1111_8xh_" #plane_c , "mc_bidir1111_8xh_" #simd )); }
 
+// 16 wide kernels only, skipped where the CPU lacks the level
+#define TEST_MC_16XH_ROUTINES(test_case, test_func, plane_ref, simd) \
+TEST_F(simd_mc_test_c, test_case##_pred00_16xh_##simd){ if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_pred00_16xh_##plane_ref, mc_pred00_16xh_##simd, "mc_pred00_16xh_" #plane_ref, "mc_pred00_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_pred01_16xh_##simd){ if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_pred01_16xh_##plane_ref, mc_pred01_16xh_##simd, "mc_pred01_16xh_" #plane_ref, "mc_pred01_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_pred10_16xh_##simd){ if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_pred10_16xh_##plane_ref, mc_pred10_16xh_##simd, "mc_pred10_16xh_" #plane_ref, "mc_pred10_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_pred11_16xh_##simd){ if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_pred11_16xh_##plane_ref, mc_pred11_16xh_##simd, "mc_pred11_16xh_" #plane_ref, "mc_pred11_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir0000_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir0000_16xh_##plane_ref, mc_bidir0000_16xh_##simd, "mc_bidir0000_16xh_" #plane_ref, "mc_bidir0000_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir0001_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir0001_16xh_##plane_ref, mc_bidir0001_16xh_##simd, "mc_bidir0001_16xh_" #plane_ref, "mc_bidir0001_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir0010_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir0010_16xh_##plane_ref, mc_bidir0010_16xh_##simd, "mc_bidir0010_16xh_" #plane_ref, "mc_bidir0010_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir0011_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir0011_16xh_##plane_ref, mc_bidir0011_16xh_##simd, "mc_bidir0011_16xh_" #plane_ref, "mc_bidir0011_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir0100_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir0100_16xh_##plane_ref, mc_bidir0100_16xh_##simd, "mc_bidir0100_16xh_" #plane_ref, "mc_bidir0100_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir0101_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir0101_16xh_##plane_ref, mc_bidir0101_16xh_##simd, "mc_bidir0101_16xh_" #plane_ref, "mc_bidir0101_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir0110_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir0110_16xh_##plane_ref, mc_bidir0110_16xh_##simd, "mc_bidir0110_16xh_" #plane_ref, "mc_bidir0110_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir0111_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir0111_16xh_##plane_ref, mc_bidir0111_16xh_##simd, "mc_bidir0111_16xh_" #plane_ref, "mc_bidir0111_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir1000_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir1000_16xh_##plane_ref, mc_bidir1000_16xh_##simd, "mc_bidir1000_16xh_" #plane_ref, "mc_bidir1000_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir1001_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir1001_16xh_##plane_ref, mc_bidir1001_16xh_##simd, "mc_bidir1001_16xh_" #plane_ref, "mc_bidir1001_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir1010_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir1010_16xh_##plane_ref, mc_bidir1010_16xh_##simd, "mc_bidir1010_16xh_" #plane_ref, "mc_bidir1010_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir1011_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir1011_16xh_##plane_ref, mc_bidir1011_16xh_##simd, "mc_bidir1011_16xh_" #plane_ref, "mc_bidir1011_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir1100_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir1100_16xh_##plane_ref, mc_bidir1100_16xh_##simd, "mc_bidir1100_16xh_" #plane_ref, "mc_bidir1100_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir1101_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir1101_16xh_##plane_ref, mc_bidir1101_16xh_##simd, "mc_bidir1101_16xh_" #plane_ref, "mc_bidir1101_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir1110_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir1110_16xh_##plane_ref, mc_bidir1110_16xh_##simd, "mc_bidir1110_16xh_" #plane_ref, "mc_bidir1110_16xh_" #simd)); } \
+TEST_F(simd_mc_test_c, test_case##_bidir1111_16xh_##simd) { if (!cpu_support_##simd()) GTEST_SKIP(); EXPECT_TRUE(test_func(mc_bidir1111_16xh_##plane_ref, mc_bidir1111_16xh_##simd, "mc_bidir1111_16xh_" #plane_ref, "mc_bidir1111_16xh_" #simd)); }
+
 #if defined(CPU_PLATFORM_X64)
 TEST_MC_ROUTINES(validation, test_mc_pred, c, sse2)
 TEST_MC_ROUTINES(performance, test_mc_pred_performance, c, sse2)
+TEST_MC_16XH_ROUTINES(validation, test_mc_pred, c, avx2)
+TEST_MC_16XH_ROUTINES(throughput, test_mc_pred_throughput, sse2, avx2)
+
+static mc_pred_func_t  mc_pred_8xh_sse2[4]   = { mc_pred00_8xh_sse2, mc_pred01_8xh_sse2, mc_pred10_8xh_sse2, mc_pred11_8xh_sse2 };
+static mc_bidir_func_t mc_bidir_8xh_sse2[16] = { mc_bidir0000_8xh_sse2, mc_bidir0001_8xh_sse2, mc_bidir0010_8xh_sse2, mc_bidir0011_8xh_sse2,
+                                                 mc_bidir0100_8xh_sse2, mc_bidir0101_8xh_sse2, mc_bidir0110_8xh_sse2, mc_bidir0111_8xh_sse2,
+                                                 mc_bidir1000_8xh_sse2, mc_bidir1001_8xh_sse2, mc_bidir1010_8xh_sse2, mc_bidir1011_8xh_sse2,
+                                                 mc_bidir1100_8xh_sse2, mc_bidir1101_8xh_sse2, mc_bidir1110_8xh_sse2, mc_bidir1111_8xh_sse2 };
+
+#define TEST_MC_IDCT_ROUTINE(test_case, accuracy, idct_type, idct, coeffs_size) \
+TEST_F(simd_mc_test_c, test_case##_sse2) { EXPECT_TRUE(test_mc_idct(mc_pred_8xh_sse2, mc_bidir_8xh_sse2, \
+    mc_pred_idct_8x8_sse2[accuracy][idct_type], mc_bidir_idct_8x8_sse2[accuracy][idct_type], idct, coeffs_size)); }
+
+TEST_MC_IDCT_ROUTINE(validation_mc_idct,               idct_accuracy_fast,       MC_IDCT_8x8, inverse_dct_template<true>,                8)
+TEST_MC_IDCT_ROUTINE(validation_mc_idct_4x4,           idct_accuracy_fast,       MC_IDCT_4x4, inverse_dct_4x4_template<true>,            4)
+TEST_MC_IDCT_ROUTINE(validation_mc_idct_dc,            idct_accuracy_fast,       MC_IDCT_DC,  inverse_dct_dc_template<true>,             1)
+TEST_MC_IDCT_ROUTINE(validation_mc_idct_conformant,    idct_accuracy_conformant, MC_IDCT_8x8, inverse_dct_template_conformant<true>,     8)
+TEST_MC_IDCT_ROUTINE(validation_mc_idct_conformant_dc, idct_accuracy_conformant, MC_IDCT_DC,  inverse_dct_dc_template_conformant<true>,  1)
 #elif defined(CPU_PLATFORM_AARCH64)
 TEST_MC_ROUTINES(validation, test_mc_pred, c, aarch64)
 TEST_MC_ROUTINES(performance, test_mc_pred_performance, c, aarch64)
@@ -0,0 +1,155 @@
+// Copyright � 2021 Vladislav Ovchinnikov. All rights reserved.
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+
+// unit test common
+#include "test_common.h"
+
+// Tiny MPEG2 start code scanners
+#include "core/start_codes_search.hpp"
+
+constexpr int TEST_NUM_ITERATIONS = 10;
+constexpr int TEST_NUM_ITERATIONS_PERFORMANCE = 20;
+constexpr int SC_BUFFER_SIZE = 1 << 16;
+constexpr int SC_BUFFER_SIZE_PERFORMANCE = 1 << 24;
+constexpr int SC_BUFFER_PADDING = 128;
+constexpr int SC_MAX_DISTANCE = 4096;
+constexpr int SC_RANDOM_SEED = 1729;
+
+#define SCAN_START_CODES_FUNC(func) [](uint8_t* ptr, uint8_t* end, std::vector<uint8_t*>& hits) { func(ptr, end, [&hits](uint8_t* sc) { hits.push_back(sc); }); }
+
+typedef void (*scan_func_t)(uint8_t* ptr, uint8_t* end, std::vector<uint8_t*>& hits);
+
+class simd_start_codes_test_c : public ::testing::Test {
+public:
+    simd_start_codes_test_c() : gen(SC_RANDOM_SEED) {}
+    ~simd_start_codes_test_c() {}
+    void SetUp() {}
+    void TearDown() {}
+
+    // random payload with planted start codes and runs of zeroes around them
+    void generate_buffer(int size) {
+        std::uniform_int_distribution<uint32_t> byte_gen(0, 255);
+        std::uniform_int_distribution<uint32_t> dist_gen(0, SC_MAX_DISTANCE);
+        std::uniform_int_distribution<uint32_t> zeros_gen(2, 5);
+
+        buffer.assign(size + SC_BUFFER_PADDING, 0);
+        std::generate(buffer.begin(), buffer.begin() + size, [&]() { return (uint8_t)byte_gen(gen); });
+        for (int pos = dist_gen(gen); pos + 8 < size; pos += dist_gen(gen) + 8) {
+            int zeros = zeros_gen(gen);
+            std::fill(&buffer[pos], &buffer[pos + zeros], 0);
+            buffer[pos + zeros] = 1;
+        }
+        buffer_size = size;
+    }
+
+    GTEST_NO_INLINE_ void call_scan_routine(std::vector<uint8_t*>& hits, scan_func_t func, int offset, int end = -1) {
+        hits.clear();
+        func(&buffer[offset], &buffer[end < 0 ? buffer_size : end], hits);
+    }
+
+    // every prefix starting in [offset, end), found byte by byte
+    void reference_hits(std::vector<uint8_t*>& hits, int offset, int end) {
+        hits.clear();
+        for (int pos = offset; pos < end; pos++)
+            if (buffer[pos] == 0 && buffer[pos + 1] == 0 && buffer[pos + 2] == 1)
+                hits.push_back(&buffer[pos]);
+    }
+
+    // the scanned range also ends inside the payload, where prefixes run across and past its end
+    bool test_scan(scan_func_t func_c, scan_func_t func_simd, const char* name_func_c, const char* name_func_simd) {
+        std::vector<uint8_t*> hits_expected, hits_ref, hits;
+        for (int step = 0; step < TEST_NUM_ITERATIONS; step++) {
+            generate_buffer(SC_BUFFER_SIZE - step);
+            for (int end : { buffer_size, buffer_size - SC_MAX_DISTANCE - step * 7 }) {
+                reference_hits(hits_expected, step, end);
+                call_scan_routine(hits_ref, func_c, step, end);
+                call_scan_routine(hits, func_simd, step, end);
+                if (hits.empty() || hits != hits_ref || hits != hits_expected)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // prefixes split by the end of the range are reported by the range they start in
+    bool test_scan_split(scan_func_t func) {
+        std::vector<uint8_t*> hits;
+        for (int split = 0; split < 4; split++) {
+            buffer.assign(256 + SC_BUFFER_PADDING, 0xff);
+            buffer_size = 256;
+            for (int pos = 8; pos < 256; pos += 37) {
+                buffer[pos] = buffer[pos + 1] = 0;
+                buffer[pos + 2] = 1;
+            }
+            int end = 8 + 37 * 3 + split;
+            call_scan_routine(hits, func, 0, end);
+            size_t expected = split ? 4 : 3;
+            if (hits.size() != expected || hits.back() >= &buffer[end])
+                return false;
+            call_scan_routine(hits, func, end);
+            if (hits.empty() || hits.front() < &buffer[end])
+                return false;
+        }
+        return true;
+    }
+
+    double measure_bandwidth(scan_func_t func, std::vector<uint8_t*>& hits) {
+        const auto start = std::chrono::system_clock::now();
+        for (int step = 0; step < TEST_NUM_ITERATIONS_PERFORMANCE; step++)
+            call_scan_routine(hits, func, 0);
+        const auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start).count();
+        return (double)buffer_size * TEST_NUM_ITERATIONS_PERFORMANCE / std::max<double>(1.0, (double)elapsed_us) * 1e-3;
+    }
+
+    bool test_scan_performance(scan_func_t func_c, scan_func_t func_simd, const char* name_func_c, const char* name_func_simd) {
+        std::vector<uint8_t*> hits_ref, hits;
+        generate_buffer(SC_BUFFER_SIZE_PERFORMANCE);
+        hits_ref.reserve(SC_BUFFER_SIZE_PERFORMANCE / SC_MAX_DISTANCE * 4);
+        hits.reserve(SC_BUFFER_SIZE_PERFORMANCE / SC_MAX_DISTANCE * 4);
+        double bandwidth_func_c = measure_bandwidth(func_c, hits_ref);
+        double bandwidth_func_simd = measure_bandwidth(func_simd, hits);
+        testing::internal::ColoredPrintf(testing::internal::COLOR_DEFAULT, "%24s: ", name_func_c);
+        testing::internal::ColoredPrintf(testing::internal::COLOR_YELLOW, "%8.2f GB/s\n", bandwidth_func_c);
+        testing::internal::ColoredPrintf(testing::internal::COLOR_DEFAULT, "%24s: ", name_func_simd);
+        testing::internal::ColoredPrintf(testing::internal::COLOR_GREEN, "%8.2f GB/s\n", bandwidth_func_simd);
+        return hits == hits_ref;
+    }
+
+protected:
+    std::vector<uint8_t> buffer;
+    int buffer_size = 0;
+    std::mt19937 gen{};
+};
+
+#define TEST_SCAN_ROUTINES(test_case, test_func, plane_c, simd) \
+TEST_F(simd_start_codes_test_c, test_case##_scan_start_codes_##simd) { EXPECT_TRUE(test_func(SCAN_START_CODES_FUNC(scan_start_codes_##plane_c), SCAN_START_CODES_FUNC(scan_start_codes_##simd), "scan_start_codes_" #plane_c, "scan_start_codes_" #simd)); }
+
+#define TEST_SCAN_SPLIT_ROUTINE(isa) \
+TEST_F(simd_start_codes_test_c, validation_split_scan_start_codes_##isa) { EXPECT_TRUE(test_scan_split(SCAN_START_CODES_FUNC(scan_start_codes_##isa))); }
+
+TEST_SCAN_SPLIT_ROUTINE(c)
+
+#if defined(CPU_PLATFORM_X64)
+TEST_SCAN_ROUTINES(validation, test_scan, c, sse2)
+TEST_SCAN_ROUTINES(performance, test_scan_performance, c, sse2)
+TEST_SCAN_SPLIT_ROUTINE(sse2)
+TEST_F(simd_start_codes_test_c, validation_scan_start_codes_avx2) {
+    if (!cpu_support_avx2()) GTEST_SKIP();
+    EXPECT_TRUE(test_scan(SCAN_START_CODES_FUNC(scan_start_codes_c), SCAN_START_CODES_FUNC(scan_start_codes_avx2), "scan_start_codes_c", "scan_start_codes_avx2"));
+}
+TEST_F(simd_start_codes_test_c, validation_split_scan_start_codes_avx2) {
+    if (!cpu_support_avx2()) GTEST_SKIP();
+    EXPECT_TRUE(test_scan_split(SCAN_START_CODES_FUNC(scan_start_codes_avx2)));
+}
+TEST_F(simd_start_codes_test_c, performance_scan_start_codes_avx2) {
+    if (!cpu_support_avx2()) GTEST_SKIP();
+    EXPECT_TRUE(test_scan_performance(SCAN_START_CODES_FUNC(scan_start_codes_sse2), SCAN_START_CODES_FUNC(scan_start_codes_avx2), "scan_start_codes_sse2", "scan_start_codes_avx2"));
+}
+#elif defined(CPU_PLATFORM_AARCH64)
+TEST_SCAN_ROUTINES(validation, test_scan, c, aarch64)
+TEST_SCAN_ROUTINES(performance, test_scan_performance, c, aarch64)
+TEST_SCAN_SPLIT_ROUTINE(aarch64)
+#endif
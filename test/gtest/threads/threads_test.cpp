@@ -16,11 +16,11 @@ constexpr int TASK_POOL_SIZE = 8;
 
 class threads_test_c : public ::testing::Test {
 public:
-    threads_test_c() : queue(TASK_POOL_SIZE, []() -> picture_task_c* { return new picture_task_c(); }) {}
+    threads_test_c(int pool_size = THREAD_POOL_SIZE) : queue(TASK_POOL_SIZE, []() -> picture_task_c* { return new picture_task_c(); }), pool_size(pool_size) {}
     ~threads_test_c() {}
 
     void SetUp() {
-        for (int i = 0; i < THREAD_POOL_SIZE; i++)
+        for (int i = 0; i < pool_size; i++)
             pool.emplace_back(thread_pool_proc, &queue);
     }
     void TearDown() {}
@@ -58,7 +58,74 @@ public:
         return true;
     }
 
-private:
+    // Side tasks queued while the pool waits for the next picture are run by the pool, not only by the submitter,
+    // and the pool goes on with the pictures queued afterwards
+    template<int NUM_SLICES, int NUM_SIDE_TASKS>
+    bool test_side_tasks(int timeout) {
+        auto* pic = queue.create_task();
+        add_slices<NUM_SLICES>(pic);
+        queue.add_task(pic);
+        CHECK_TIMEOUT(queue.flush(), timeout);
+        std::this_thread::sleep_for(milliseconds(20)); // the pool runs out of slices and waits for the next picture
+
+        std::vector<test_side_task_c> side_tasks(NUM_SIDE_TASKS);
+        std::vector<slice_task_c*> side_task_ptrs;
+        std::atomic<int> num_done(0);
+        for (auto& tsk : side_tasks) {
+            tsk.num_done = &num_done;
+            side_task_ptrs.push_back(&tsk);
+        }
+        queue.add_side_tasks(&side_task_ptrs[0], NUM_SIDE_TASKS);
+        CHECK_TIMEOUT(
+            {
+                while (num_done.load() < NUM_SIDE_TASKS)
+                    std::this_thread::yield();
+            }, timeout);
+        for (auto& tsk : side_tasks)
+            if (tsk.thread_id == std::this_thread::get_id())
+                return false;
+
+        auto* p_pic = immitate_gop<NUM_SLICES, 0, false>(queue, pic);
+        pic->render_done(); // kill() waits for the output of every picture
+        p_pic->render_done();
+        CHECK_TIMEOUT(
+            {
+                queue.kill();
+                join_threads();
+            }, timeout);
+        return true;
+    }
+
+    // A picture is output once it is queued, not while its slices are still being added
+    template<int NUM_SLICES>
+    bool test_output_after_queue(int timeout) {
+        auto* pic = queue.create_task();
+        std::promise<picture_task_c*> decoded;
+        auto decoded_future = decoded.get_future();
+        std::atomic<bool> started(false);
+        std::thread([&] {
+            started.store(true);
+            decoded.set_value(queue.get_decoded());
+            }).detach();
+        while (!started.load())
+            std::this_thread::yield();
+        if (decoded_future.wait_for(milliseconds(20)) != std::future_status::timeout)
+            return false;
+
+        add_slices<NUM_SLICES>(pic);
+        queue.add_task(pic);
+        if (decoded_future.wait_for(seconds(timeout)) == std::future_status::timeout || decoded_future.get() != pic)
+            return false;
+        pic->render_done();
+        CHECK_TIMEOUT(
+            {
+                queue.kill();
+                join_threads();
+            }, timeout);
+        return true;
+    }
+
+protected:
     static void thread_pool_proc(task_queue_c* queue) {
         test_slice_task_c* slice_task = nullptr;
         while (queue->get_task((slice_task_c*&)slice_task) == TASK_QUEUE_SUCCESS) {
@@ -68,7 +135,16 @@ private:
     }
     task_queue_c queue;
     std::vector<std::thread> pool;
+    int pool_size;
+};
+
+class threads_single_worker_test_c : public threads_test_c {
+public:
+    threads_single_worker_test_c() : threads_test_c(1) {}
 };
 
 TEST_F(threads_test_c, test_flush) { EXPECT_TRUE((test_flush<68, 3, 100>(1))); }
 TEST_F(threads_test_c, test_multiple_flushes) { EXPECT_TRUE((test_multiple_flushes<68, 3>(100, 1))); }
+TEST_F(threads_test_c, test_side_tasks) { EXPECT_TRUE((test_side_tasks<68, 64>(1))); }
+TEST_F(threads_single_worker_test_c, test_side_tasks) { EXPECT_TRUE((test_side_tasks<68, 64>(1))); }
+TEST_F(threads_test_c, test_output_after_queue) { EXPECT_TRUE((test_output_after_queue<68>(1))); }
@@ -2,7 +2,7 @@
 
 class test_slice_task_c : public slice_task_c {
 public:
-    void execute() {
+    virtual void execute() {
         auto task_start = std::chrono::high_resolution_clock::now();
         auto task_end = std::chrono::high_resolution_clock::now();
         while (task_end - task_start < std::chrono::microseconds(100))
@@ -10,6 +10,18 @@ public:
     }
 };
 
+// Task outside of any picture, remembers the thread it ran on
+class test_side_task_c : public test_slice_task_c {
+public:
+    std::thread::id thread_id;
+    std::atomic<int>* num_done = nullptr;
+    void execute() override {
+        test_slice_task_c::execute();
+        thread_id = std::this_thread::get_id();
+        (*num_done)++;
+    }
+};
+
 template<int NUM_SLICES>
 void add_slices(picture_task_c* frame_task) {
     for (int i = 0; i < NUM_SLICES; i++)
@@ -5,8 +5,20 @@
 #include <iostream>
 #include "sample_args.h"
 #include "core/decoder.h"
+#include "core/mapped_file.h"
+#include "core/demuxer.h"
+#include "core/stream_index.h"
+
+constexpr int DEMUX_CHUNK_SIZE = 1024 * TS_PACKET_SIZE;
+
+enum container_e {
+    container_es = 0,
+    container_ts = 1,
+    container_ps = 2
+};
 
 std::vector<uint32_t, AlignmentAllocator<uint8_t, 32>> buffer_pool;
+std::size_t bitstream_size = 0;
 
 void write_yuv(FILE* fp, frame_c* frame) {
     for (int i = 0; i < 3; i++) {
@@ -25,31 +37,114 @@ void load_bitstream(std::string input_file) {
     size = ((size + 15) & (~15));
     fp.seekg(0, std::ios_base::beg);
 
-    // Allocate buffer
-    buffer_pool.resize(size / sizeof(uint32_t));
+    // Allocate buffer with zero padded tail
+    bitstream_size = size;
+    buffer_pool.assign(((size + STREAM_PADDING + 31) & (~31)) / sizeof(uint32_t), 0);
 
     // read file
     fp.read((char*)&buffer_pool[0], size);
     fp.close();
 }
 
+// sink is either the decoder itself or a demuxer in front of it
+template<class sink_t>
+void stream_bitstream(sink_t& sink, std::string input_file, int chunk_size) {
+    std::ifstream fp(input_file, std::ios::binary);
+    std::vector<uint8_t> chunk(chunk_size);
+
+    while (fp) {
+        fp.read((char*)&chunk[0], chunk_size);
+        sink.push(&chunk[0], (int)fp.gcount());
+    }
+    sink.end_of_stream();
+}
+
+// mapped input goes to the demuxer in one go, otherwise the file is read by chunks
+template<class demuxer_t>
+void demux_bitstream(demuxer_t& demuxer, mapped_file_c& mapped_file, std::string input_file, int chunk_size) {
+    if (mapped_file.get_data()) {
+        demuxer.push(mapped_file.get_data(), mapped_file.get_size());
+        demuxer.end_of_stream();
+    }
+    else
+        stream_bitstream(demuxer, input_file, chunk_size ? chunk_size : DEMUX_CHUNK_SIZE);
+}
+
+// sidecar index is reused while it matches the stream, otherwise it is rebuilt and saved
+void load_stream_index(stream_index_c& index, mapped_file_c& mapped_file, std::string index_file) {
+    if (!index.open(index_file.c_str(), mapped_file.get_size())) {
+        index.build(mapped_file.get_data(), mapped_file.get_size());
+        index.save(index_file.c_str());
+    }
+}
+
 int main(int argc, char* argv[])
 {
-    std::string* bitstream_file = nullptr, * output_file = nullptr;
+    std::string* bitstream_file = nullptr, * output_file = nullptr, * index_file = nullptr, * cpu_isa_name = nullptr;
+    int chunk_size = 0;
+    int parallel_scan = 0;
+    int two_phase = 0;
+    int conformant_idct = 0;
+    int frame_padding = FRAME_PADDING;
+    int prefetch = 0;
+    int use_mmap = 0;
+    int container = container_es;
+    int first_picture = 0;
     args_parser cmd_parser({
         { "-v", "Input MPEG2 elementary bitsream file", ARG_TYPE_TEXT, &bitstream_file },
-        { "-o", "Output YUV stream", ARG_TYPE_TEXT, &output_file }
+        { "-o", "Output YUV stream", ARG_TYPE_TEXT, &output_file },
+        { "-s", "Push input to decoder by chunks of given size (bytes)", ARG_TYPE_INT, &chunk_size },
+        { "-p", "Build start code index on the thread pool (0/1)", ARG_TYPE_INT, &parallel_scan },
+        { "-b", "Two-phase slice decoding: parse a batch of macroblocks, then reconstruct it (0/1)", ARG_TYPE_INT, &two_phase },
+        { "-m", "Memory map input file instead of loading it (0/1)", ARG_TYPE_INT, &use_mmap },
+        { "-t", "Input container: 0 - elementary stream, 1 - transport stream, 2 - program stream", ARG_TYPE_INT, &container },
+        { "-i", "Start code index file of the elementary stream, built if missing or stale (with -m 1)", ARG_TYPE_TEXT, &index_file },
+        { "-k", "Start from the nearest I-picture at or before given picture in coded order (with -i)", ARG_TYPE_INT, &first_picture },
+        { "-c", "Force kernel instruction set: c, sse2, avx2, neon (default - best supported, or MP2V_CPU_ISA)", ARG_TYPE_TEXT, &cpu_isa_name },
+        { "-a", "IDCT accuracy: 0 - fast, 1 - IEEE 1180 conformant, bit-exact with the MPEG-2 test model", ARG_TYPE_INT, &conformant_idct },
+        { "-g", "Guard band around the frame planes in luma samples, the borders of reference pictures are extended into it", ARG_TYPE_INT, &frame_padding },
+        { "-r", "Prefetch the reference areas of upcoming macroblocks and of the next macroblock row (0/1, with -b 1)", ARG_TYPE_INT, &prefetch }
         }, argc, argv);
 
     if (output_file) {
         FILE* fp = fopen(output_file->c_str(), "wb");
         if (bitstream_file && fp) {
-            load_bitstream(*bitstream_file);
-            mp2v_decoder_c mp2v_decoder({ 1920, 1088, 2, 10, 8, true }, [fp](frame_c* frame) { write_yuv(fp, frame); });
+            mapped_file_c mapped_file;
+            if (!chunk_size && use_mmap) {
+                if (!mapped_file.open(bitstream_file->c_str())) {
+                    fclose(fp);
+                    return 1;
+                }
+            }
+            else if (!chunk_size && container == container_es)
+                load_bitstream(*bitstream_file);
+            stream_index_c stream_index;
+            bool use_index = index_file && mapped_file.get_data() && container == container_es;
+            if (use_index)
+                load_stream_index(stream_index, mapped_file, *index_file);
+            mp2v_decoder_c mp2v_decoder({ 1920, 1088, 2, 10, 8, true, parallel_scan != 0, two_phase != 0, cpu_isa_name ? cpu_isa_from_name(cpu_isa_name->c_str()) : cpu_isa_auto,
+                conformant_idct ? idct_accuracy_conformant : idct_accuracy_fast, frame_padding, prefetch != 0 }, [fp](frame_c* frame) { write_yuv(fp, frame); });
 
             const auto start = std::chrono::system_clock::now();
 
-            mp2v_decoder.decode((uint8_t*)&buffer_pool[0], buffer_pool.size() * 4);
+            if (container == container_ts) {
+                ts_demuxer_c ts_demuxer(&mp2v_decoder);
+                demux_bitstream(ts_demuxer, mapped_file, *bitstream_file, chunk_size);
+                if (ts_demuxer.get_discontinuities())
+                    printf("Discontinuities = %d\n", ts_demuxer.get_discontinuities());
+            }
+            else if (container == container_ps) {
+                ps_demuxer_c ps_demuxer(&mp2v_decoder);
+                demux_bitstream(ps_demuxer, mapped_file, *bitstream_file, chunk_size);
+            }
+            else if (chunk_size)
+                stream_bitstream(mp2v_decoder, *bitstream_file, chunk_size);
+            else if (use_index)
+                mp2v_decoder.decode(mapped_file.get_data(), mapped_file.get_size(), stream_index, first_picture);
+            else if (use_mmap)
+                mp2v_decoder.decode(mapped_file.get_data(), mapped_file.get_size());
+            else
+                mp2v_decoder.decode((uint8_t*)&buffer_pool[0], bitstream_size);
 
             auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start);
             printf("Time = %.2f ms\n", static_cast<double>(elapsed_ms.count()));